@@ -20,6 +20,8 @@
 #include <QtCore/QThread>
 #include <QtCore/QTime>
 #include <QtWidgets/QScrollBar>
+#include <QtCore/QDir>
+#include <QtCore/QStandardPaths>
 #include <QtWidgets/QFileDialog>
 #include <QtWidgets/QTableWidgetItem>
 #include <QtWidgets/QHBoxLayout>
@@ -41,6 +43,7 @@ extern "C" {
 #include "MainWindow.h"
 #include "ControllerPC.h"
 #include "Controller.h"
+#include "FirmwareDelta.h"
 #include "ui_mainWindow.h"
 #include "qcustomplot.h"
 #include "ui/HStatusBar.h"
@@ -51,6 +54,8 @@ MainWindow::MainWindow()
 	, mControllerMonitor( nullptr )
 	, mStreamLink( nullptr )
 	, mFirmwareUpdateThread( nullptr )
+	, mRecordDownloadThread( nullptr )
+	, mRecordDownloadProgress( nullptr )
 	, motorSpeedLayout( nullptr )
 	, mPIDsOk( false )
 	, mPIDsReading( true )
@@ -73,6 +78,7 @@ MainWindow::MainWindow()
 			controllerLink->SetChannel( mConfig->value( "rawwifi/channel", 9 ).toInt() );
 			controllerLink->setRetriesCount( mConfig->value( "rawwifi/controller/retries", 1 ).toInt() );
 			controllerLink->setCECMode( mConfig->value( "rawwifi/controller/cec", "" ).toString().toLower().toStdString() );
+			controllerLink->setFEC( mConfig->value( "rawwifi/controller/fec_k", 4 ).toInt(), mConfig->value( "rawwifi/controller/fec_m", 0 ).toInt() );
 			controllerLink->setDropBroken( not mConfig->value( "rawwifi/controller/nodrop", false ).toBool() );
 			mStreamLink = new RawWifi( device, mConfig->value( "rawwifi/video/outport", 10 ).toInt(), mConfig->value( "rawwifi/video/inport", 11 ).toInt() );
 			static_cast<RawWifi*>(mStreamLink)->SetChannel( mConfig->value( "rawwifi/channel", 9 ).toInt() );
@@ -136,6 +142,12 @@ MainWindow::MainWindow()
 	connect( ui->night_mode, SIGNAL( stateChanged(int) ), this, SLOT( SetNightMode(int) ) );
 	connect( ui->motorTestButton, SIGNAL(pressed()), this, SLOT(MotorTest()));
 
+	connect( this, SIGNAL( recordDownloadProgress(int) ), this, SLOT( setRecordDownloadProgress(int) ) );
+
+	mRecordDownloadProgress = new QProgressBar();
+	mRecordDownloadProgress->setMaximumWidth( 160 );
+	mRecordDownloadProgress->setVisible( false );
+	ui->statusbar->addPermanentWidget( mRecordDownloadProgress );
 	ui->statusbar->showMessage( "Disconnected" );
 
 	ui->cpu_load->setSuffix( "%" );
@@ -288,11 +300,21 @@ void MainWindow::updateData()
 		}
 	} else {
 		QString conn = mController->isConnected() ? "Connected" : "Disconnected";
-		ui->statusbar->showMessage( conn + QString( "    |    RX Qual : %1 % (%2 dBm )    |    TX Qual : %3 %    |    TX : %4 B/s    |    RX : %5 B/s    |    Camera :%6 KB/s (%7 KB/s |%8 % |%9 dBm )    |    %10 FPS" ).arg( mController->link()->RxQuality(), 3, 10, QChar(' ') ).arg( mController->link()->RxLevel(), 3, 10, QChar(' ') ).arg( mController->droneRxQuality(), 3, 10, QChar(' ') ).arg( mController->link()->writeSpeed(), 4, 10, QChar(' ') ).arg( mController->link()->readSpeed(), 4, 10, QChar(' ') ).arg( mStreamLink->readSpeed() / 1024, 4, 10, QChar(' ') ).arg( mStreamLink->fullReadSpeed() / 1024, 4, 10, QChar(' ') ).arg( mStreamLink->RxQuality(), 3, 10, QChar(' ') ).arg( mStreamLink->RxLevel(), 3, 10, QChar(' ') ).arg( ui->video->fps() ) );
+		ui->statusbar->showMessage( conn + QString( "    |    RX Qual : %1 % (%2 dBm )    |    TX Qual : %3 %    |    TX : %4 B/s    |    RX : %5 B/s    |    Camera :%6 KB/s (%7 KB/s |%8 % |%9 dBm )    |    %10 FPS    |    Telemetry : %11 B/frame (-%12 %)" ).arg( mController->link()->RxQuality(), 3, 10, QChar(' ') ).arg( mController->link()->RxLevel(), 3, 10, QChar(' ') ).arg( mController->droneRxQuality(), 3, 10, QChar(' ') ).arg( mController->link()->writeSpeed(), 4, 10, QChar(' ') ).arg( mController->link()->readSpeed(), 4, 10, QChar(' ') ).arg( mStreamLink->readSpeed() / 1024, 4, 10, QChar(' ') ).arg( mStreamLink->fullReadSpeed() / 1024, 4, 10, QChar(' ') ).arg( mStreamLink->RxQuality(), 3, 10, QChar(' ') ).arg( mStreamLink->RxLevel(), 3, 10, QChar(' ') ).arg( ui->video->fps() ).arg( mController->telemetryFrameBytes(), 3, 10, QChar(' ') ).arg( mController->telemetrySavings(), 2, 10, QChar(' ') ) );
 
 		if ( mController->ping() < 10000 ) {
 			ui->latency->setText( QString::number( mController->ping() ) + " ms" );
 		}
+		std::vector<uint32_t> rtt = mController->rttPercentiles();
+		std::vector<uint32_t> uplink = mController->uplinkPercentiles();
+		std::vector<uint32_t> downlink = mController->downlinkPercentiles();
+		if ( rtt.size() == 3 and uplink.size() == 3 and downlink.size() == 3 ) {
+			ui->latency->setToolTip( QString( "RTT : %1 / %2 / %3 ms (p50 / p95 / p99)\nUplink : %4 / %5 / %6 ms\nDownlink : %7 / %8 / %9 ms\nClock offset : %10 ms" )
+				.arg( rtt[0] / 1000.0, 0, 'f', 2 ).arg( rtt[1] / 1000.0, 0, 'f', 2 ).arg( rtt[2] / 1000.0, 0, 'f', 2 )
+				.arg( uplink[0] / 1000.0, 0, 'f', 2 ).arg( uplink[1] / 1000.0, 0, 'f', 2 ).arg( uplink[2] / 1000.0, 0, 'f', 2 )
+				.arg( downlink[0] / 1000.0, 0, 'f', 2 ).arg( downlink[1] / 1000.0, 0, 'f', 2 ).arg( downlink[2] / 1000.0, 0, 'f', 2 )
+				.arg( mController->clockOffset() / 1000.0, 0, 'f', 2 ) );
+		}
 		ui->voltage->setText( QString::number( mController->batteryVoltage(), 'f', 2 ) + " V" );
 		ui->current->setText( QString::number( mController->currentDraw(), 'f', 2 ) + " A" );
 		ui->current_total->setText( QString::number( mController->totalCurrent() ) + " mAh" );
@@ -552,22 +574,44 @@ bool MainWindow::RunFirmwareUpdate()
 			QFile f( ui->firmware_path->text() );
 			if ( !f.open( QFile::ReadOnly ) ) return false;
 			QByteArray ba = f.readAll();
-
-			mController->UploadUpdateInit();
-			uint32_t chunk_size = 1024; // 2048
-			for ( uint32_t offset = 0; offset < (uint32_t)ba.size(); offset += chunk_size ) {
-				uint32_t sz = chunk_size;
-				if ( ba.size() - offset < chunk_size ) {
-					sz = ba.size() - offset;
+			QByteArray image = ba;
+
+			// Every uploaded firmware is kept, so that the next update only sends what changed from the running one
+			QDir cache( QStandardPaths::writableLocation( QStandardPaths::AppDataLocation ) + "/firmwares" );
+			cache.mkpath( "." );
+			uint32_t running_crc = mController->firmwareCRC();
+			QFile base( cache.filePath( QString::number( running_crc, 16 ).toUpper() + ".bin" ) );
+			if ( running_crc != 0 and base.open( QFile::ReadOnly ) ) {
+				QByteArray base_data = base.readAll();
+				std::vector< uint8_t > delta = FirmwareDelta::Encode( (const uint8_t*)base_data.constData(), base_data.size(), (const uint8_t*)ba.constData(), ba.size() );
+				if ( delta.size() < (uint32_t)ba.size() / 2 ) {
+					emit debugOutput( "Sending firmware delta (" + QString::number( delta.size() ) + " bytes instead of " + QString::number( ba.size() ) + ")\n" );
+					image = QByteArray( (const char*)delta.data(), delta.size() );
 				}
-				mController->UploadUpdateData( (const uint8_t*)&ba.constData()[offset], offset, sz );
-				emit firmwareUpdateProgress( offset * 100 / ba.size() + 1 );
-				QApplication::processEvents();
+			}
+
+			if ( not mController->UploadUpdateInit( image.size() ) ) {
+				emit debugOutput( "\n====> Firmware update refused by the drone <====\n" );
+				emit firmwareUpdateProgress( 0 );
+				return false;
+			}
+			bool ok = mController->UploadUpdateData( (const uint8_t*)image.constData(), image.size(), [this]( uint32_t done, uint32_t total ) {
+				emit firmwareUpdateProgress( (int)( (uint64_t)done * 100 / total ) );
+			});
+			if ( not ok ) {
+				emit debugOutput( "\n====> Firmware upload interrupted, please retry <====\n" );
+				emit firmwareUpdateProgress( 0 );
+				return false;
 			}
 
 			emit debugOutput( "\n====> Applying firmware update and restarting service, please wait... <====\n" );
 
-			mController->UploadUpdateProcess( (const uint8_t*)ba.constData(), ba.size() );
+			mController->UploadUpdateProcess( (const uint8_t*)image.constData(), image.size() );
+
+			QFile saved( cache.filePath( QString::number( crc32c( (const uint8_t*)ba.constData(), ba.size() ), 16 ).toUpper() + ".bin" ) );
+			if ( saved.open( QFile::WriteOnly ) ) {
+				saved.write( ba );
+			}
 		}
 
 		emit firmwareUpdateProgress( 0 );
@@ -861,6 +905,8 @@ void MainWindow::RecordingsRefresh()
 			tools->setLayout( layout );
 			QPushButton* btn_save = new QPushButton();
 			btn_save->setIcon( QIcon( ":icons/icon-download.png" ) );
+			btn_save->setProperty( "filename", filename );
+			connect( btn_save, SIGNAL( pressed() ), this, SLOT( RecordDownload() ) );
 			QPushButton* btn_delete = new QPushButton();
 			btn_delete->setIcon( QIcon( ":icons/icon-delete.png" ) );
 			layout->addWidget( btn_save );
@@ -875,6 +921,49 @@ void MainWindow::RecordingsRefresh()
 	ui->recordings->setHorizontalHeaderLabels( headers );
 }
 
+
+void MainWindow::RecordDownload()
+{
+	if ( not mController or mController->isSpectate() or not sender() ) {
+		return;
+	}
+	if ( mRecordDownloadThread ) {
+		if ( mRecordDownloadThread->isRunning() ) {
+			return;
+		}
+		delete mRecordDownloadThread;
+	}
+
+	mRecordDownloadName = sender()->property( "filename" ).toString();
+	mRecordDownloadPath = QFileDialog::getSaveFileName( this, "Save recording", mRecordDownloadName );
+	if ( mRecordDownloadPath.length() == 0 ) {
+		mRecordDownloadThread = nullptr;
+		return;
+	}
+
+	mRecordDownloadThread = new RecordDownloadThread( this );
+	mRecordDownloadThread->start();
+}
+
+
+bool MainWindow::RunRecordDownload()
+{
+	emit recordDownloadProgress( 0 );
+	bool ok = mController->DownloadRecording( mRecordDownloadName.toStdString(), mRecordDownloadPath.toStdString(), [this]( uint32_t done, uint32_t total ) {
+		emit recordDownloadProgress( (int)( (uint64_t)done * 100 / std::max( 1U, total ) ) );
+	});
+	emit debugOutput( "Download of " + mRecordDownloadName + ( ok ? " complete\n" : " interrupted, it will resume from where it stopped\n" ) );
+	emit recordDownloadProgress( -1 );
+	return ok;
+}
+
+
+void MainWindow::setRecordDownloadProgress( int val )
+{
+	mRecordDownloadProgress->setVisible( val >= 0 );
+	mRecordDownloadProgress->setValue( std::max( 0, val ) );
+}
+
 void MainWindow::MotorTest() {
 	int id = ui->motorTestSpinBox->value();
 
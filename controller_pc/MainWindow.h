@@ -36,6 +36,7 @@ class Link;
 class ControllerPC;
 class ControllerMonitor;
 class FirmwareUpdateThread;
+class RecordDownloadThread;
 
 class MainWindow : public QMainWindow
 {
@@ -46,6 +47,7 @@ public:
 	~MainWindow();
 
 	bool RunFirmwareUpdate();
+	bool RunRecordDownload();
 	ControllerPC* controller() { return mController; }
 	Ui::MainWindow* getUi() const { return ui; }
 
@@ -83,12 +85,15 @@ public slots:
 	void VideoTakePicture();
 	void SetNightMode( int state );
 	void RecordingsRefresh();
+	void RecordDownload();
+	void setRecordDownloadProgress( int val );
 	void setFirmwareUpdateProgress( int val );
 	void appendDebugOutput( const QString& str );
 	void MotorTest();
 
 signals:
 	void firmwareUpdateProgress( int val );
+	void recordDownloadProgress( int val );
 	void debugOutput( const QString& str );
 
 private:
@@ -101,6 +106,15 @@ private:
 		}
 		MainWindow* mInstance;
 	};
+	class RecordDownloadThread : public QThread {
+	public:
+		RecordDownloadThread( MainWindow* instance ) : QThread(), mInstance( instance ) {}
+	protected:
+		void run() {
+			mInstance->RunRecordDownload();
+		}
+		MainWindow* mInstance;
+	};
 
 	Ui::MainWindow* ui;
 	Config* mConfig;
@@ -109,6 +123,10 @@ private:
 	Link* mStreamLink;
 	QTimer* mUpdateTimer;
 	FirmwareUpdateThread* mFirmwareUpdateThread;
+	RecordDownloadThread* mRecordDownloadThread;
+	QString mRecordDownloadName;
+	QString mRecordDownloadPath;
+	QProgressBar* mRecordDownloadProgress;
 	QVBoxLayout *motorSpeedLayout = NULL;
 	QList<QProgressBar*> motorSpeedProgress;
 
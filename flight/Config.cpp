@@ -316,6 +316,8 @@ void Config::Reload()
 	luaL_dostring( L, "function Socket( params ) params.link_type = \"Socket\" ; return params end" );
 	luaL_dostring( L, "function RF24( params ) params.link_type = \"nRF24L01\" ; return params end" );
 	luaL_dostring( L, "function MultiLink( params ) params.link_type = \"MultiLink\" ; return params end" );
+	luaL_dostring( L, "function SharedMemory( params ) params.link_type = \"SharedMemory\" ; return params end" );
+	luaL_dostring( L, "function FaultLink( params ) params.link_type = \"FaultLink\" ; return params end" );
 	luaL_dostring( L, "function RawWifi( params ) params.link_type = \"RawWifi\" ; params.device = \"wlan0\" ; if params.blocking == nil then params.blocking = true end ; if params.retries == nil then params.retries = 2 end ; return params end" );
 	luaL_dostring( L, "function Voltmeter( params ) params.sensor_type = \"Voltmeter\" ; return params end" );
 	luaL_dostring( L, "function Buzzer( params ) params.type = \"Buzzer\" ; return params end" );
@@ -333,6 +335,8 @@ void Config::Reload()
 	luaL_dostring( L, "magnetometers = {}" );
 	luaL_dostring( L, "altimeters = {}" );
 	luaL_dostring( L, "GPSes = {}" );
+	luaL_dostring( L, "sensors_recorder = {}" );
+	luaL_dostring( L, "fake_sensors = {}" );
 	luaL_dostring( L, "user_sensors = {}" );
 	luaL_dostring( L, "function RegisterSensor( name, params ) user_sensors[name] = params ; return params end" );
 	luaL_loadfile( L, mFilename.c_str() );
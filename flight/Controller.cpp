@@ -21,6 +21,7 @@
 #include "Main.h"
 #include "Controller.h"
 #include <Link.h>
+#include <LinkScheduler.h>
 #include <IMU.h>
 #include <Gyroscope.h>
 #include <Accelerometer.h>
@@ -29,6 +30,11 @@
 #include <Stabilizer.h>
 #include <Frame.h>
 #include "video/Camera.h"
+#include "Reactor.h"
+#include "TelemetryScheduler.h"
+#include "RecordDownload.h"
+#include "FirmwareUpload.h"
+#include "Crc32c.h"
 
 #include <netinet/in.h>
 
@@ -36,18 +42,29 @@ Controller::Controller( Main* main, Link* link )
 	: ControllerBase( link )
 	, Thread( "controller" )
 	, mMain( main )
+	, mScheduler( new LinkScheduler( link, main->config(), "controller.qos" ) )
 	, mArmed( false )
 	, mPing( 0 )
+	, mLatency{ 0 }
 	, mRPY( Vector3f() )
 	, mThrust( 0.0f )
 	, mTicks( 0 )
-	, mTelemetryThread( new HookThread< Controller >( "telemetry", this, &Controller::TelemetryRun ) )
-	, mTelemetryTick( 0 )
-	, mTelemetryCounter( 0 )
+	, mTelemetryTimer( -1 )
 	, mEmergencyTick( 0 )
 	, mTelemetryFull( false )
+	, mDebugTokens( 0.0f )
+	, mDebugTick( 0 )
+	, mDebugDropped( 0 )
+	, mDebugTimer( -1 )
 {
 	mTelemetryFrequency = main->config()->integer( "controller.telemetry_rate", 20 );
+	mTelemetryScheduler = new TelemetryScheduler( main->config(), "controller.telemetry", mTelemetryFrequency );
+	mRecordDownload = new RecordDownload( mScheduler, RECORD_DOWNLOAD_DATA, main->config(), "controller.record_download" );
+	mFirmwareUpload = new FirmwareUpload( "/tmp/flight_update" );
+	mDebugBufferSize = std::max( 256, main->config()->integer( "controller.debug.buffer", 16384 ) );
+	mDebugFrameSize = std::min( std::max( 64, main->config()->integer( "controller.debug.frame", 1024 ) ), PACKET_MAX_SIZE - 16 );
+	// Forwarding is off unless a rate is set
+	mDebugRate = std::max( 0, main->config()->integer( "controller.debug.rate", 0 ) );
 
 	mExpo = Vector4f();
 	mExpo.x = main->config()->number( "controller.expo.roll" );
@@ -82,8 +99,11 @@ Controller::Controller( Main* main, Link* link )
 	gDebug() << "Starting RX thread\n";
 	Start();
 	if ( mTelemetryFrequency > 0 ) {
-		gDebug() << "Starting telemetry thread\n";
-		mTelemetryThread->Start();
+		gDebug() << "Starting telemetry timer\n";
+		mTelemetryTimer = Reactor::instance()->AddTimer( 1000000 / mTelemetryFrequency, [this]() { TelemetryRun(); } );
+	}
+	if ( mDebugRate > 0 ) {
+		mDebugTimer = Reactor::instance()->AddTimer( 1000 * std::max( 10, main->config()->integer( "controller.debug.interval", 100 ) ), [this]() { DebugRun(); } );
 	}
 	gDebug() << "Waiting link to be ready\n";
 	while ( !mLink->isConnected() ) {
@@ -157,14 +177,79 @@ void Controller::UpdateSmoothControl( const float& dt )
 
 void Controller::SendDebug( const std::string& s )
 {
-/*
-	Packet packet( DEBUG_OUTPUT );
-	packet.WriteString( s );
+	if ( mDebugRate == 0 ) {
+		return;
+	}
+
+	std::lock_guard< std::mutex > lock( mDebugMutex );
+
+	// Never log from here, Debug would call us back
+	if ( mDebugBuffer.length() + s.length() > mDebugBufferSize ) {
+		mDebugDropped += std::max( 1, (int)std::count( s.begin(), s.end(), '\n' ) );
+		return;
+	}
+	mDebugBuffer += s;
+}
+
+
+void Controller::DebugRun()
+{
+	uint64_t tick = Board::GetTicks();
+	uint64_t dt = ( mDebugTick == 0 ) ? 0 : ( tick - mDebugTick );
+	mDebugTick = tick;
+
+	if ( not mConnected ) {
+		// Keep lines until the ground is back, without saving up bandwidth in the meantime
+		mDebugTokens = 0.0f;
+		return;
+	}
+
+	mDebugTokens = std::min( mDebugTokens + (float)mDebugRate * (float)dt / 1000000.0f, (float)( mDebugFrameSize * 2 ) );
+
+	std::vector< std::string > frames;
+	mDebugMutex.lock();
+	if ( mDebugDropped > 0 ) {
+		mDebugBuffer = "[" + std::to_string( mDebugDropped ) + " debug lines dropped]\n" + mDebugBuffer;
+		mDebugDropped = 0;
+	}
+	while ( mDebugBuffer.length() > 0 and mDebugTokens >= (float)std::min( (uint32_t)mDebugBuffer.length(), mDebugFrameSize ) ) {
+		uint32_t len = std::min( (uint32_t)mDebugBuffer.length(), mDebugFrameSize );
+		// Only split lines when a single one does not fit in a frame
+		if ( len < mDebugBuffer.length() ) {
+			size_t eol = mDebugBuffer.rfind( '\n', len - 1 );
+			if ( eol != std::string::npos ) {
+				len = eol + 1;
+			}
+		}
+		frames.push_back( mDebugBuffer.substr( 0, len ) );
+		mDebugBuffer.erase( 0, len );
+		mDebugTokens -= len;
+	}
+	mDebugMutex.unlock();
+
+	for ( const std::string& frame : frames ) {
+		Packet packet( DEBUG_OUTPUT );
+		packet.WriteString( frame );
+		mScheduler->Write( &packet, LinkScheduler::Debug );
+	}
+}
+
 
-	mSendMutex.lock();
-	mLink->Write( &packet );
-	mSendMutex.unlock();
-*/
+void Controller::SendText( uint16_t cmd, const std::string& text )
+{
+	uint32_t crc = crc32( (const uint8_t*)text.c_str(), text.length() );
+	uint32_t offset = 0;
+
+	do {
+		uint32_t len = std::min( (uint32_t)text.length() - offset, (uint32_t)TEXT_PART_SIZE );
+		Packet packet( cmd );
+		packet.WriteU32( crc );
+		packet.WriteU32( text.length() );
+		packet.WriteU32( offset );
+		packet.Write( (const uint8_t*)text.c_str() + offset, len );
+		mScheduler->Write( &packet, LinkScheduler::Response );
+		offset += len;
+	} while ( offset < text.length() );
 }
 
 
@@ -245,7 +330,9 @@ bool Controller::run()
 
 	int readret = 0;
 	Packet command;
-	if ( ( readret = mLink->Read( &command, 0 ) ) == LINK_ERROR_TIMEOUT ) {
+	readret = mLink->Read( &command, 0 );
+	uint64_t receive_ticks = Board::GetTicks();
+	if ( readret == LINK_ERROR_TIMEOUT ) {
 		if ( mArmed ) {
 			gDebug() << "Controller connection lost !\n";
 			mThrust = 0.0f;
@@ -286,32 +373,30 @@ bool Controller::run()
 					mConnected = true;
 					mConnectionEstablished = true;
 				}
-				uint16_t ticks = 0;
-				if ( command.ReadU16( &ticks ) == sizeof(uint16_t) ) {
-					response.WriteU16( ticks );
-					uint16_t last = command.ReadU16();
-					mPing = last;
-					response.WriteU16( last ); // Copy-back reported ping
+				const PingPayload* ping = ParsePayload< PingPayload >( &command );
+				if ( ping ) {
+					uint32_t rtt = ping->reported_rtt;
+					mPing = rtt / 1000;
+					if ( rtt > 0 ) {
+						// Ground has a clock offset estimate once it measured a round-trip, giving the uplink one-way delay
+						int64_t uplink = (int64_t)( receive_ticks - ping->origin ) - ping->reported_offset;
+						mRTTHistogram.Add( rtt );
+						mUplinkHistogram.Add( (uint32_t)std::max( (int64_t)0, std::min( uplink, (int64_t)0xFFFFFFFF ) ) );
+						mLatency[0] = mRTTHistogram.Percentile( 0.5f );
+						mLatency[1] = mRTTHistogram.Percentile( 0.99f );
+						mLatency[2] = mUplinkHistogram.Percentile( 0.5f );
+						mLatency[3] = mUplinkHistogram.Percentile( 0.99f );
+					}
+					// Copy-back origin and stamp our own clock, transmit time is taken as late as possible
+					PingPayload* pong = SerializePayload< PingPayload >( &response );
+					*pong = *ping;
+					pong->receive = receive_ticks;
+					pong->transmit = Board::GetTicks();
 // 					do_response = true;
 
 					// Send status
-					uint32_t status = 0;
-					if ( mArmed ) {
-						status |= STATUS_ARMED;
-					}
-					if ( mMain->imu()->state() == IMU::Running ) {
-						status |= STATUS_CALIBRATED;
-					} else if ( mMain->imu()->state() == IMU::Calibrating or mMain->imu()->state() == IMU::CalibratingAll ) {
-						status |= STATUS_CALIBRATING;
-					}
-
-					if ( mMain->camera() ) {
-						if ( mMain->camera()->nightMode() ) {
-							status |= STATUS_NIGHTMODE;
-						}
-					}
 					response.WriteU16( STATUS );
-					response.WriteU32( status );
+					SerializePayload< StatusPayload >( &response )->status = status();
 
 					// Send telemetry
 					Telemetry telemetry;
@@ -326,9 +411,7 @@ bool Controller::run()
 					response.WriteU16( TELEMETRY );
 					response.Write( (uint8_t*)&telemetry, sizeof(telemetry) );
 
-					mSendMutex.lock();
-					mLink->WriteAck( response.data().data(), response.data().size() );
-					mSendMutex.unlock();
+					mScheduler->Write( &response, LinkScheduler::Control, true );
 				}
 				break;
 			}
@@ -343,33 +426,43 @@ bool Controller::run()
 				break;
 			}
 			case GET_BOARD_INFOS : {
-				std::string res = mMain->board()->infos();
-				response.WriteString( res );
-				do_response = true;
+				char firmware_crc[16] = "";
+				sprintf( firmware_crc, "%08X", FirmwareUpload::RunningCRC() );
+				std::string res = mMain->board()->infos() + "Firmware CRC:" + firmware_crc + "\n";
+				SendText( cmd, res );
 				break;
 			}
 			case GET_SENSORS_INFOS : {
-				std::string res = Sensor::infosAll();
-				response.WriteString( res );
-				do_response = true;
+				SendText( cmd, Sensor::infosAll() );
 				break;
 			}
 			case GET_CONFIG_FILE : {
-				std::string conf = mMain->config()->ReadFile();
-				response.WriteU32( crc32( (uint8_t*)conf.c_str(), conf.length() ) );
-				response.WriteString( conf );
-				do_response = true;
+				SendText( cmd, mMain->config()->ReadFile() );
 				break;
 			}
 			case SET_CONFIG_FILE : {
 				uint32_t crc = command.ReadU32();
-				std::string conf = command.ReadString();
+				uint32_t length = command.ReadU32();
+				uint32_t offset = command.ReadU32();
+				if ( offset == 0 ) {
+					mConfigUpload = "";
+				}
+				std::string part( std::min( length - std::min( offset, length ), (uint32_t)TEXT_PART_SIZE ), '\0' );
+				if ( command.Read( (uint8_t*)&part[0], part.length() ) != part.length() or offset != mConfigUpload.length() ) {
+					// A part has been lost, wait for the controller to send the whole file again
+					mConfigUpload = "";
+					break;
+				}
+				mConfigUpload += part;
+				if ( mConfigUpload.length() < length ) {
+					break;
+				}
+				std::string conf = mConfigUpload;
+				mConfigUpload = "";
 				if ( crc32( (uint8_t*)conf.c_str(), conf.length() ) == crc ) {
 					gDebug() << "Received new configuration : " << conf << "\n";
 					response.WriteU32( 0 );
-					mSendMutex.lock();
-					mLink->Write( &response );
-					mSendMutex.unlock();
+					mScheduler->Write( &response, LinkScheduler::Response );
 					mMain->config()->WriteFile( conf );
 					mMain->board()->Reset();
 				} else {
@@ -381,52 +474,41 @@ bool Controller::run()
 			}
 			case UPDATE_UPLOAD_INIT : {
 				gDebug() << "UPDATE_UPLOAD_INIT\n";
-				if ( mTelemetryThread->running() ) {
-					mTelemetryThread->Pause();
-					gDebug() << "Telemetry thread paused\n";
+				if ( mTelemetryTimer >= 0 ) {
+					Reactor::instance()->RemoveTimer( mTelemetryTimer );
+					mTelemetryTimer = -1;
+					gDebug() << "Telemetry timer stopped\n";
 				}
+				response.WriteU32( mFirmwareUpload->Init( command.ReadU32() ) == 0 ? 1 : 0 );
+				do_response = true;
 				break;
 			}
 			case UPDATE_UPLOAD_DATA : {
-				gDebug() << "UPDATE_UPLOAD_DATA\n";
 				uint32_t crc = command.ReadU32();
 				uint32_t offset = command.ReadU32();
-				uint32_t offset2 = command.ReadU32();
 				uint32_t size = command.ReadU32();
-				uint32_t size2 = command.ReadU32();
-				if ( offset == offset2 and offset < 4 * 1024 * 1024 ) {
-					if ( size == size2 and size < 4 * 1024 * 1024 ) {
-						uint8_t* buf = new uint8_t[ size + 32 ];
-						command.Read( (uint8_t*)buf, size );
-						uint32_t local_crc = crc32( buf, size );
-						if ( local_crc == crc ) {
-							response.WriteU32( 1 );
-							mSendMutex.lock();
-							mLink->Write( &response );
-							mSendMutex.unlock();
-							Board::UpdateFirmwareData( buf, offset, size );
-						} else {
-							gDebug() << "Firmware upload CRC32 is invalid (corrupted WiFi frame ?)\n";
-							response.WriteU32( 2 );
-							do_response = true;
-						}
-					} else {
-						gDebug() << "Firmware upload size is incoherent (corrupted WiFi frame ?)\n";
-						response.WriteU32( 3 );
-						do_response = true;
-					}
-				} else {
-					gDebug() << "Firmware upload offset is incoherent (corrupted WiFi frame ?)\n";
-					response.WriteU32( 4 );
-					do_response = true;
+				const uint8_t* data = command.Peek( size );
+				FirmwareUpload::Status status = FirmwareUpload::BadSize;
+				if ( data ) {
+					status = mFirmwareUpload->Data( offset, data, size, crc );
+				}
+				if ( status != FirmwareUpload::Stored ) {
+					gDebug() << "Firmware upload chunk rejected (" << status << "), corrupted WiFi frame ?\n";
 				}
+				// Every chunk is acknowledged on its own, the ground only sends again the ones not stored
+				response.WriteU32( status );
+				response.WriteU32( offset );
+				do_response = true;
 				break;
 			}
 			case UPDATE_UPLOAD_PROCESS : {
 				gDebug() << "UPDATE_UPLOAD_PROCESS\n";
 				uint32_t crc = command.ReadU32();
-				gDebug() << "Processing firmware update...\n";
-				Board::UpdateFirmwareProcess( crc );
+				uint32_t firmware_crc = 0;
+				if ( mFirmwareUpload->Finish( crc, &firmware_crc ) ) {
+					gDebug() << "Processing firmware update...\n";
+					Board::UpdateFirmwareProcess( firmware_crc );
+				}
 				break;
 			}
 			case ENABLE_TUN_DEVICE : {
@@ -605,188 +687,194 @@ bool Controller::run()
 			}
 
 			case SET_ROLL_PID_P : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setRollP( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setRollP( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case SET_ROLL_PID_I : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setRollI( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setRollI( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case SET_ROLL_PID_D : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setRollD( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setRollD( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case ROLL_PID_FACTORS : {
 				Vector3f pid = mMain->stabilizer()->getRollPID();
-				response.WriteFloat( pid.x );
-				response.WriteFloat( pid.y );
-				response.WriteFloat( pid.z );
+				Vector3Payload* payload = SerializePayload< Vector3Payload >( &response );
+				payload->x = pid.x;
+				payload->y = pid.y;
+				payload->z = pid.z;
 				do_response = true;
 				break;
 			}
 			case SET_PITCH_PID_P : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setPitchP( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setPitchP( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case SET_PITCH_PID_I : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setPitchI( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setPitchI( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case SET_PITCH_PID_D : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setPitchD( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setPitchD( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case PITCH_PID_FACTORS : {
 				Vector3f pid = mMain->stabilizer()->getPitchPID();
-				response.WriteFloat( pid.x );
-				response.WriteFloat( pid.y );
-				response.WriteFloat( pid.z );
+				Vector3Payload* payload = SerializePayload< Vector3Payload >( &response );
+				payload->x = pid.x;
+				payload->y = pid.y;
+				payload->z = pid.z;
 				do_response = true;
 				break;
 			}
 			case SET_YAW_PID_P : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setYawP( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setYawP( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case SET_YAW_PID_I : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setYawI( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setYawI( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case SET_YAW_PID_D : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setYawD( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setYawD( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case YAW_PID_FACTORS : {
 				Vector3f pid = mMain->stabilizer()->getYawPID();
-				response.WriteFloat( pid.x );
-				response.WriteFloat( pid.y );
-				response.WriteFloat( pid.z );
+				Vector3Payload* payload = SerializePayload< Vector3Payload >( &response );
+				payload->x = pid.x;
+				payload->y = pid.y;
+				payload->z = pid.z;
 				do_response = true;
 				break;
 			}
 			case PID_OUTPUT : {
 				Vector3f pid = mMain->stabilizer()->lastPIDOutput();
-				response.WriteFloat( pid.x );
-				response.WriteFloat( pid.y );
-				response.WriteFloat( pid.z );
+				Vector3Payload* payload = SerializePayload< Vector3Payload >( &response );
+				payload->x = pid.x;
+				payload->y = pid.y;
+				payload->z = pid.z;
 				do_response = true;
 				break;
 			}
 
 			case SET_OUTER_PID_P : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setOuterP( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setOuterP( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case SET_OUTER_PID_I : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setOuterI( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setOuterI( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case SET_OUTER_PID_D : {
-				float value;
-				if ( command.ReadFloat( &value ) < 0 ) {
+				const ValuePayload* value = ParsePayload< ValuePayload >( &command );
+				if ( not value ) {
 					break;
 				}
-				mMain->stabilizer()->setOuterD( value );
-				response.WriteFloat( value );
+				mMain->stabilizer()->setOuterD( value->value );
+				*SerializePayload< ValuePayload >( &response ) = *value;
 				do_response = true;
 				break;
 			}
 			case OUTER_PID_FACTORS : {
 				Vector3f pid = mMain->stabilizer()->getOuterPID();
-				response.WriteFloat( pid.x );
-				response.WriteFloat( pid.y );
-				response.WriteFloat( pid.z );
+				Vector3Payload* payload = SerializePayload< Vector3Payload >( &response );
+				payload->x = pid.x;
+				payload->y = pid.y;
+				payload->z = pid.z;
 				do_response = true;
 				break;
 			}
 			case OUTER_PID_OUTPUT : {
 				Vector3f pid = mMain->stabilizer()->lastOuterPIDOutput();
-				response.WriteFloat( pid.x );
-				response.WriteFloat( pid.y );
-				response.WriteFloat( pid.z );
+				Vector3Payload* payload = SerializePayload< Vector3Payload >( &response );
+				payload->x = pid.x;
+				payload->y = pid.y;
+				payload->z = pid.z;
 				do_response = true;
 				break;
 			}
 			case SET_HORIZON_OFFSET : {
-				Vector3f v;
-				if ( command.ReadFloat( &v.x ) < 0 or command.ReadFloat( &v.y ) < 0 ) {
+				const Vector2Payload* offset = ParsePayload< Vector2Payload >( &command );
+				if ( not offset ) {
 					break;
 				}
-				mMain->stabilizer()->setHorizonOffset( v );
-				response.WriteFloat( v.x );
-				response.WriteFloat( v.y );
+				mMain->stabilizer()->setHorizonOffset( Vector3f( offset->x, offset->y, 0.0f ) );
+				*SerializePayload< Vector2Payload >( &response ) = *offset;
 				do_response = true;
 				break;
 			}
 			case HORIZON_OFFSET : {
-				response.WriteFloat( mMain->stabilizer()->horizonOffset().x );
-				response.WriteFloat( mMain->stabilizer()->horizonOffset().y );
+				Vector2Payload* payload = SerializePayload< Vector2Payload >( &response );
+				payload->x = mMain->stabilizer()->horizonOffset().x;
+				payload->y = mMain->stabilizer()->horizonOffset().y;
 				do_response = true;
 				break;
 			}
@@ -910,15 +998,25 @@ bool Controller::run()
 				break;
 			}
 			case GET_RECORDINGS_LIST : {
-				std::string rec = mMain->getRecordingsList();
-				response.WriteU32( crc32( (uint8_t*)rec.c_str(), rec.length() ) );
-				response.WriteString( rec );
-				do_response = true;
+				SendText( cmd, mMain->getRecordingsList() );
 				break;
 			}
-			case RECORD_DOWNLOAD : {
+			case RECORD_DOWNLOAD_INIT : {
 				std::string file = command.ReadString();
-// 				mMain->UploadFile( filename ); // TODO
+				uint32_t size = 0;
+				response.WriteU32( mRecordDownload->Open( file, &size ) == 0 ? 0 : 1 );
+				response.WriteU32( size );
+				response.WriteU32( mRecordDownload->chunkSize() );
+				do_response = true;
+				break;
+			}
+			case RECORD_DOWNLOAD_DATA : {
+				// Served by RecordDownload thread, the controller thread is never held by file reads
+				mRecordDownload->Request( command.ReadU32() );
+				break;
+			}
+			case RECORD_DOWNLOAD_PROCESS : {
+				mRecordDownload->Close();
 				break;
 			}
 
@@ -935,9 +1033,7 @@ bool Controller::run()
 		}
 
 		if ( do_response ) {
-			mSendMutex.lock();
-			mLink->Write( &response );
-			mSendMutex.unlock();
+			mScheduler->Write( &response, LinkScheduler::Response );
 		}
 	}
 
@@ -945,116 +1041,126 @@ bool Controller::run()
 }
 
 
-bool Controller::TelemetryRun()
+uint32_t Controller::status() const
 {
-	if ( !mLink or !mLink->isConnected() ) {
-		usleep( 1000 * 10 );
-		return true;
-	}
-
-	fDebug0();
-
-	Packet telemetry;
-
-	if ( mTelemetryCounter % 10 == 0 ) {
-		telemetry.WriteU16( STABILIZER_FREQUENCY );
-		telemetry.WriteU32( mMain->loopFrequency() );
-
-		std::vector< Motor* >* motors = mMain->frame()->motors();
-		if ( motors ) {
-			telemetry.WriteU16( MOTORS_SPEED );
-			telemetry.WriteU32( motors->size() );
-			for ( Motor* m : *motors ) {
-				telemetry.WriteFloat( m->speed() );
-			}
-		}
+	uint32_t status = 0;
 
-#ifdef CAMERA
-		if ( mMain->cameraType() != "" ) {
-			telemetry.WriteU16( ERROR_CAMERA_MISSING );
+	if ( mArmed ) {
+		status |= STATUS_ARMED;
+	}
+	if ( mMain->imu()->state() == IMU::Running ) {
+		status |= STATUS_CALIBRATED;
+	} else if ( mMain->imu()->state() == IMU::Calibrating or mMain->imu()->state() == IMU::CalibratingAll ) {
+		status |= STATUS_CALIBRATING;
+	}
+	if ( mMain->camera() ) {
+		if ( mMain->camera()->nightMode() ) {
+			status |= STATUS_NIGHTMODE;
 		}
-#endif
 	}
 
-	if ( mTelemetryCounter % 5 == 0 ) {
-		telemetry.WriteU16( VBAT );
-		telemetry.WriteFloat( mMain->powerThread()->VBat() );
+	return status;
+}
 
-		telemetry.WriteU16( TOTAL_CURRENT );
-		telemetry.WriteFloat( mMain->powerThread()->CurrentTotal() );
 
-		telemetry.WriteU16( CURRENT_DRAW );
-		telemetry.WriteFloat( mMain->powerThread()->CurrentDraw() );
+void Controller::TelemetryRun()
+{
+	if ( !mLink or !mLink->isConnected() ) {
+		return;
+	}
 
-		telemetry.WriteU16( BATTERY_LEVEL );
-		telemetry.WriteFloat( mMain->powerThread()->BatteryLevel() );
+	fDebug0();
 
-		telemetry.WriteU16( CPU_LOAD );
-		telemetry.WriteU32( Board::CPULoad() );
+	std::vector< Motor* >* motors = mMain->frame()->motors();
+	mTelemetryScheduler->setEnabled( TELEMETRY_SECTION_MOTORS, motors != nullptr );
+	if ( motors ) {
+		mTelemetryScheduler->setSize( TELEMETRY_SECTION_MOTORS, 1 + 2 * motors->size() );
+	}
+	mTelemetryScheduler->setEnabled( TELEMETRY_SECTION_SENSORS, mTelemetryFull );
 
-		telemetry.WriteU16( CPU_TEMP );
-		telemetry.WriteU32( Board::CPUTemp() );
+	int32_t rx_quality = mLink->RxQuality();
+	uint32_t sections = 0;
+	if ( not mTelemetryScheduler->Next( rx_quality, mScheduler->queueDelay( LinkScheduler::Telemetry ), &sections ) ) {
+		return;
+	}
 
-		telemetry.WriteU16( RX_QUALITY );
-		telemetry.WriteU32( mLink->RxQuality() );
+	Packet telemetry( TELEMETRY_FRAME );
 
-		telemetry.WriteU16( RX_LEVEL );
-		telemetry.WriteU32( mLink->RxLevel() );
+	uint8_t frame_status = status();
+#ifdef CAMERA
+	if ( mMain->cameraType() != "" ) {
+		frame_status |= STATUS_CAMERA_MISSING;
 	}
+#endif
 
-	telemetry.WriteU16( SET_THRUST );
-	telemetry.WriteFloat( mThrust );
+	TelemetryFrameHeaderPayload* header = SerializePayload< TelemetryFrameHeaderPayload >( &telemetry );
+	header->version = TELEMETRY_FRAME_VERSION;
+	header->sections = sections;
+	header->status = frame_status;
+	header->thrust = Quantize( mThrust, TELEMETRY_SCALE_THRUST );
+	header->roll = Quantize( mMain->imu()->RPY().x, TELEMETRY_SCALE_ANGLE );
+	header->pitch = Quantize( mMain->imu()->RPY().y, TELEMETRY_SCALE_ANGLE );
+	header->yaw = Quantize( mMain->imu()->RPY().z, TELEMETRY_SCALE_ANGLE );
+	header->acceleration = Quantize( mMain->imu()->acceleration().xyz().length(), TELEMETRY_SCALE_ACCELERATION );
+	header->altitude = Quantize( mMain->imu()->altitude(), TELEMETRY_SCALE_ALTITUDE );
+
+	if ( sections & TELEMETRY_SECTION_POWER ) {
+		telemetry.WriteU16( (uint16_t)( mMain->powerThread()->VBat() * TELEMETRY_SCALE_VOLTAGE ) );
+		telemetry.WriteU16( (uint16_t)( mMain->powerThread()->CurrentTotal() * 1000.0f ) );
+		telemetry.WriteU16( (uint16_t)( mMain->powerThread()->CurrentDraw() * TELEMETRY_SCALE_CURRENT ) );
+		telemetry.WriteU8( (uint8_t)( mMain->powerThread()->BatteryLevel() * 100.0f ) );
+	}
 
-	telemetry.WriteU16( ROLL_PITCH_YAW );
-		telemetry.WriteFloat( mMain->imu()->RPY().x );
-		telemetry.WriteFloat( mMain->imu()->RPY().y );
-		telemetry.WriteFloat( mMain->imu()->RPY().z );
+	if ( sections & TELEMETRY_SECTION_SYSTEM ) {
+		telemetry.WriteU8( (uint8_t)Board::CPULoad() );
+		telemetry.WriteU8( (uint8_t)Board::CPUTemp() );
+		telemetry.WriteU8( (uint8_t)std::max( 0, rx_quality ) );
+		telemetry.WriteU8( (uint8_t)(int8_t)mLink->RxLevel() );
+	}
 
-	telemetry.WriteU16( CURRENT_ACCELERATION );
-	telemetry.WriteFloat( mMain->imu()->acceleration().xyz().length() );
+	if ( sections & TELEMETRY_SECTION_STABILIZER ) {
+		telemetry.WriteU16( (uint16_t)std::min( mMain->loopFrequency(), 65535U ) );
+	}
 
-	telemetry.WriteU16( ALTITUDE );
-	telemetry.WriteFloat( mMain->imu()->altitude() );
+	if ( sections & TELEMETRY_SECTION_MOTORS ) {
+		telemetry.WriteU8( (uint8_t)motors->size() );
+		for ( Motor* m : *motors ) {
+			telemetry.WriteU16( Quantize( m->speed(), TELEMETRY_SCALE_MOTOR ) );
+		}
+	}
 
-	if ( mTelemetryFull ) {
-		telemetry.WriteU16( GYRO );
-		telemetry.WriteFloat( mMain->imu()->gyroscope().x );
-		telemetry.WriteFloat( mMain->imu()->gyroscope().y );
-		telemetry.WriteFloat( mMain->imu()->gyroscope().z );
+	if ( sections & TELEMETRY_SECTION_SENSORS ) {
+		telemetry.WriteU16( Quantize( mMain->imu()->gyroscope().x, TELEMETRY_SCALE_RATE ) );
+		telemetry.WriteU16( Quantize( mMain->imu()->gyroscope().y, TELEMETRY_SCALE_RATE ) );
+		telemetry.WriteU16( Quantize( mMain->imu()->gyroscope().z, TELEMETRY_SCALE_RATE ) );
+		telemetry.WriteU16( Quantize( mMain->imu()->acceleration().x, TELEMETRY_SCALE_ACCELERATION ) );
+		telemetry.WriteU16( Quantize( mMain->imu()->acceleration().y, TELEMETRY_SCALE_ACCELERATION ) );
+		telemetry.WriteU16( Quantize( mMain->imu()->acceleration().z, TELEMETRY_SCALE_ACCELERATION ) );
+		telemetry.WriteU16( Quantize( mMain->imu()->magnetometer().x, TELEMETRY_SCALE_MAGNETOMETER ) );
+		telemetry.WriteU16( Quantize( mMain->imu()->magnetometer().y, TELEMETRY_SCALE_MAGNETOMETER ) );
+		telemetry.WriteU16( Quantize( mMain->imu()->magnetometer().z, TELEMETRY_SCALE_MAGNETOMETER ) );
+	}
 
-		telemetry.WriteU16( ACCEL );
-		telemetry.WriteFloat( mMain->imu()->acceleration().x );
-		telemetry.WriteFloat( mMain->imu()->acceleration().y );
-		telemetry.WriteFloat( mMain->imu()->acceleration().z );
+	if ( sections & TELEMETRY_SECTION_QOS ) {
+		// Section layout only carries the control, telemetry, bulk and debug classes
+		for ( uint32_t i = 0; i <= LinkScheduler::Debug; i++ ) {
+			uint32_t delay = mScheduler->queueDelay( (LinkScheduler::TrafficClass)i ) / TELEMETRY_QUEUE_DELAY_UNIT;
+			telemetry.WriteU16( (uint16_t)std::min( delay, 65535U ) );
+		}
+	}
 
-		telemetry.WriteU16( MAGN );
-		telemetry.WriteFloat( mMain->imu()->magnetometer().x );
-		telemetry.WriteFloat( mMain->imu()->magnetometer().y );
-		telemetry.WriteFloat( mMain->imu()->magnetometer().z );
+	if ( sections & TELEMETRY_SECTION_LATENCY ) {
+		for ( uint32_t i = 0; i < 4; i++ ) {
+			telemetry.WriteU16( (uint16_t)std::min( mLatency[i] / TELEMETRY_LATENCY_UNIT, 65535U ) );
+		}
 	}
 
-	mSendMutex.lock();
-	mLink->Write( &telemetry );
-	mSendMutex.unlock();
-	mTelemetryTick = Board::WaitTick( 1000000 / mTelemetryFrequency, mTelemetryTick );
-	mTelemetryCounter++;
-	return true;
+	mScheduler->Write( &telemetry, LinkScheduler::Telemetry );
+	mTelemetryScheduler->Sent( telemetry.size() );
 }
 
 
 uint32_t Controller::crc32( const uint8_t* buf, uint32_t len )
 {
-	uint32_t k = 0;
-	uint32_t crc = 0;
-
-	crc = ~crc;
-
-	while ( len-- ) {
-		crc ^= *buf++;
-		for ( k = 0; k < 8; k++ ) {
-			crc = ( crc & 1 ) ? ( (crc >> 1) ^ 0x82f63b78 ) : ( crc >> 1 );
-		}
-	}
-
-	return ~crc;
+	return crc32c( buf, len );
 }
@@ -23,9 +23,14 @@
 #include <Thread.h>
 #include "Vector.h"
 #include "ControllerBase.h"
+#include "LatencyHistogram.h"
 
 class Main;
 class Link;
+class LinkScheduler;
+class TelemetryScheduler;
+class RecordDownload;
+class FirmwareUpload;
 
 class Controller : public ControllerBase, public Thread
 {
@@ -43,12 +48,19 @@ public:
 	void UpdateSmoothControl( const float& dt );
 	void Emergency();
 
+	// Queues debug output for the ground, never blocks
 	void SendDebug( const std::string& s );
 
 protected:
 	virtual bool run();
-	bool TelemetryRun();
+	// Called by a Reactor timer at telemetry rate
+	void TelemetryRun();
+	// Called by a Reactor timer, sends queued debug lines coalesced in frames
+	void DebugRun();
+	uint32_t status() const;
 	uint32_t crc32( const uint8_t* buf, uint32_t len );
+	// Sends text in TEXT_PART_SIZE parts, see ControllerBase.h
+	void SendText( uint16_t cmd, const std::string& text );
 
 	void setRoll( float value );
 	void setPitch( float value );
@@ -56,21 +68,36 @@ protected:
 	void setThrust( float value );
 
 	Main* mMain;
-	std::mutex mSendMutex;
+	LinkScheduler* mScheduler;
+	TelemetryScheduler* mTelemetryScheduler;
+	RecordDownload* mRecordDownload;
+	std::string mConfigUpload; // SET_CONFIG_FILE parts received so far
+	FirmwareUpload* mFirmwareUpload;
 	bool mArmed;
 	uint32_t mPing;
+	LatencyHistogram mRTTHistogram;
+	LatencyHistogram mUplinkHistogram;
+	uint32_t mLatency[4]; // Round-trip p50, p99 and uplink p50, p99 (us)
 	Vector4f mExpo;
 	Vector3f mRPY;
 	float mThrust;
 	float mThrustAccum;
 	Vector3f mSmoothRPY;
 	uint64_t mTicks;
-	HookThread< Controller >* mTelemetryThread;
-	uint64_t mTelemetryTick;
-	uint64_t mTelemetryCounter;
+	int mTelemetryTimer;
 	uint64_t mEmergencyTick;
 	uint32_t mTelemetryFrequency;
 	bool mTelemetryFull;
+
+	std::mutex mDebugMutex;
+	std::string mDebugBuffer; // Lines waiting to be sent, at most mDebugBufferSize bytes
+	uint32_t mDebugBufferSize;
+	uint32_t mDebugFrameSize;
+	uint32_t mDebugRate; // bytes/s, 0 disables forwarding
+	float mDebugTokens;
+	uint64_t mDebugTick;
+	uint32_t mDebugDropped; // Lines lost since the last flush because the buffer was full
+	int mDebugTimer;
 };
 
 #endif // CONTROLLER_H
@@ -29,7 +29,8 @@ void Debug::SendControllerOutput( const std::string& s )
 
 	if ( sBufferedData.find('\n') != sBufferedData.npos and Main::instance() ) {
 		Controller* ctrl = Main::instance()->controller();
-		if ( ctrl and ctrl->connected() ) {
+		// The controller keeps lines in a bounded buffer until the ground is connected
+		if ( ctrl ) {
 			ctrl->SendDebug( sBufferedData );
 			sBufferedData = "";
 		}
@@ -0,0 +1,212 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include "FirmwareUpload.h"
+#include "Crc32c.h"
+#include "FirmwareDelta.h"
+#include "Debug.h"
+
+
+FirmwareUpload::FirmwareUpload( const std::string& path )
+	: mPath( path )
+	, mFile( -1 )
+	, mMap( nullptr )
+	, mSize( 0 )
+	, mCrcOffset( 0 )
+	, mCrc( 0 )
+{
+}
+
+
+FirmwareUpload::~FirmwareUpload()
+{
+	Close();
+}
+
+
+void FirmwareUpload::Close()
+{
+	if ( mMap ) {
+		munmap( mMap, mSize );
+		mMap = nullptr;
+	}
+	if ( mFile >= 0 ) {
+		close( mFile );
+		mFile = -1;
+	}
+}
+
+
+int FirmwareUpload::Init( uint32_t size )
+{
+	Close();
+	mChunks.clear();
+	mCrcOffset = 0;
+	mCrc = 0;
+	mSize = size;
+
+	if ( size == 0 or size > FIRMWARE_UPLOAD_MAX_SIZE ) {
+		gDebug() << "Invalid firmware size (" << size << " bytes)\n";
+		return -1;
+	}
+
+	mFile = open( mPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0755 );
+	if ( mFile < 0 or ftruncate( mFile, size ) < 0 ) {
+		gDebug() << "Cannot create \"" << mPath << "\" : " << strerror( errno ) << "\n";
+		Close();
+		return -1;
+	}
+	mMap = (uint8_t*)mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0 );
+	if ( mMap == MAP_FAILED ) {
+		gDebug() << "Cannot map \"" << mPath << "\" : " << strerror( errno ) << "\n";
+		mMap = nullptr;
+		Close();
+		return -1;
+	}
+
+	gDebug() << "Receiving firmware update (" << size << " bytes)\n";
+	return 0;
+}
+
+
+FirmwareUpload::Status FirmwareUpload::Data( uint32_t offset, const uint8_t* buf, uint32_t size, uint32_t crc )
+{
+	// Header is covered by the CRC too, so that a corrupted offset or size can't be trusted
+	uint32_t header[2] = { htonl( offset ), htonl( size ) };
+	if ( crc32c( buf, size, crc32c( (uint8_t*)header, sizeof(header) ) ) != crc ) {
+		return BadCRC;
+	}
+	if ( not mMap or offset >= mSize ) {
+		return BadOffset;
+	}
+	if ( size == 0 or size > mSize - offset ) {
+		return BadSize;
+	}
+
+	// Already received chunks are acknowledged again, their first acknowledgement was probably lost
+	if ( offset >= mCrcOffset and mChunks.find( offset ) == mChunks.end() ) {
+		memcpy( mMap + offset, buf, size );
+		mChunks[offset] = size;
+		while ( mChunks.size() > 0 and mChunks.begin()->first == mCrcOffset ) {
+			mCrc = crc32c( mMap + mCrcOffset, mChunks.begin()->second, mCrc );
+			mCrcOffset += mChunks.begin()->second;
+			mChunks.erase( mChunks.begin() );
+		}
+	}
+
+	return Stored;
+}
+
+
+bool FirmwareUpload::Finish( uint32_t crc, uint32_t* firmware_crc )
+{
+	if ( not mMap ) {
+		return false;
+	}
+	if ( mCrcOffset != mSize ) {
+		gDebug() << "ERROR : Firmware upload incomplete (" << mCrcOffset << " / " << mSize << " bytes)\n";
+		return false;
+	}
+	if ( mCrc != crc ) {
+		gDebug() << "ERROR : Wrong CRC32 for firmware upload, please retry\n";
+		return false;
+	}
+
+	*firmware_crc = crc;
+	if ( FirmwareDelta::IsDelta( mMap, mSize ) ) {
+		bool ok = ApplyDelta( firmware_crc );
+		Close();
+		return ok;
+	}
+
+	msync( mMap, mSize, MS_SYNC );
+	Close();
+	return true;
+}
+
+
+bool FirmwareUpload::ApplyDelta( uint32_t* firmware_crc )
+{
+	gDebug() << "Applying firmware delta (" << mSize << " bytes)\n";
+
+	int base = open( "/proc/self/exe", O_RDONLY );
+	struct stat st;
+	if ( base < 0 or fstat( base, &st ) < 0 ) {
+		gDebug() << "ERROR : Cannot open running firmware\n";
+		if ( base >= 0 ) {
+			close( base );
+		}
+		return false;
+	}
+	uint8_t* base_map = (uint8_t*)mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, base, 0 );
+	close( base );
+	if ( base_map == MAP_FAILED ) {
+		gDebug() << "ERROR : Cannot map running firmware\n";
+		return false;
+	}
+
+	// Rebuilt firmware replaces the delta once complete
+	std::string tmp = mPath + ".delta";
+	int out = open( tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755 );
+	int ret = -1;
+	if ( out >= 0 ) {
+		ret = FirmwareDelta::Apply( mMap, mSize, base_map, st.st_size, out, firmware_crc );
+		fsync( out );
+		close( out );
+	}
+	munmap( base_map, st.st_size );
+
+	if ( ret < 0 or rename( tmp.c_str(), mPath.c_str() ) < 0 ) {
+		gDebug() << "ERROR : Firmware delta does not apply to running firmware, a full update is needed\n";
+		unlink( tmp.c_str() );
+		return false;
+	}
+	return true;
+}
+
+
+uint32_t FirmwareUpload::RunningCRC()
+{
+	static uint32_t crc = 0;
+	static bool done = false;
+
+	if ( not done ) {
+		int fd = open( "/proc/self/exe", O_RDONLY );
+		struct stat st;
+		if ( fd >= 0 and fstat( fd, &st ) == 0 and st.st_size > 0 ) {
+			uint8_t* map = (uint8_t*)mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			if ( map != MAP_FAILED ) {
+				crc = crc32c( map, st.st_size );
+				munmap( map, st.st_size );
+				done = true;
+			}
+		}
+		if ( fd >= 0 ) {
+			close( fd );
+		}
+	}
+
+	return crc;
+}
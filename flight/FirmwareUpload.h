@@ -0,0 +1,69 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef FIRMWAREUPLOAD_H
+#define FIRMWAREUPLOAD_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+#define FIRMWARE_UPLOAD_MAX_SIZE ( 16 * 1024 * 1024 )
+
+/*
+ * Receives a firmware image sent in chunks, in any order
+ * Chunks are copied into a memory-mapped file preallocated at full size,
+ * the CRC32C of the image is updated as soon as chunks become contiguous
+ * so that it is known right when the last one arrives.
+ * The image can also be a FirmwareDelta against the running firmware.
+ */
+class FirmwareUpload
+{
+public:
+	typedef enum {
+		Stored = 1,
+		BadCRC = 2,
+		BadSize = 3,
+		BadOffset = 4,
+	} Status;
+
+	FirmwareUpload( const std::string& path );
+	~FirmwareUpload();
+
+	int Init( uint32_t size );
+	Status Data( uint32_t offset, const uint8_t* buf, uint32_t size, uint32_t crc );
+	// Flushes the image to disk, returns true if it is complete and matches crc
+	// A delta image is then applied to the running firmware, 'firmware_crc' receives the CRC of the resulting firmware
+	bool Finish( uint32_t crc, uint32_t* firmware_crc );
+	// CRC32C of the running firmware, which is the base of delta updates
+	static uint32_t RunningCRC();
+
+protected:
+	void Close();
+	bool ApplyDelta( uint32_t* firmware_crc );
+
+	std::string mPath;
+	int mFile;
+	uint8_t* mMap;
+	uint32_t mSize;
+	std::map< uint32_t, uint32_t > mChunks; // Offset and size of chunks received after mCrcOffset
+	uint32_t mCrcOffset;
+	uint32_t mCrc;
+};
+
+#endif // FIRMWAREUPLOAD_H
@@ -33,6 +33,7 @@
 #include <CurrentSensor.h>
 #include <fake_sensors/FakeAccelerometer.h>
 #include <fake_sensors/FakeGyroscope.h>
+#include <SensorRecorder.h>
 #include <Servo.h>
 #include <Stabilizer.h>
 #include <Frame.h>
@@ -116,12 +117,6 @@ Main::Main()
 {
 	mInstance = this;
 	
-#ifdef BOARD_generic
-#pragma message "Adding noisy fake accelerometer and gyroscope"
-	Sensor::AddDevice( new FakeAccelerometer( 3, Vector3f( 2.0f, 2.0f, 2.0f ) ) );
-	Sensor::AddDevice( new FakeGyroscope( 3, Vector3f( 1.3f, 1.3f, 1.3f ) ) );
-#endif
-
 	mBoard = new Board( this );
 	/* ֻûж */
 	flight_register();
@@ -134,6 +129,18 @@ Main::Main()
 	mConfig = new Config( "config.lua" );
 #else
 	mConfig = new Config( "/var/flight/config.lua" );
+#endif
+#ifdef BOARD_generic
+	// Replayed sensors (if any) are registered while loading configuration, fake ones are only used as fallback
+	if ( Sensor::Gyroscopes().size() == 0 ) {
+#pragma message "Adding noisy fake accelerometer and gyroscope"
+		FakeAccelerometer* accel = new FakeAccelerometer( 3, Vector3f( 2.0f, 2.0f, 2.0f ) );
+		FakeGyroscope* gyro = new FakeGyroscope( 3, Vector3f( 1.3f, 1.3f, 1.3f ) );
+		accel->LoadNoiseModel( mConfig, "fake_sensors.accelerometer" );
+		gyro->LoadNoiseModel( mConfig, "fake_sensors.gyroscope" );
+		Sensor::AddDevice( accel );
+		Sensor::AddDevice( gyro );
+	}
 #endif
 	Board::InformLoading();
 	mConfig->DumpVariable( "username" );
@@ -157,6 +164,13 @@ Main::Main()
 	DetectDevices();
 	Board::InformLoading();
 
+	if ( mConfig->string( "sensors_recorder.file", "" ) != "" ) {
+		SensorRecorder* recorder = new SensorRecorder( mConfig->string( "sensors_recorder.file" ) );
+		recorder->Start();
+		recorder->setPriority( 1 );
+		Sensor::setRecorder( recorder );
+	}
+
 	std::string frameName = mConfig->string( "frame.type" );
 	auto knownFrames = Frame::knownFrames();
 	if ( knownFrames.find( frameName ) == knownFrames.end() ) {
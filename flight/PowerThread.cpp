@@ -32,6 +32,8 @@ PowerThread::PowerThread( Main* main )
 	, mLowVoltagePatternCase( 0 )
 	, mSaveTicks( Board::GetTicks() )
 	, mTicks( Board::GetTicks() )
+	, mLoopTicks( 0 )
+	, mSamplePeriod( 1000000 / 100 )
 	, mCellsCount( 0 )
 	, mVBat( 0.0f )
 	, mCurrentTotal( 0.0f )
@@ -40,6 +42,8 @@ PowerThread::PowerThread( Main* main )
 	, mBatteryCapacity( 2500.0f )
 	, mVoltageSensor{ NONE, nullptr, 0, 0, 0 }
 	, mCurrentSensor{ NONE, nullptr, 0, 0, 0 }
+	, mSamplesIndex( 0 )
+	, mSamplesCount( 0 )
 {
 	mBatteryCapacity = main->config()->integer( "battery.capacity" );
 	if ( mBatteryCapacity == 0.0f ) {
@@ -74,6 +78,12 @@ PowerThread::PowerThread( Main* main )
 		mCurrentSensor.multiplier = main->config()->number( "battery.current.multiplier" );
 	}
 
+	// Sensors reads are not blocking, so battery can be sampled at a high rate and averaged
+	mSamplePeriod = 1000000 / std::max( 1, main->config()->integer( "battery.sample_rate", 100 ) );
+	uint32_t average = std::max( 1, main->config()->integer( "battery.average", 10 ) );
+	mVoltageSamples.resize( average, 0.0f );
+	mCurrentSamples.resize( average, 0.0f );
+
 	mLowVoltageValue = main->config()->number( "battery.low_voltage", 9.9f );
 	std::string low_voltage_trigger = main->config()->string( "battery.low_voltage_trigger.type" );
 	if ( low_voltage_trigger == "Buzzer" ) {
@@ -163,6 +173,19 @@ bool PowerThread::run()
 		current = ( current + mCurrentSensor.shift ) * mCurrentSensor.multiplier;
 	}
 
+	mVoltageSamples[mSamplesIndex] = volt;
+	mCurrentSamples[mSamplesIndex] = current;
+	mSamplesIndex = ( mSamplesIndex + 1 ) % mVoltageSamples.size();
+	mSamplesCount = std::min( mSamplesCount + 1, (uint32_t)mVoltageSamples.size() );
+	volt = 0.0f;
+	current = 0.0f;
+	for ( uint32_t i = 0; i < mSamplesCount; i++ ) {
+		volt += mVoltageSamples[i];
+		current += mCurrentSamples[i];
+	}
+	volt /= (float)mSamplesCount;
+	current /= (float)mSamplesCount;
+
 	mVBat = volt;
 	mCurrentDraw = current;// / 3600.0f;
 
@@ -216,6 +239,6 @@ bool PowerThread::run()
 
 	mCapacityMutex.unlock();
 
-	usleep( 1000 * 20 );
+	mLoopTicks = Board::WaitTick( mSamplePeriod, mLoopTicks );
 	return true;
 }
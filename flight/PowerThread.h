@@ -66,6 +66,8 @@ private:
 
 	uint64_t mSaveTicks;
 	uint64_t mTicks;
+	uint64_t mLoopTicks;
+	uint32_t mSamplePeriod;
 	uint32_t mCellsCount;
 	float mLastVBat;
 	float mVBat;
@@ -77,6 +79,12 @@ private:
 	std::mutex mCapacityMutex;
 	BatterySensor mVoltageSensor;
 	BatterySensor mCurrentSensor;
+
+	// Moving average of the last samples
+	std::vector< float > mVoltageSamples;
+	std::vector< float > mCurrentSamples;
+	uint32_t mSamplesIndex;
+	uint32_t mSamplesCount;
 };
 
 
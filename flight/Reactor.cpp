@@ -0,0 +1,199 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <Debug.h>
+#include "Reactor.h"
+
+#define REACTOR_MAX_EVENTS 16
+
+Reactor* Reactor::mInstance = nullptr;
+
+
+Reactor* Reactor::instance()
+{
+	static std::mutex instance_mutex;
+	instance_mutex.lock();
+	if ( mInstance == nullptr ) {
+		mInstance = new Reactor();
+	}
+	instance_mutex.unlock();
+	return mInstance;
+}
+
+
+Reactor::Reactor()
+	: mEpoll( epoll_create1( EPOLL_CLOEXEC ) )
+	, mEvent( eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) )
+	, mThread( nullptr )
+{
+	if ( mEpoll < 0 or mEvent < 0 ) {
+		gDebug() << "Reactor error : " << strerror( errno ) << "\n";
+		return;
+	}
+
+	// eventfd is used to wake up the loop when callbacks are posted
+	AddFd( mEvent, EPOLLIN, [this]( uint32_t events ) {
+		uint64_t value = 0;
+		if ( read( mEvent, &value, sizeof(value) ) < 0 ) {
+			return;
+		}
+		mMutex.lock();
+		std::list< std::function< void() > > posted;
+		posted.swap( mPosted );
+		mMutex.unlock();
+		for ( auto cb : posted ) {
+			cb();
+		}
+	});
+
+	mThread = new HookThread< Reactor >( "reactor", this, &Reactor::run );
+	mThread->Start();
+	mThread->setPriority( 98 );
+}
+
+
+Reactor::~Reactor()
+{
+	close( mEvent );
+	close( mEpoll );
+}
+
+
+int Reactor::AddFd( int fd, uint32_t events, const Callback& cb )
+{
+	if ( fd < 0 ) {
+		return -1;
+	}
+
+	struct epoll_event ev;
+	memset( &ev, 0, sizeof(ev) );
+	ev.events = events;
+	ev.data.fd = fd;
+
+	mMutex.lock();
+	mCallbacks[ fd ] = cb;
+	int ret = epoll_ctl( mEpoll, EPOLL_CTL_ADD, fd, &ev );
+	if ( ret < 0 ) {
+		mCallbacks.erase( fd );
+		gDebug() << "Reactor : cannot watch fd " << fd << " : " << strerror( errno ) << "\n";
+	}
+	mMutex.unlock();
+
+	return ret;
+}
+
+
+void Reactor::RemoveFd( int fd )
+{
+	mMutex.lock();
+	epoll_ctl( mEpoll, EPOLL_CTL_DEL, fd, nullptr );
+	mCallbacks.erase( fd );
+	mMutex.unlock();
+}
+
+
+int Reactor::AddTimer( uint64_t period_us, const std::function< void() >& cb )
+{
+	int fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+	if ( fd < 0 ) {
+		return -1;
+	}
+
+	struct itimerspec spec;
+	spec.it_interval.tv_sec = period_us / 1000000;
+	spec.it_interval.tv_nsec = ( period_us % 1000000 ) * 1000;
+	spec.it_value = spec.it_interval;
+	timerfd_settime( fd, 0, &spec, nullptr );
+
+	if ( AddFd( fd, EPOLLIN, [fd, cb]( uint32_t events ) {
+		uint64_t expirations = 0;
+		if ( read( fd, &expirations, sizeof(expirations) ) > 0 ) {
+			// Missed expirations are coalesced into a single call
+			cb();
+		}
+	}) < 0 ) {
+		close( fd );
+		return -1;
+	}
+
+	return fd;
+}
+
+
+void Reactor::RemoveTimer( int id )
+{
+	RemoveFd( id );
+	// The reactor thread may be running this timer callback right now, only close the timerfd once it is done
+	Post( [id]() {
+		close( id );
+	});
+}
+
+
+void Reactor::Post( const std::function< void() >& cb )
+{
+	mMutex.lock();
+	mPosted.emplace_back( cb );
+	mMutex.unlock();
+	Wakeup();
+}
+
+
+void Reactor::Wakeup()
+{
+	uint64_t one = 1;
+	if ( write( mEvent, &one, sizeof(one) ) < 0 ) {
+		gDebug() << "Reactor wakeup error : " << strerror( errno ) << "\n";
+	}
+}
+
+
+bool Reactor::run()
+{
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+
+	int count = epoll_wait( mEpoll, events, REACTOR_MAX_EVENTS, -1 );
+	if ( count < 0 ) {
+		if ( errno != EINTR ) {
+			gDebug() << "Reactor error : " << strerror( errno ) << "\n";
+			usleep( 1000 * 10 );
+		}
+		return true;
+	}
+
+	for ( int i = 0; i < count; i++ ) {
+		Callback cb;
+		mMutex.lock();
+		auto it = mCallbacks.find( events[i].data.fd );
+		if ( it != mCallbacks.end() ) {
+			cb = it->second;
+		}
+		mMutex.unlock();
+		// Callback may have been removed by a previous one of this batch
+		if ( cb ) {
+			cb( events[i].events );
+		}
+	}
+
+	return true;
+}
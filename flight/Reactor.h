@@ -0,0 +1,65 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <functional>
+#include <mutex>
+#include <list>
+#include <map>
+#include <Thread.h>
+
+/** Single event loop multiplexing file descriptors (links, tun devices...) and timers
+ * Callbacks are run from the reactor thread, they must not block
+ **/
+class Reactor
+{
+public:
+	typedef std::function< void( uint32_t events ) > Callback;
+
+	static Reactor* instance();
+
+	int AddFd( int fd, uint32_t events, const Callback& cb );
+	void RemoveFd( int fd );
+	// Periodic timer backed by a timerfd, returns its id or -1
+	int AddTimer( uint64_t period_us, const std::function< void() >& cb );
+	// Can be called from any thread, a callback already being run is left to complete
+	void RemoveTimer( int id );
+	// Run cb from the reactor thread as soon as possible
+	void Post( const std::function< void() >& cb );
+
+protected:
+	Reactor();
+	~Reactor();
+	bool run();
+	void Wakeup();
+
+	int mEpoll;
+	int mEvent;
+	std::mutex mMutex;
+	std::map< int, Callback > mCallbacks;
+	std::list< std::function< void() > > mPosted;
+	HookThread< Reactor >* mThread;
+
+	static Reactor* mInstance;
+};
+
+#endif // REACTOR_H
@@ -0,0 +1,161 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <Board.h>
+#include <Link.h>
+#include <LinkScheduler.h>
+#include "RecordDownload.h"
+#include "ControllerBase.h"
+#include "Crc32c.h"
+#include "Config.h"
+#include "Debug.h"
+
+#define RECORD_DOWNLOAD_PATH "/var/VIDEO/"
+#define RECORD_DOWNLOAD_HEADER_SIZE ( 2 + 3 * 4 ) // Command, offset, size and crc32c
+
+
+RecordDownload::RecordDownload( LinkScheduler* scheduler, uint16_t command, Config* config, const std::string& object )
+	: mScheduler( scheduler )
+	, mCommand( command )
+	, mThread( nullptr )
+	, mFile( -1 )
+	, mSize( 0 )
+	, mRefillTick( 0 )
+{
+	mChunkSize = std::max( 256, std::min( config->integer( object + ".chunk", 4096 ), PACKET_MAX_SIZE - RECORD_DOWNLOAD_HEADER_SIZE ) );
+	mRate = std::max( 0, config->integer( object + ".rate", 0 ) );
+	mTokens = mChunkSize;
+
+	mThread = new HookThread< RecordDownload >( "record_download", this, &RecordDownload::run );
+	mThread->Start();
+}
+
+
+RecordDownload::~RecordDownload()
+{
+	mThread->Stop();
+	mThread->Join();
+	delete mThread;
+	Close();
+}
+
+
+uint32_t RecordDownload::chunkSize() const
+{
+	return mChunkSize;
+}
+
+
+int RecordDownload::Open( const std::string& filename, uint32_t* size )
+{
+	if ( filename.length() == 0 or filename.find( "/" ) != std::string::npos or filename[0] == '.' ) {
+		gDebug() << "Refusing to send recording \"" << filename << "\"\n";
+		return -1;
+	}
+
+	Close();
+
+	std::lock_guard< std::mutex > lock( mMutex );
+	mFile = open( ( RECORD_DOWNLOAD_PATH + filename ).c_str(), O_RDONLY );
+	if ( mFile < 0 ) {
+		gDebug() << "Cannot open recording \"" << filename << "\"\n";
+		return -1;
+	}
+	struct stat st;
+	fstat( mFile, &st );
+	mSize = st.st_size;
+	posix_fadvise( mFile, 0, 0, POSIX_FADV_SEQUENTIAL );
+	*size = mSize;
+
+	gDebug() << "Sending recording \"" << filename << "\" (" << mSize << " bytes)\n";
+	return 0;
+}
+
+
+void RecordDownload::Close()
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	if ( mFile >= 0 ) {
+		close( mFile );
+		mFile = -1;
+	}
+	mRequests.clear();
+}
+
+
+void RecordDownload::Request( uint32_t offset )
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	if ( mFile < 0 or offset >= mSize or std::find( mRequests.begin(), mRequests.end(), offset ) != mRequests.end() ) {
+		return;
+	}
+	// The controller only keeps a window of chunks requested, anything older is a stale retry
+	if ( mRequests.size() >= 2 * RECORD_DOWNLOAD_WINDOW ) {
+		mRequests.pop_front();
+	}
+	mRequests.push_back( offset );
+	mCond.notify_one();
+}
+
+
+bool RecordDownload::run()
+{
+	Packet packet( mCommand );
+	uint32_t size = 0;
+
+	{
+		std::unique_lock< std::mutex > lock( mMutex );
+		mCond.wait_for( lock, std::chrono::milliseconds( 100 ), [this]() { return mRequests.size() > 0; } );
+		if ( mRequests.size() == 0 ) {
+			return true;
+		}
+		uint32_t offset = mRequests.front();
+		mRequests.pop_front();
+		size = std::min( mChunkSize, mSize - offset );
+		packet.WriteU32( offset );
+		packet.WriteU32( size );
+		uint8_t* crc = packet.Reserve( sizeof(uint32_t) );
+		uint8_t* data = packet.Reserve( size );
+		if ( pread( mFile, data, size, offset ) != (ssize_t)size ) {
+			gDebug() << "Cannot read recording at offset " << offset << "\n";
+			return true;
+		}
+		uint32_t sum = htonl( crc32c( data, size ) );
+		memcpy( crc, &sum, sizeof(sum) );
+	}
+
+	if ( mRate > 0 ) {
+		uint64_t now = Board::GetTicks();
+		mTokens = std::min( (int64_t)std::max( mRate, mChunkSize ), mTokens + (int64_t)( ( now - mRefillTick ) * mRate / 1000000 ) );
+		mRefillTick = now;
+		if ( mTokens < size ) {
+			usleep( ( size - mTokens ) * 1000000 / mRate );
+			mRefillTick = Board::GetTicks();
+			mTokens = size;
+		}
+		mTokens -= size;
+	}
+
+	mScheduler->Write( &packet, LinkScheduler::Bulk );
+	return true;
+}
@@ -0,0 +1,69 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef RECORDDOWNLOAD_H
+#define RECORDDOWNLOAD_H
+
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <string>
+#include <Thread.h>
+
+class Config;
+class LinkScheduler;
+
+/*
+ * Serves recording chunks requested by the controller
+ * Chunks are read with pread() and sent from a dedicated thread as bulk
+ * traffic, optionally limited to a given rate, so that large files never
+ * hold the controller thread nor delay control traffic.
+ */
+class RecordDownload
+{
+public:
+	// Chunks are sent as 'command' messages
+	RecordDownload( LinkScheduler* scheduler, uint16_t command, Config* config, const std::string& object );
+	~RecordDownload();
+
+	// Returns 0 on success
+	int Open( const std::string& filename, uint32_t* size );
+	void Close();
+	void Request( uint32_t offset );
+	uint32_t chunkSize() const;
+
+protected:
+	bool run();
+
+	LinkScheduler* mScheduler;
+	uint16_t mCommand;
+	HookThread< RecordDownload >* mThread;
+	std::mutex mMutex;
+	std::condition_variable mCond;
+	std::deque< uint32_t > mRequests;
+	int mFile;
+	uint32_t mSize;
+	uint32_t mChunkSize;
+	// Token bucket, disabled when rate is 0
+	uint32_t mRate; // bytes/s
+	int64_t mTokens;
+	uint64_t mRefillTick;
+};
+
+#endif // RECORDDOWNLOAD_H
@@ -0,0 +1,191 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <algorithm>
+#include "TelemetryScheduler.h"
+#include "ControllerBase.h"
+#include "Config.h"
+
+
+TelemetryScheduler::TelemetryScheduler( Config* config, const std::string& object, uint32_t frequency )
+	: mFrequency( std::max( 1U, frequency ) )
+	, mSentBytes( 0 )
+	, mTicks( 0 )
+{
+	static const struct {
+		const char* name;
+		uint32_t section;
+		uint32_t priority;
+		float minRate;
+		float maxRate;
+		uint32_t size;
+	} defaults[] = {
+		{ "attitude", 0, 0, 5.0f, 1000.0f, TELEMETRY_HEADER_SIZE },
+		{ "power", TELEMETRY_SECTION_POWER, 1, 1.0f, 4.0f, 7 },
+		{ "system", TELEMETRY_SECTION_SYSTEM, 2, 1.0f, 4.0f, 4 },
+		{ "motors", TELEMETRY_SECTION_MOTORS, 3, 0.5f, 10.0f, 9 },
+		{ "stabilizer", TELEMETRY_SECTION_STABILIZER, 4, 0.5f, 2.0f, 2 },
+		{ "latency", TELEMETRY_SECTION_LATENCY, 5, 0.2f, 2.0f, 8 },
+		{ "qos", TELEMETRY_SECTION_QOS, 6, 0.2f, 4.0f, 8 },
+		{ "sensors", TELEMETRY_SECTION_SENSORS, 7, 0.0f, 1000.0f, 18 },
+	};
+
+	for ( auto d : defaults ) {
+		Field f;
+		std::string obj = object + "." + d.name;
+		f.section = d.section;
+		f.priority = config->integer( obj + ".priority", d.priority );
+		f.maxRate = std::min( (float)mFrequency, config->number( obj + ".max", d.maxRate ) );
+		f.minRate = std::min( f.maxRate, config->number( obj + ".min", d.minRate ) );
+		f.size = d.size;
+		f.enabled = ( d.section != TELEMETRY_SECTION_SENSORS ); // Only on request from the controller
+		f.rate = 0.0f;
+		f.phase = 1.0f; // Send everything in the first frame
+		mFields.push_back( f );
+	}
+	std::stable_sort( mFields.begin(), mFields.end(), []( const Field& a, const Field& b ) { return a.priority < b.priority; } );
+
+	mMaxBudget = std::max( 1, config->integer( object + ".bandwidth", 4000 ) );
+	mMinBudget = std::min( mMaxBudget, (float)std::max( 1, config->integer( object + ".min_bandwidth", 200 ) ) );
+	mCongestionDelay = config->integer( object + ".congestion_delay", TELEMETRY_CONGESTION_DELAY / 1000 ) * 1000;
+	mBudget = mMaxBudget;
+	Allocate();
+}
+
+
+TelemetryScheduler::~TelemetryScheduler()
+{
+}
+
+
+uint32_t TelemetryScheduler::budget() const
+{
+	return (uint32_t)mBudget;
+}
+
+
+TelemetryScheduler::Field* TelemetryScheduler::field( uint32_t section )
+{
+	for ( Field& f : mFields ) {
+		if ( f.section == section ) {
+			return &f;
+		}
+	}
+	return nullptr;
+}
+
+
+void TelemetryScheduler::setEnabled( uint32_t section, bool enabled )
+{
+	Field* f = field( section );
+	if ( f and f->enabled != enabled ) {
+		f->enabled = enabled;
+		f->phase = 1.0f;
+		Allocate();
+	}
+}
+
+
+void TelemetryScheduler::setSize( uint32_t section, uint32_t size )
+{
+	Field* f = field( section );
+	if ( f and f->size != size ) {
+		f->size = size;
+		Allocate();
+	}
+}
+
+
+void TelemetryScheduler::Sent( uint32_t bytes )
+{
+	mSentBytes += bytes;
+}
+
+
+bool TelemetryScheduler::Next( int32_t rx_quality, uint32_t queue_delay, uint32_t* sections )
+{
+	if ( ++mTicks >= mFrequency ) {
+		UpdateCapacity( rx_quality, queue_delay );
+		Allocate();
+		mTicks = 0;
+		mSentBytes = 0;
+	}
+
+	bool due = false;
+	*sections = 0;
+	for ( Field& f : mFields ) {
+		if ( not f.enabled or f.rate <= 0.0f ) {
+			continue;
+		}
+		f.phase += f.rate / (float)mFrequency;
+		if ( f.phase >= 1.0f ) {
+			// Don't let a late field accumulate a burst
+			f.phase = std::min( f.phase - 1.0f, 1.0f );
+			due = true;
+			*sections |= f.section;
+		}
+	}
+
+	return due;
+}
+
+
+void TelemetryScheduler::UpdateCapacity( int32_t rx_quality, uint32_t queue_delay )
+{
+	if ( queue_delay > mCongestionDelay ) {
+		// Telemetry is queuing up : what went through last second is an upper bound of the capacity
+		mBudget = std::min( mBudget, (float)mSentBytes ) * 0.7f;
+	} else if ( rx_quality >= 0 and rx_quality < TELEMETRY_LOSSY_QUALITY ) {
+		mBudget *= 0.7f;
+	} else {
+		// Additive increase, slower when some frames are lost (links without quality metric only rely on the queue delay)
+		float quality = ( rx_quality < 0 ) ? 1.0f : (float)rx_quality / 100.0f;
+		mBudget += mMaxBudget * 0.05f * quality;
+	}
+	mBudget = std::max( mMinBudget, std::min( mMaxBudget, mBudget ) );
+}
+
+
+void TelemetryScheduler::Allocate()
+{
+	float remaining = mBudget;
+
+	// Minimum rates first
+	for ( Field& f : mFields ) {
+		f.rate = f.enabled ? f.minRate : 0.0f;
+		remaining -= f.rate * f.size;
+	}
+
+	// Then raise fields in priority order with what is left
+	for ( Field& f : mFields ) {
+		if ( not f.enabled or remaining <= 0.0f ) {
+			continue;
+		}
+		float extra = std::max( 0.0f, std::min( f.maxRate - f.minRate, remaining / (float)f.size ) );
+		f.rate += extra;
+		remaining -= extra * f.size;
+	}
+
+	// Sections travel inside frames, they can't go faster than the attitude header
+	Field* header = field( 0 );
+	for ( Field& f : mFields ) {
+		if ( &f != header ) {
+			f.rate = std::min( f.rate, header->rate );
+		}
+	}
+}
@@ -0,0 +1,79 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef TELEMETRYSCHEDULER_H
+#define TELEMETRYSCHEDULER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Config;
+
+#define TELEMETRY_HEADER_SIZE 17 // Command + frame header, paid by every frame
+#define TELEMETRY_CONGESTION_DELAY 20000 // Queue delay (us) above which the link is considered saturated
+#define TELEMETRY_LOSSY_QUALITY 50 // Rx quality (%) under which the link is considered lossy
+
+/*
+ * Chooses the telemetry sections sent in each frame
+ * Every field has a priority and a rate range, the estimated link capacity is
+ * first spent on minimum rates, then on raising fields in priority order.
+ * Capacity follows an additive increase / multiplicative decrease, backing off
+ * under the measured throughput when telemetry queues up or the link gets lossy.
+ */
+class TelemetryScheduler
+{
+public:
+	TelemetryScheduler( Config* config, const std::string& object, uint32_t frequency );
+	~TelemetryScheduler();
+
+	void setEnabled( uint32_t section, bool enabled );
+	void setSize( uint32_t section, uint32_t size );
+	// Called once per telemetry tick with the current link state (rx_quality -1 if unknown), returns true when a frame is due
+	bool Next( int32_t rx_quality, uint32_t queue_delay, uint32_t* sections );
+	void Sent( uint32_t bytes );
+
+	uint32_t budget() const;
+
+protected:
+	typedef struct {
+		uint32_t section; // TELEMETRY_SECTION_* bit, 0 for the frame header (attitude)
+		uint32_t priority; // Lower goes first
+		float minRate; // Hz
+		float maxRate; // Hz
+		uint32_t size; // bytes
+		bool enabled;
+		float rate;
+		float phase;
+	} Field;
+
+	Field* field( uint32_t section );
+	void UpdateCapacity( int32_t rx_quality, uint32_t queue_delay );
+	void Allocate();
+
+	uint32_t mFrequency;
+	std::vector< Field > mFields;
+	float mBudget; // bytes/s
+	float mMinBudget;
+	float mMaxBudget;
+	uint32_t mSentBytes;
+	uint32_t mTicks;
+	uint32_t mCongestionDelay;
+};
+
+#endif // TELEMETRYSCHEDULER_H
@@ -165,7 +165,15 @@ const std::string Board::LoadRegister( const std::string& name )
 
 int Board::SaveRegister( const std::string& name, const std::string& value )
 {
-	mRegisters[ name ] = value;
+	return SaveRegisters( { { name, value } } );
+}
+
+
+int Board::SaveRegisters( const std::map< std::string, std::string >& registers )
+{
+	for ( auto reg : registers ) {
+		mRegisters[ reg.first ] = reg.second;
+	}
 
 	// Save register(s) here, and return 0 on success or -1 on error
 
@@ -259,11 +267,6 @@ void Board::DisableTunDevice()
 }
 
 
-void Board::UpdateFirmwareData( const uint8_t* buf, uint32_t offset, uint32_t size )
-{
-}
-
-
 void Board::UpdateFirmwareProcess( uint32_t crc )
 {
 }
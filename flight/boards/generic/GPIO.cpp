@@ -46,6 +46,12 @@ void GPIO::SetupInterrupt( int pin, GPIO::ISRMode mode )
 }
 
 
+void GPIO::SetupInterrupt( int pin, GPIO::ISRMode mode, std::function<void()> fct )
+{
+	// No interrupts on generic board, callers must handle timeouts
+}
+
+
 int GPIO::WaitForInterrupt( int pin, int timeout_ms )
 {
 	return 0;
@@ -41,6 +41,7 @@ public:
 	static void Write( int pin, bool en );
 	static bool Read( int pin );
 	static void SetupInterrupt( int pin, GPIO::ISRMode mode );
+	static void SetupInterrupt( int pin, GPIO::ISRMode mode, std::function<void()> fct );
 	static int WaitForInterrupt( int pin, int timeout_ms );
 
 private:
@@ -20,6 +20,8 @@
 #define THREAD_H
 
 #include <thread>
+#include <functional>
+#include <string>
 #include <pthread.h>
 
 class Thread
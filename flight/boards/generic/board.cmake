@@ -1,4 +1,4 @@
-set( BOARD_LIBS -lpthread -ldl -liw )
+set( BOARD_LIBS -lpthread -ldl -lrt -liw )
 
 # see boards/rpi/board.cmake for further examples
 
@@ -48,6 +48,8 @@ extern "C" {
 #include "Board.h"
 #include "I2C.h"
 #include "Debug.h"
+#include "Reactor.h"
+#include "Crc32c.h"
 
 extern "C" void bcm_host_init( void );
 extern "C" void bcm_host_deinit( void );
@@ -115,41 +117,6 @@ void Board::AtExit()
 }
 
 
-void Board::UpdateFirmwareData( const uint8_t* buf, uint32_t offset, uint32_t size )
-{
-	gDebug() << "Saving Flight Controller firmware update (" << size << " bytes at offset " << offset << ")\n";
-
-	if ( offset == 0 ) {
-		system( "rm -f /tmp/flight_update" );
-		system( "touch /tmp/flight_update" );
-	}
-
-	std::fstream firmware( "/tmp/flight_update", std::ios_base::in | std::ios_base::out | std::ios_base::binary );
-	firmware.seekg( offset, firmware.beg );
-	firmware.write( (char*)buf, size );
-	firmware.close();
-
-}
-
-
-static uint32_t crc32( const uint8_t* buf, uint32_t len )
-{
-	uint32_t k = 0;
-	uint32_t crc = 0;
-
-	crc = ~crc;
-
-	while ( len-- ) {
-		crc ^= *buf++;
-		for ( k = 0; k < 8; k++ ) {
-			crc = ( crc & 1 ) ? ( (crc >> 1) ^ 0x82f63b78 ) : ( crc >> 1 );
-		}
-	}
-
-	return ~crc;
-}
-
-
 void Board::UpdateFirmwareProcess( uint32_t crc )
 {
 	if ( mUpdating ) {
@@ -167,7 +134,7 @@ void Board::UpdateFirmwareProcess( uint32_t crc )
 		firmware.read( (char*)buf, length );
 		buf[length] = 0;
 		firmware.close();
-		if ( crc32( buf, length ) != crc ) {
+		if ( crc32c( buf, length ) != crc ) {
 			gDebug() << "ERROR : Wrong CRC32 for firmware upload, please retry\n";
 			mUpdating = false;
 			return;
@@ -393,7 +360,15 @@ const std::string Board::LoadRegister( const std::string& name )
 
 int Board::SaveRegister( const std::string& name, const std::string& value )
 {
-	mRegisters[ name ] = value;
+	return SaveRegisters( { { name, value } } );
+}
+
+
+int Board::SaveRegisters( const std::map< std::string, std::string >& registers )
+{
+	for ( auto reg : registers ) {
+		mRegisters[ reg.first ] = reg.second;
+	}
 
 	std::ofstream file( "/var/flight/registers" );
 	if ( file.is_open() ) {
@@ -559,22 +534,6 @@ typedef struct tun_args {
 } tun_args;
 
 
-static void* thread_rx( void* argp )
-{
-	tun_args* args = (tun_args*)argp;
-	uint8_t buffer[16384] = {0};
-
-	while ( 1 ) {
-		uint32_t valid = 0;
-		int nread = rawwifi_recv( args->rwifi, buffer, sizeof(buffer), &valid );
-		if ( nread > 0 ) {
-			write( args->fd, buffer, nread );
-		}
-	}
-
-	return NULL;
-}
-
 static void* thread_tx( void* argp )
 {
 	tun_args* args = (tun_args*)argp;
@@ -590,6 +549,7 @@ static void* thread_tx( void* argp )
 		rawwifi_send_retry( args->rwifi, buffer, nread, 1 );
 	}
 
+	delete args;
 	return NULL;
 }
 
@@ -604,16 +564,25 @@ void Board::EnableTunDevice()
 	// 	fcntl( fd, F_SETFL, O_NONBLOCK );
 		gDebug() << "tunnel fd ready\n";
 
-		rawwifi_t* rwifi = rawwifi_init( "wlan0", port, port + 1, 1, -1 ); // TODO : Use same device as RawWifi
+		// Non-blocking, received frames are serviced by the reactor thread
+		rawwifi_t* rwifi = rawwifi_init( "wlan0", port, port + 1, 0, -1 ); // TODO : Use same device as RawWifi
 		gDebug() << "tunnel rawwifi ready\n";
 
-		// TODO : use ThreadHooks
-		tun_args* args = (tun_args*)malloc(sizeof(tun_args));
+		Reactor::instance()->AddFd( rawwifi_recv_fd( rwifi ), EPOLLIN, [fd, rwifi]( uint32_t events ) {
+			uint8_t buffer[16384];
+			uint32_t valid = 0;
+			int nread = 0;
+			while ( ( nread = rawwifi_recv( rwifi, buffer, sizeof(buffer), &valid ) ) > 0 ) {
+				write( fd, buffer, nread );
+			}
+		});
+
+		// Sending blocks on the wifi interface, keep it away from the reactor timers
+		tun_args* args = new tun_args;
 		args->fd = fd;
 		args->rwifi = rwifi;
-		pthread_t thid1, thid2;
-		pthread_create( &thid1, nullptr, thread_rx, (void*)args );
-		pthread_create( &thid2, nullptr, thread_tx, (void*)args );
+		pthread_t thid;
+		pthread_create( &thid, nullptr, thread_tx, args );
 
 		// TODO : use libnl
 		usleep( 1000 * 1000 );
@@ -58,6 +58,7 @@ public:
 	static const uint32_t LoadRegisterU32( const std::string& name, uint32_t def = 0 );
 	static const float LoadRegisterFloat( const std::string& name, float def = 0.0f );
 	static int SaveRegister( const std::string& name, const std::string& value );
+	static int SaveRegisters( const std::map< std::string, std::string >& registers );
 
 	static uint64_t GetTicks();
 	static uint64_t WaitTick( uint64_t ticks_p_second, uint64_t lastTick, uint64_t sleep_bias = -500 );
@@ -68,7 +69,6 @@ public:
 
 	static void EnableTunDevice();
 	static void DisableTunDevice();
-	static void UpdateFirmwareData( const uint8_t* buf, uint32_t offset, uint32_t size );
 	static void UpdateFirmwareProcess( uint32_t crc );
 	static void Reset();
 
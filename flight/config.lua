@@ -1,8 +1,9 @@
 ---- Help ----
 -- Vector( x, y[, z[, w]] ) <= z and w are 0 by default
 -- Voltmeter{ device = "device_name", channel = channel_number[, shift = 0.0 by default][, multiplier = 1.0 by default] }
--- Socket{ type = "TCP/UDP/UDPLite", port = port_number[, broadcast = true/false] } <= broadcast is false by default
---   ^ TCP checks both data integrity and arrival, UDP only checks data integrity, UDPLite does not verify anything
+-- Socket{ type = "TCP/UDP/UDPLite", port = port_number[, broadcast = true/false][, read_timeout = ms][, checksum_coverage = 8][, max_datagram = 0] } <= broadcast is false by default
+--   ^ TCP checks both data integrity and arrival, UDP only checks data integrity, UDPLite only checks the first 'checksum_coverage' bytes (8 = header only, 0 = whole datagram)
+--   ^ max_datagram splits bigger writes into several datagrams sent at once (UDP/UDPLite only, 0 to disable), only suitable for streams (camera, audio)
 
 
 --- Setup battery sensors : voltage sensor is mandatory, current sensor is strongly advised
@@ -13,12 +14,16 @@ battery = {
 	-- ^ For current sensor, in this particular example a Pololu ACS709 is connected to ADS1015 channel 1, which is centered around VCC/2 (=> 2.5V) and outputs 0.028V per Amp
 	low_voltage = 3.3, -- 3.3V per cell, cell count is automatically detected when battery status is resetted
 	low_voltage_trigger = Buzzer{ pin = 4, pattern = { 100, 100, 100, 100, 100, 750 } },
+	sample_rate = 100, -- Battery sensors sampling rate, in Hz
+	average = 10, -- Values are averaged over this amount of samples
 }
+-- ADS1015 = { ready_pin = 17, rate = 100 } -- Optionnal ALERT/RDY pin (conversions are timed otherwise), channels refresh rate in Hz
 
 
 --- Setup stabilizer
 stabilizer.loop_time = 2000
 stabilizer.rate_speed = 600
+stabilizer.calibration_cache = true -- reuse gyroscope offsets saved at last calibration (checked by a short stillness test)
 
 --- Setup controls
 controller.expo = {
@@ -53,17 +58,53 @@ end
 
 --- Setup controller link
 -- controller.link = Socket{ type = "TCP", port = 2020, read_timeout = 2000 }
+-- Several links can be used together, every link of 'receivers' is listened to at the same time
+-- With sequenced = true, messages are numbered so that copies received on several links are delivered only once (the peer must use a sequenced MultiLink too)
+-- controller.link = MultiLink{ senders = { link1, link2 }, receivers = { link1, link2 }, sequenced = true }
+-- Link with a controller running on the same host, through shared memory (ground side opens the same name)
+-- controller.link = SharedMemory{ name = "controller", read_timeout = 2000 }
+-- Degraded link emulation for bench tests, wraps any other link (durations in ms, bandwidth in bytes/s, direction is "both", "tx" or "rx")
+-- Losses follow a Gilbert-Elliott model : p = P(good -> bad), r = P(bad -> good), good/bad = loss probability in each state
+-- controller.link = FaultLink{ link = Socket{ type = "UDP", port = 2020 }, seed = 1, delay = 5, jitter = 2, reorder = 0.01, reorder_delay = 10, duplicate = 0.01, bandwidth = 100000, loss = { p = 0.01, r = 0.3, good = 0.0, bad = 0.5 }, report = 5 }
 controller.link = RawWifi {
 	device = "wlan0",
 	channel = 9,
 	input_port = 0,
 	output_port = 1,
 	retries = 2,
+	-- fec = { k = 4, m = 1 }, -- Reed-Solomon : m parity packets are sent for every k data packets, any k of them rebuild the block
 	blocking = true,
 	drop = true,
 	read_timeout = 2000, -- If nothing is received withing 2seconds, the drone will disarm and fall
 }
 
+-- Transmit scheduling on the controller link : control traffic always goes first, the other classes share the bandwidth according to their weights
+-- rate (bytes/s) and burst (bytes) optionally limit a class, 0 means unlimited
+-- controller.qos = {
+-- 	telemetry = { weight = 4, rate = 0 },
+-- 	bulk = { weight = 2, rate = 0 },
+-- 	response = { weight = 2, rate = 0 },
+-- 	debug = { weight = 1, rate = 2000, burst = 1000 },
+-- }
+
+-- Telemetry frames are sent at most telemetry_rate times per second, each field gets a rate (Hz) between min and max
+-- The estimated link capacity (bytes/s, between min_bandwidth and bandwidth) is given to fields by priority, lower first
+-- Fields : attitude, power, system, motors, stabilizer, latency, qos, sensors (sensors only when full telemetry is requested)
+-- controller.telemetry_rate = 20
+-- controller.telemetry = {
+-- 	bandwidth = 4000,
+-- 	min_bandwidth = 200,
+-- 	congestion_delay = 20, -- ms of telemetry queuing after which capacity is reduced
+-- 	sensors = { priority = 7, min = 0, max = 20 },
+-- }
+
+-- Recordings download : chunk size in bytes (at most 8178), rate in bytes/s (0 leaves it to the bulk traffic scheduling)
+-- controller.record_download = { chunk = 4096, rate = 200000 }
+
+-- Debug output forwarded to the ground is buffered (bytes, lines are dropped and counted when full), then sent every interval (ms)
+-- in frames of at most frame bytes, limited to rate bytes/s (forwarding is disabled when rate is 0, which is the default)
+-- controller.debug = { buffer = 16384, frame = 1024, interval = 100, rate = 4096 }
+
 
 --- Setup camera
 -- camera.link = Socket{ type = "UDPLite", port = 2021, broadcast = false }
@@ -87,6 +128,27 @@ end
 sensors_map_i2c[0x77] = "BMP180"
 
 
+--- Setup GPS, from any serial port speaking NMEA or u-blox UBX
+-- RegisterSensor( "SerialGPS", { device = "/dev/ttyAMA0", speed = 9600 } )
+
+
+--- Record raw sensors samples, they can be played back later using : RegisterSensor( "Replay", { file = "sensors.rec", realtime = true } )
+--- ( realtime = false feeds a new sample at each stabilizer loop )
+-- sensors_recorder.file = "/var/flight/sensors.rec"
+
+
+--- Noise model of the fake sensors used by the generic board (all fields are optional)
+-- fake_sensors.gyroscope = {
+-- 	white = Vector( 1.3, 1.3, 1.3 ), -- white noise standard deviation
+-- 	bias_walk = 0.01, -- bias random walk, in unit/sqrt(s)
+-- 	temperature_drift = 0.02, -- bias drift per degC, the sensor warms up of 'temperature_rise' degC with a 'temperature_tau' seconds time constant
+-- 	vibration = 0.5, -- motors vibrations amplitude, at 'vibration_frequency' Hz and its first harmonic
+-- 	lsb = 0.061, -- quantisation step
+-- 	range = 2000, -- saturation
+-- 	seed = 1, sample_rate = 500, -- fixed seed and sample rate (Hz, time follows the samples count) give reproducible runs
+-- }
+
+
 --- Setup sensors axis swap
 accelerometers["MPU9150"] = {
 	axis_swap = Vector( 2, -1, 3 )
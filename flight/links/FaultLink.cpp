@@ -0,0 +1,408 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <unistd.h>
+#include <cmath>
+#include <algorithm>
+#include <Main.h>
+#include <Config.h>
+#include <Board.h>
+#include "FaultLink.h"
+
+int FaultLink::flight_register( Main* main )
+{
+	RegisterLink( "FaultLink", &FaultLink::Instanciate );
+	return 0;
+}
+
+
+Link* FaultLink::Instanciate( Config* config, const std::string& lua_object )
+{
+	Link* link = Link::Create( config, lua_object + ".link" );
+	if ( not link ) {
+		gDebug() << "WARNING : FaultLink needs a valid 'link' to wrap, cannot create Link !\n";
+		return nullptr;
+	}
+
+	// Durations are given in milliseconds
+	Params params;
+	params.lossP = config->number( lua_object + ".loss.p", 0.0f );
+	params.lossR = config->number( lua_object + ".loss.r", 1.0f );
+	params.lossGood = config->number( lua_object + ".loss.good", 0.0f );
+	params.lossBad = config->number( lua_object + ".loss.bad", 1.0f );
+	params.delay = (uint32_t)( config->number( lua_object + ".delay", 0.0f ) * 1000.0f );
+	params.jitter = (uint32_t)( config->number( lua_object + ".jitter", 0.0f ) * 1000.0f );
+	params.reorder = config->number( lua_object + ".reorder", 0.0f );
+	params.reorderDelay = (uint32_t)( config->number( lua_object + ".reorder_delay", 10.0f ) * 1000.0f );
+	params.duplicate = config->number( lua_object + ".duplicate", 0.0f );
+	params.bandwidth = config->integer( lua_object + ".bandwidth", 0 );
+	params.queue = config->integer( lua_object + ".queue", 64 * 1024 );
+
+	uint32_t seed = config->integer( lua_object + ".seed", 1 );
+	std::string direction = config->string( lua_object + ".direction", "both" );
+	uint32_t timeout = config->integer( lua_object + ".read_timeout" );
+	uint32_t report_period = config->integer( lua_object + ".report", 5 );
+
+	return new FaultLink( link, params, seed, direction != "rx", direction != "tx", timeout, report_period );
+}
+
+
+FaultLink::FaultLink( Link* link, const Params& params, uint32_t seed, bool tx, bool rx, uint32_t timeout, uint32_t report_period )
+	: Link()
+	, mLink( link )
+	, mBlocking( true )
+	, mTimeout( timeout )
+	, mTx( tx ? new DelayLine( "tx", params, seed, report_period ) : nullptr )
+	, mRx( rx ? new DelayLine( "rx", params, seed + 1, report_period ) : nullptr )
+	, mTxThread( nullptr )
+	, mRxThread( nullptr )
+{
+}
+
+
+FaultLink::~FaultLink()
+{
+	if ( mTxThread ) {
+		mTxThread->Stop();
+		mTxThread->Join();
+		delete mTxThread;
+	}
+	if ( mRxThread ) {
+		mRxThread->Stop();
+		mRxThread->Join();
+		delete mRxThread;
+	}
+	delete mTx;
+	delete mRx;
+}
+
+
+int FaultLink::Connect()
+{
+	int ret = mLink->Connect();
+	mConnected = mLink->isConnected();
+
+	if ( mConnected and mTx and not mTxThread ) {
+		mTxThread = new HookThread< FaultLink >( "faultlink_tx", this, &FaultLink::TxRun );
+		mTxThread->Start();
+		mTxThread->setPriority( 98 );
+	}
+	if ( mConnected and mRx and not mRxThread ) {
+		mLink->setBlocking( true );
+		mRxThread = new HookThread< FaultLink >( "faultlink_rx", this, &FaultLink::RxRun );
+		mRxThread->Start();
+		mRxThread->setPriority( 98 );
+	}
+
+	return ret;
+}
+
+
+int FaultLink::setBlocking( bool blocking )
+{
+	mBlocking = blocking;
+	if ( not mRx ) {
+		return mLink->setBlocking( blocking );
+	}
+	return 0;
+}
+
+
+void FaultLink::setRetriesCount( int retries )
+{
+	mLink->setRetriesCount( retries );
+}
+
+
+int FaultLink::retriesCount() const
+{
+	return mLink->retriesCount();
+}
+
+
+int32_t FaultLink::Channel()
+{
+	return mLink->Channel();
+}
+
+
+int32_t FaultLink::Frequency()
+{
+	return mLink->Frequency();
+}
+
+
+int32_t FaultLink::RxQuality()
+{
+	return mLink->RxQuality();
+}
+
+
+int32_t FaultLink::RxLevel()
+{
+	return mLink->RxLevel();
+}
+
+
+FaultLink::Stats FaultLink::txStats()
+{
+	if ( mTx ) {
+		return mTx->stats();
+	}
+	Stats ret;
+	memset( &ret, 0, sizeof( ret ) );
+	return ret;
+}
+
+
+FaultLink::Stats FaultLink::rxStats()
+{
+	if ( mRx ) {
+		return mRx->stats();
+	}
+	Stats ret;
+	memset( &ret, 0, sizeof( ret ) );
+	return ret;
+}
+
+
+int FaultLink::Read( void* buf, uint32_t len, int32_t timeout )
+{
+	if ( not mLink->isConnected() ) {
+		mConnected = false;
+		return -1;
+	}
+	if ( not mRx ) {
+		return mLink->Read( buf, len, timeout );
+	}
+
+	int32_t wait = ReadWait( timeout, mTimeout, mBlocking );
+	return mRx->Pop( buf, len, ( wait > 0 ) ? (int64_t)wait * 1000 : wait );
+}
+
+
+int FaultLink::Write( const void* buf, uint32_t len, bool ack, int32_t timeout )
+{
+	if ( not mLink->isConnected() ) {
+		mConnected = false;
+		return -1;
+	}
+	if ( not mTx ) {
+		return mLink->Write( buf, len, ack, timeout );
+	}
+
+	mTx->Push( buf, len );
+	return len;
+}
+
+
+bool FaultLink::TxRun()
+{
+	int ret = mTx->Pop( mTxBuffer, sizeof( mTxBuffer ), 100 * 1000 );
+	if ( ret > 0 ) {
+		mLink->Write( mTxBuffer, ret, false, -1 );
+	}
+	return true;
+}
+
+
+bool FaultLink::RxRun()
+{
+	int ret = mLink->Read( mRxBuffer, sizeof( mRxBuffer ), 100 );
+	if ( ret > 0 ) {
+		mRx->Push( mRxBuffer, ret );
+	} else if ( ret < 0 and ret != LINK_ERROR_TIMEOUT ) {
+		usleep( 1000 * 10 );
+	}
+	return true;
+}
+
+
+FaultLink::DelayLine::DelayLine( const std::string& name, const Params& params, uint32_t seed, uint32_t report_period )
+	: mName( name )
+	, mParams( params )
+	, mReportPeriod( report_period )
+	, mRandom( seed )
+	, mUniform( 0.0f, 1.0f )
+	, mNormal( 0.0f, 1.0f )
+	, mQueuedBytes( 0 )
+	, mBadState( false )
+	, mLastRelease( 0 )
+	, mWireFree( 0 )
+	, mReportTick( Board::GetTicks() )
+	, mReportBytes( 0 )
+	, mPeriodMax( 0 )
+{
+	memset( &mStats, 0, sizeof( mStats ) );
+	memset( mHistogram, 0, sizeof( mHistogram ) );
+}
+
+
+FaultLink::Stats FaultLink::DelayLine::stats()
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	return mStats;
+}
+
+
+void FaultLink::DelayLine::Push( const void* buf, uint32_t len )
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	uint64_t now = Board::GetTicks();
+	mStats.submitted++;
+
+	// Gilbert-Elliott : state changes once per message, losses come in bursts while in the bad state
+	if ( mBadState ) {
+		mBadState = not ( mUniform( mRandom ) < mParams.lossR );
+	} else {
+		mBadState = ( mUniform( mRandom ) < mParams.lossP );
+	}
+	if ( mUniform( mRandom ) < ( mBadState ? mParams.lossBad : mParams.lossGood ) ) {
+		mStats.lost++;
+		return;
+	}
+
+	int copies = 1;
+	if ( mUniform( mRandom ) < mParams.duplicate ) {
+		copies = 2;
+		mStats.duplicated++;
+	}
+
+	for ( int i = 0; i < copies; i++ ) {
+		if ( mParams.queue > 0 and mQueuedBytes + len > mParams.queue ) {
+			mStats.overflowed++;
+			continue;
+		}
+		bool reordered = false;
+		uint64_t release = Schedule( len, now, &reordered );
+		if ( reordered ) {
+			mStats.reordered++;
+		}
+		Message msg;
+		msg.data.assign( (const uint8_t*)buf, (const uint8_t*)buf + len );
+		msg.submitted = now;
+		mQueue.emplace( release, std::move( msg ) );
+		mQueuedBytes += len;
+	}
+
+	mCond.notify_all();
+}
+
+
+uint64_t FaultLink::DelayLine::Schedule( uint32_t len, uint64_t now, bool* reordered )
+{
+	int64_t delay = mParams.delay;
+	if ( mParams.jitter > 0 ) {
+		delay += (int64_t)( mNormal( mRandom ) * (float)mParams.jitter );
+	}
+	delay = std::max( delay, (int64_t)0 );
+
+	// With a bandwidth cap, messages are serialized one after the other before travelling
+	uint64_t sent = now;
+	if ( mParams.bandwidth > 0 ) {
+		mWireFree = std::max( mWireFree, now ) + (uint64_t)len * 1000000ULL / mParams.bandwidth;
+		sent = mWireFree;
+	}
+	uint64_t release = sent + delay;
+
+	// Jitter alone does not reorder messages, only the ones explicitly held back do overtake
+	if ( mUniform( mRandom ) < mParams.reorder ) {
+		*reordered = true;
+		return std::max( release, mLastRelease ) + mParams.reorderDelay;
+	}
+	mLastRelease = std::max( release, mLastRelease );
+	return mLastRelease;
+}
+
+
+int FaultLink::DelayLine::Pop( void* buf, uint32_t len, int64_t timeout )
+{
+	std::unique_lock< std::mutex > lock( mMutex );
+	uint64_t now = Board::GetTicks();
+	uint64_t deadline = now + std::max( timeout, (int64_t)0 );
+
+	while ( mQueue.empty() or mQueue.begin()->first > now ) {
+		if ( timeout >= 0 and now >= deadline ) {
+			return LINK_ERROR_TIMEOUT;
+		}
+		if ( mQueue.empty() and timeout < 0 ) {
+			mCond.wait( lock );
+		} else {
+			uint64_t wake = mQueue.empty() ? deadline : mQueue.begin()->first;
+			if ( timeout >= 0 ) {
+				wake = std::min( wake, deadline );
+			}
+			mCond.wait_for( lock, std::chrono::microseconds( wake - now ) );
+		}
+		now = Board::GetTicks();
+	}
+
+	auto it = mQueue.begin();
+	Message& msg = it->second;
+	uint32_t size = msg.data.size();
+	int ret = std::min( len, size );
+	memcpy( buf, msg.data.data(), ret );
+
+	uint64_t latency = now - msg.submitted;
+	uint32_t bucket = ( latency > 0 ) ? std::min( (uint32_t)std::log2( (double)latency ), (uint32_t)FAULTLINK_HISTOGRAM_SIZE - 1 ) : 0;
+	mHistogram[bucket]++;
+	mPeriodMax = std::max( mPeriodMax, latency );
+	mStats.delivered++;
+	mReportBytes += size;
+	mQueuedBytes -= size;
+	mQueue.erase( it );
+
+	Report( now );
+	return ret;
+}
+
+
+void FaultLink::DelayLine::Report( uint64_t now )
+{
+	if ( mReportPeriod == 0 or now - mReportTick < (uint64_t)mReportPeriod * 1000000ULL ) {
+		return;
+	}
+
+	uint64_t total = 0;
+	for ( uint32_t i = 0; i < FAULTLINK_HISTOGRAM_SIZE; i++ ) {
+		total += mHistogram[i];
+	}
+
+	uint32_t* percentiles[3] = { &mStats.latencyP50, &mStats.latencyP95, &mStats.latencyP99 };
+	const float fractions[3] = { 0.50f, 0.95f, 0.99f };
+	for ( uint32_t p = 0; p < 3; p++ ) {
+		uint64_t count = 0;
+		*percentiles[p] = 0;
+		for ( uint32_t i = 0; i < FAULTLINK_HISTOGRAM_SIZE; i++ ) {
+			count += mHistogram[i];
+			if ( total > 0 and count >= (uint64_t)( fractions[p] * (float)total ) ) {
+				*percentiles[p] = (uint32_t)std::min( { 1ULL << ( i + 1 ), (unsigned long long)mPeriodMax, 0xFFFFFFFFULL } );
+				break;
+			}
+		}
+	}
+	mStats.latencyMax = (uint32_t)mPeriodMax;
+	mStats.goodput = (uint32_t)( mReportBytes * 1000000ULL / ( now - mReportTick ) );
+
+	gDebug() << "FaultLink " << mName << " : goodput " << mStats.goodput << " B/s, latency p50 < " << mStats.latencyP50 << " us, p95 < " << mStats.latencyP95 << " us, p99 < " << mStats.latencyP99 << " us, max " << mStats.latencyMax << " us, lost " << mStats.lost << ", overflowed " << mStats.overflowed << ", duplicated " << mStats.duplicated << ", reordered " << mStats.reordered << " / " << mStats.submitted << "\n";
+
+	memset( mHistogram, 0, sizeof( mHistogram ) );
+	mPeriodMax = 0;
+	mReportBytes = 0;
+	mReportTick = now;
+}
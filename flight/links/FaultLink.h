@@ -0,0 +1,149 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef FAULTLINK_H
+#define FAULTLINK_H
+
+#include <map>
+#include <vector>
+#include <random>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <Thread.h>
+#include "Link.h"
+
+class Main;
+
+// Latency histogram buckets, bucket i holds latencies in [2^i, 2^(i+1)[ us
+#define FAULTLINK_HISTOGRAM_SIZE 32
+
+/*
+ * Decorator reproducing degraded radio conditions on top of any other Link :
+ * Gilbert-Elliott burst loss, jittered delay, reordering, duplication and bandwidth cap,
+ * all driven by a seeded RNG so that a run can be replayed
+ */
+class FaultLink : public Link
+{
+public:
+	typedef struct {
+		// Gilbert-Elliott model : p = P(good -> bad), r = P(bad -> good), loss probability in each state
+		float lossP;
+		float lossR;
+		float lossGood;
+		float lossBad;
+		uint32_t delay; // us
+		uint32_t jitter; // us (standard deviation)
+		float reorder; // Probability for a message to be held back by reorderDelay
+		uint32_t reorderDelay; // us
+		float duplicate;
+		uint32_t bandwidth; // bytes/s, 0 means unlimited
+		uint32_t queue; // bytes waiting at most, messages exceeding it are dropped
+	} Params;
+
+	typedef struct {
+		uint64_t submitted;
+		uint64_t lost;
+		uint64_t overflowed;
+		uint64_t duplicated;
+		uint64_t reordered;
+		uint64_t delivered;
+		uint32_t goodput; // bytes/s delivered during the last report period
+		uint32_t latencyP50; // us, upper bound of the histogram bucket (or max latency if lower)
+		uint32_t latencyP95;
+		uint32_t latencyP99;
+		uint32_t latencyMax;
+	} Stats;
+
+	FaultLink( Link* link, const Params& params, uint32_t seed = 1, bool tx = true, bool rx = true, uint32_t timeout = 0, uint32_t report_period = 5 );
+	~FaultLink();
+
+	int Connect();
+	int setBlocking( bool blocking );
+	void setRetriesCount( int retries );
+	int retriesCount() const;
+	int32_t Channel();
+	int32_t Frequency();
+	int32_t RxQuality();
+	int32_t RxLevel();
+
+	int Read( void* buf, uint32_t len, int32_t timeout );
+	int Write( const void* buf, uint32_t len, bool ack = false, int32_t timeout = -1 );
+
+	Stats txStats();
+	Stats rxStats();
+
+	static int flight_register( Main* main );
+
+protected:
+	static Link* Instanciate( Config* config, const std::string& lua_object );
+
+	// Messages travelling in one direction, released in order of their due time
+	class DelayLine
+	{
+	public:
+		DelayLine( const std::string& name, const Params& params, uint32_t seed, uint32_t report_period );
+		void Push( const void* buf, uint32_t len );
+		// timeout in us, < 0 waits forever
+		int Pop( void* buf, uint32_t len, int64_t timeout );
+		Stats stats();
+
+	protected:
+		typedef struct {
+			std::vector< uint8_t > data;
+			uint64_t submitted;
+		} Message;
+
+		uint64_t Schedule( uint32_t len, uint64_t now, bool* reordered );
+		void Report( uint64_t now );
+
+		std::string mName;
+		const Params mParams;
+		uint32_t mReportPeriod;
+		std::mt19937 mRandom;
+		std::uniform_real_distribution< float > mUniform;
+		std::normal_distribution< float > mNormal;
+		std::mutex mMutex;
+		std::condition_variable mCond;
+		std::multimap< uint64_t, Message > mQueue;
+		uint32_t mQueuedBytes;
+		bool mBadState;
+		uint64_t mLastRelease;
+		uint64_t mWireFree;
+		Stats mStats;
+		uint64_t mHistogram[FAULTLINK_HISTOGRAM_SIZE];
+		uint64_t mReportTick;
+		uint64_t mReportBytes;
+		uint64_t mPeriodMax;
+	};
+
+	bool TxRun();
+	bool RxRun();
+
+	Link* mLink;
+	bool mBlocking;
+	uint32_t mTimeout;
+	DelayLine* mTx;
+	DelayLine* mRx;
+	HookThread< FaultLink >* mTxThread;
+	HookThread< FaultLink >* mRxThread;
+	uint8_t mTxBuffer[PACKET_MAX_SIZE];
+	uint8_t mRxBuffer[PACKET_MAX_SIZE];
+};
+
+#endif // FAULTLINK_H
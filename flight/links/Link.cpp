@@ -33,56 +33,42 @@ Link::~Link()
 }
 
 
-void Packet::Write( const uint8_t* data, uint32_t bytes )
+uint32_t Packet::Write( const uint8_t* data, uint32_t bytes )
 {
-/*
-	mData.insert( mData.end(), (uint32_t*)data, (uint32_t*)( data + ( bytes & 0xFFFFFFFC ) ) );
-	if ( bytes & 0b11 ) {
-		uint32_t last = 0;
-		for ( uint32_t i = 0; i <= 3 and ( bytes & 0xFFFFFFFC ) + i < bytes; i++ ) {
-			last = ( last << 8 ) | data[( bytes & 0xFFFFFFFC ) + i];
-		}
-		last = htonl( last );
-		mData.emplace_back( last );
-		mData.emplace_back( 0 );
+	if ( bytes > PACKET_MAX_SIZE - mSize ) {
+		mOverflow = true;
+		return 0;
 	}
-*/
-	mData.insert( mData.end(), &data[0], &data[bytes] );
+	memcpy( mData + mSize, data, bytes );
+	mSize += bytes;
+	return bytes;
 }
 
 
-void Packet::WriteU16( uint16_t v )
+uint32_t Packet::WriteU16( uint16_t v )
 {
-	union {
-		uint16_t u;
-		uint8_t b[2];
-	} u;
-	u.u = htons( v );
-	mData.insert( mData.end(), u.b, u.b + sizeof(uint16_t) );
+	v = htons( v );
+	return Write( (const uint8_t*)&v, sizeof(uint16_t) );
 }
 
 
-void Packet::WriteU32( uint32_t v )
+uint32_t Packet::WriteU32( uint32_t v )
 {
-	union {
-		uint32_t u;
-		uint8_t b[4];
-	} u;
-	u.u = htonl( v );
-	mData.insert( mData.end(), u.b, u.b + sizeof(uint32_t) );
+	v = htonl( v );
+	return Write( (const uint8_t*)&v, sizeof(uint32_t) );
 }
 
 
-void Packet::WriteString( const std::string& str )
+uint32_t Packet::WriteString( const std::string& str )
 {
-	Write( (const uint8_t*)str.c_str(), str.length() );
+	return Write( (const uint8_t*)str.c_str(), str.length() );
 }
 
 
 uint32_t Packet::Read( uint8_t* data, uint32_t bytes )
 {
-	if ( mReadOffset + bytes <= mData.size() ) {
-		memcpy( data, mData.data() + mReadOffset, bytes );
+	if ( bytes <= mSize - mReadOffset ) {
+		memcpy( data, mData + mReadOffset, bytes );
 		mReadOffset += bytes;
 		return bytes;
 	}
@@ -90,12 +76,34 @@ uint32_t Packet::Read( uint8_t* data, uint32_t bytes )
 }
 
 
+const uint8_t* Packet::Peek( uint32_t bytes )
+{
+	if ( bytes <= mSize - mReadOffset ) {
+		const uint8_t* ret = mData + mReadOffset;
+		mReadOffset += bytes;
+		return ret;
+	}
+	return nullptr;
+}
+
+
+uint8_t* Packet::Reserve( uint32_t bytes )
+{
+	if ( bytes > PACKET_MAX_SIZE - mSize ) {
+		mOverflow = true;
+		return nullptr;
+	}
+	uint8_t* ret = mData + mSize;
+	mSize += bytes;
+	return ret;
+}
+
+
 uint32_t Packet::ReadU16( uint16_t* u )
 {
-	if ( mReadOffset + sizeof(uint16_t) <= mData.size() ) {
-		*u = ((uint16_t*)(mData.data() + mReadOffset))[0];
-		*u = ntohs( *u );
-		mReadOffset += sizeof(uint16_t);
+	uint16_t v = 0;
+	if ( Read( (uint8_t*)&v, sizeof(uint16_t) ) == sizeof(uint16_t) ) {
+		*u = ntohs( v );
 		return sizeof(uint16_t);
 	}
 	return 0;
@@ -104,10 +112,9 @@ uint32_t Packet::ReadU16( uint16_t* u )
 
 uint32_t Packet::ReadU32( uint32_t* u )
 {
-	if ( mReadOffset + sizeof(uint32_t) <= mData.size() ) {
-		*u = ((uint32_t*)(mData.data() + mReadOffset))[0];
-		*u = ntohl( *u );
-		mReadOffset += sizeof(uint32_t);
+	uint32_t v = 0;
+	if ( Read( (uint8_t*)&v, sizeof(uint32_t) ) == sizeof(uint32_t) ) {
+		*u = ntohl( v );
 		return sizeof(uint32_t);
 	}
 	return 0;
@@ -116,9 +123,11 @@ uint32_t Packet::ReadU32( uint32_t* u )
 
 uint32_t Packet::ReadFloat( float* f )
 {
-	union { float f; uint32_t u; } u;
-	uint32_t ret = ReadU32( &u.u );
-	*f = u.f;
+	uint32_t u = 0;
+	uint32_t ret = ReadU32( &u );
+	if ( ret > 0 ) {
+		memcpy( f, &u, sizeof(float) );
+	}
 	return ret;
 }
 
@@ -149,29 +158,33 @@ float Packet::ReadFloat()
 
 std::string Packet::ReadString()
 {
-	std::string res = "";
-	uint32_t i = 0;
+	const char* start = (const char*)( mData + mReadOffset );
+	const void* end = memchr( start, 0, mSize - mReadOffset );
+	uint32_t len = end ? ( (const char*)end - start ) : ( mSize - mReadOffset );
+
+	mReadOffset += len;
+	return std::string( start, len );
+}
 
-	for ( i = 0; mReadOffset + i < mData.size(); i++ ) {
-		uint8_t c = mData.at( mReadOffset + i );
-		if ( c ) {
-			res += (char)c;
-		} else {
-			break;
-		}
-	}
 
-	mReadOffset += i;
-	return res;
+int32_t Link::ReadWait( int32_t timeout, int32_t read_timeout, bool blocking )
+{
+	if ( not blocking ) {
+		return 0;
+	}
+	if ( timeout <= 0 ) {
+		timeout = read_timeout;
+	}
+	return ( timeout > 0 ) ? timeout : -1;
 }
 
 
 int32_t Link::Read( Packet* p, int32_t timeout )
 {
-	uint8_t buffer[8192] = { 0 };
-	int32_t ret = Read( buffer, 8192, timeout );
+	// Receive directly into packet storage
+	int32_t ret = Read( p->mData + p->mSize, PACKET_MAX_SIZE - p->mSize, timeout );
 	if ( ret > 0 ) {
-		p->Write( buffer, ret );
+		p->mSize += ret;
 	}
 	return ret;
 }
@@ -179,7 +192,37 @@ int32_t Link::Read( Packet* p, int32_t timeout )
 
 int32_t Link::Write( const Packet* p, bool ack, int32_t timeout )
 {
-	return Write( p->data().data(), p->data().size(), ack, timeout );
+	if ( p->overflowed() ) {
+		gDebug() << "ERROR : packet truncated at " << PACKET_MAX_SIZE << " bytes, not sent\n";
+		return -1;
+	}
+	return Write( p->data(), p->size(), ack, timeout );
+}
+
+
+int Link::Writev( const struct iovec* iov, int iovcnt, bool ack, int32_t timeout )
+{
+	uint32_t len = 0;
+	for ( int i = 0; i < iovcnt; i++ ) {
+		len += iov[i].iov_len;
+	}
+
+	// Default implementation for links without native scatter-gather support
+	uint8_t stack_buffer[PACKET_MAX_SIZE];
+	std::vector< uint8_t > heap_buffer;
+	uint8_t* buf = stack_buffer;
+	if ( len > sizeof(stack_buffer) ) {
+		heap_buffer.resize( len );
+		buf = heap_buffer.data();
+	}
+
+	uint32_t offset = 0;
+	for ( int i = 0; i < iovcnt; i++ ) {
+		memcpy( buf + offset, iov[i].iov_base, iov[i].iov_len );
+		offset += iov[i].iov_len;
+	}
+
+	return Write( buf, len, ack, timeout );
 }
 
 
@@ -20,8 +20,10 @@
 #define LINK_H
 
 #include <netinet/in.h>
+#include <sys/uio.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <string.h>
 #include <string>
 #include <map>
 #include <functional>
@@ -31,19 +33,25 @@ class Config;
 
 #define LINK_ERROR_TIMEOUT -3
 
+// Maximum size of a Packet, also maximum size of a single Link read
+#define PACKET_MAX_SIZE 8192
+
 
 class Packet
 {
 public:
-	Packet() : mReadOffset( 0 ) {}
-	Packet( uint32_t id ) { WriteU16( id ); }
-	void Write( const uint8_t* data, uint32_t bytes );
-	void WriteU16( uint16_t v );
-	void WriteU32( uint32_t v );
-	void WriteFloat( float v ) { union { float f; uint32_t u; } u; u.f = v; WriteU32( u.u ); }
-	void WriteString( const std::string& str );
+	Packet() : mSize( 0 ), mReadOffset( 0 ), mOverflow( false ) {}
+	Packet( uint32_t id ) : mSize( 0 ), mReadOffset( 0 ), mOverflow( false ) { WriteU16( id ); }
+	// Writes beyond PACKET_MAX_SIZE return 0 and mark the packet as overflowed, links refuse to send such packets
+	uint32_t Write( const uint8_t* data, uint32_t bytes );
+	uint32_t WriteU8( uint8_t v ) { return Write( &v, sizeof(uint8_t) ); }
+	uint32_t WriteU16( uint16_t v );
+	uint32_t WriteU32( uint32_t v );
+	uint32_t WriteFloat( float v ) { uint32_t u; memcpy( &u, &v, sizeof(u) ); return WriteU32( u ); }
+	uint32_t WriteString( const std::string& str );
 
 	uint32_t Read( uint8_t* data, uint32_t bytes );
+	uint32_t ReadU8( uint8_t* u ) { return Read( u, sizeof(uint8_t) ); }
 	uint32_t ReadU16( uint16_t* u );
 	uint32_t ReadU32( uint32_t* u );
 	uint32_t ReadFloat( float* f );
@@ -52,11 +60,21 @@ public:
 	float ReadFloat();
 	std::string ReadString();
 
-	const std::vector< uint8_t >& data() const { return mData; }
+	// Zero-copy access, nullptr if not enough bytes available
+	const uint8_t* Peek( uint32_t bytes );
+	uint8_t* Reserve( uint32_t bytes );
+
+	void Clear() { mSize = 0; mReadOffset = 0; mOverflow = false; }
+	bool overflowed() const { return mOverflow; }
+	const uint8_t* data() const { return mData; }
+	uint32_t size() const { return mSize; }
 
 private:
-	std::vector< uint8_t > mData;
+	friend class Link;
+	uint8_t mData[PACKET_MAX_SIZE];
+	uint32_t mSize;
 	uint32_t mReadOffset;
+	bool mOverflow;
 };
 
 
@@ -75,17 +93,27 @@ public:
 	virtual int retriesCount() const = 0;
 	virtual int32_t Channel() { return 0; }
 	virtual int32_t Frequency() { return 0; }
-	virtual int32_t RxQuality() { return 100; }
+	virtual int32_t RxQuality() { return 100; } // Percent, -1 if the link has no quality metric
 	virtual int32_t RxLevel() { return -1; }
+	// Descriptor which becomes readable when data arrives, to be watched by a Reactor (-1 if not supported)
+	// Readiness only hints that Read() will not block, links may buffer several messages per wakeup
+	virtual int fd() { return -1; }
 
+	// Read timeout, in milliseconds : > 0 waits at most this long, <= 0 uses the link's read_timeout, and a read_timeout of 0 waits until data arrives
+	// Non-blocking links never wait. LINK_ERROR_TIMEOUT is returned when nothing was received
 	int32_t Read( Packet* p, int32_t timeout = -1 );
 	int32_t Write( const Packet* p, bool ack = false, int32_t timeout = -1 );
 	virtual int Read( void* buf, uint32_t len, int32_t timeout ) = 0;
 	virtual int Write( const void* buf, uint32_t len, bool ack = false, int32_t timeout = -1 ) = 0;
+	// Sends all the parts as a single message, links able to do so pass them to the kernel without gathering them first
+	virtual int Writev( const struct iovec* iov, int iovcnt, bool ack = false, int32_t timeout = -1 );
 
 	virtual int32_t WriteAck( const void* buf, uint32_t len ) { return Write( buf, len, false, -1 ); }
 
 protected:
+	// Resolves a Read() timeout to a wait in milliseconds, -1 to wait forever, 0 not to wait
+	static int32_t ReadWait( int32_t timeout, int32_t read_timeout, bool blocking );
+
 	bool mConnected;
 
 
@@ -0,0 +1,259 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <algorithm>
+#include <Board.h>
+#include <Config.h>
+#include <Debug.h>
+#include "LinkScheduler.h"
+
+
+LinkScheduler::LinkScheduler( Link* link, Config* config, const std::string& object )
+	: mLink( link )
+	, mThread( nullptr )
+	, mRound( Telemetry )
+	, mBusy( false )
+	, mStopping( false )
+{
+	static const char* names[ClassCount] = { "control", "telemetry", "bulk", "debug", "response" };
+	static const uint32_t weights[ClassCount] = { 1, 4, 2, 1, 2 };
+
+	for ( uint32_t i = 0; i < ClassCount; i++ ) {
+		Class* c = &mClasses[i];
+		c->head = 0;
+		c->count = 0;
+		c->weight = weights[i];
+		c->deficit = 0;
+		c->rate = 0;
+		c->burst = 0;
+		c->delay = 0.0f;
+		if ( config ) {
+			std::string obj = object + "." + names[i];
+			c->weight = std::max( 1, config->integer( obj + ".weight", weights[i] ) );
+			c->rate = std::max( 0, config->integer( obj + ".rate", 0 ) );
+			// Default burst allows 100ms worth of traffic
+			c->burst = std::max( 1, config->integer( obj + ".burst", c->rate / 10 ) );
+		}
+		c->tokens = c->burst;
+		c->refillTick = Board::GetTicks();
+	}
+
+	mThread = new HookThread< LinkScheduler >( "link_tx", this, &LinkScheduler::run );
+	mThread->Start();
+	mThread->setPriority( 98 );
+}
+
+
+LinkScheduler::~LinkScheduler()
+{
+	// Wake up the link_tx thread and the writers waiting for room
+	mMutex.lock();
+	mStopping = true;
+	mCond.notify_all();
+	mRoomCond.notify_all();
+	mMutex.unlock();
+
+	mThread->Stop();
+	mThread->Join();
+	delete mThread;
+}
+
+
+Link* LinkScheduler::link() const
+{
+	return mLink;
+}
+
+
+uint32_t LinkScheduler::queueDelay( TrafficClass cls )
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	return (uint32_t)mClasses[cls].delay;
+}
+
+
+int LinkScheduler::Write( const Packet* p, TrafficClass cls, bool ack )
+{
+	if ( p->overflowed() ) {
+		// Debug is also a traffic class name here
+		::Debug() << "LinkScheduler::Write() ERROR : packet truncated at " << PACKET_MAX_SIZE << " bytes, not sent\n";
+		return -1;
+	}
+	return Write( p->data(), p->size(), cls, ack );
+}
+
+
+int LinkScheduler::Write( const void* buf, uint32_t len, TrafficClass cls, bool ack )
+{
+	std::unique_lock< std::mutex > lock( mMutex );
+	Class* c = &mClasses[cls];
+
+	Refill( c, Board::GetTicks() );
+
+	// Control messages skip the queue when the link is idle, messages too big for a queue slot always do
+	if ( len > PACKET_MAX_SIZE or ( cls == Control and c->count == 0 and not mBusy and c->tokens >= 0.0f ) ) {
+		mCond.wait( lock, [this]() { return not mBusy; } );
+		mBusy = true;
+		lock.unlock();
+		int ret = Send( (const uint8_t*)buf, len, ack );
+		lock.lock();
+		mBusy = false;
+		c->delay *= 0.9f;
+		if ( c->rate > 0 ) {
+			c->tokens -= len;
+		}
+		mCond.notify_all();
+		return ret;
+	}
+
+	if ( c->count == LINK_SCHEDULER_QUEUE_SIZE ) {
+		if ( cls == Bulk or cls == Response ) {
+			// These must not be lost, wait for some room
+			mRoomCond.wait( lock, [this, c]() { return mStopping or c->count < LINK_SCHEDULER_QUEUE_SIZE; } );
+			if ( mStopping ) {
+				return -1;
+			}
+		} else {
+			// Only the most recent values matter, drop the oldest one
+			c->head = ( c->head + 1 ) % LINK_SCHEDULER_QUEUE_SIZE;
+			c->count--;
+		}
+	}
+
+	Message* msg = &c->queue[( c->head + c->count ) % LINK_SCHEDULER_QUEUE_SIZE];
+	memcpy( msg->data, buf, len );
+	msg->size = len;
+	msg->tick = Board::GetTicks();
+	msg->ack = ack;
+	c->count++;
+	mCond.notify_all();
+
+	return len;
+}
+
+
+bool LinkScheduler::run()
+{
+	std::unique_lock< std::mutex > lock( mMutex );
+	uint64_t wait = 0;
+	Class* c = nullptr;
+
+	if ( mStopping ) {
+		return false;
+	}
+	if ( not mBusy ) {
+		c = Pick( &wait );
+	}
+	if ( not c ) {
+		if ( wait > 0 ) {
+			mCond.wait_for( lock, std::chrono::microseconds( wait ) );
+		} else {
+			mCond.wait( lock );
+		}
+		return true;
+	}
+
+	Message* msg = &c->queue[c->head];
+	memcpy( mTxMessage.data, msg->data, msg->size );
+	mTxMessage.size = msg->size;
+	mTxMessage.ack = msg->ack;
+	c->delay = c->delay * 0.9f + (float)( Board::GetTicks() - msg->tick ) * 0.1f;
+	c->head = ( c->head + 1 ) % LINK_SCHEDULER_QUEUE_SIZE;
+	c->count--;
+	if ( c->rate > 0 ) {
+		c->tokens -= mTxMessage.size;
+	}
+	mBusy = true;
+	mRoomCond.notify_all();
+	lock.unlock();
+
+	Send( mTxMessage.data, mTxMessage.size, mTxMessage.ack );
+
+	lock.lock();
+	mBusy = false;
+	mCond.notify_all();
+	return true;
+}
+
+
+LinkScheduler::Class* LinkScheduler::Pick( uint64_t* wait )
+{
+	uint64_t tick = Board::GetTicks();
+	bool eligible[ClassCount];
+	bool any = false;
+	*wait = 0;
+
+	for ( uint32_t i = 0; i < ClassCount; i++ ) {
+		Class* c = &mClasses[i];
+		Refill( c, tick );
+		// A class may go in debt by one message, it then has to wait for its bucket to be positive again
+		eligible[i] = ( c->count > 0 and c->tokens >= 0.0f );
+		if ( c->count > 0 and c->tokens < 0.0f ) {
+			uint64_t w = (uint64_t)( -c->tokens * 1000000.0f / (float)c->rate ) + 1;
+			if ( *wait == 0 or w < *wait ) {
+				*wait = w;
+			}
+		}
+		if ( c->count == 0 ) {
+			c->deficit = 0;
+		}
+		if ( i != Control and eligible[i] ) {
+			any = true;
+		}
+	}
+
+	if ( eligible[Control] ) {
+		return &mClasses[Control];
+	}
+	if ( not any ) {
+		return nullptr;
+	}
+
+	// Deficit round robin between the remaining classes
+	while ( true ) {
+		Class* c = &mClasses[mRound];
+		if ( eligible[mRound] and c->deficit >= (int32_t)c->queue[c->head].size ) {
+			c->deficit -= c->queue[c->head].size;
+			return c;
+		}
+		mRound = ( mRound % ( ClassCount - 1 ) ) + 1;
+		if ( eligible[mRound] ) {
+			mClasses[mRound].deficit += mClasses[mRound].weight * LINK_SCHEDULER_QUANTUM;
+		}
+	}
+}
+
+
+void LinkScheduler::Refill( Class* c, uint64_t tick )
+{
+	if ( c->rate == 0 ) {
+		return;
+	}
+
+	c->tokens = std::min( (float)c->burst, c->tokens + (float)( tick - c->refillTick ) * (float)c->rate / 1000000.0f );
+	c->refillTick = tick;
+}
+
+
+int LinkScheduler::Send( const uint8_t* buf, uint32_t len, bool ack )
+{
+	if ( ack ) {
+		return mLink->WriteAck( buf, len );
+	}
+	return mLink->Write( buf, len, false, -1 );
+}
@@ -0,0 +1,100 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef LINKSCHEDULER_H
+#define LINKSCHEDULER_H
+
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <Thread.h>
+#include "Link.h"
+
+class Config;
+
+#define LINK_SCHEDULER_QUEUE_SIZE 8 // Messages waiting per traffic class
+#define LINK_SCHEDULER_QUANTUM 1024 // Bytes granted per round and per unit of weight
+
+/*
+ * Transmit scheduler shared by all the writers of a Link
+ * Control traffic is sent with strict priority, other classes share the
+ * remaining bandwidth by deficit round robin according to their weights,
+ * each class can also be limited by a token bucket
+ */
+class LinkScheduler
+{
+public:
+	typedef enum {
+		Control = 0, // Controls acknowledgements, ping, status
+		Telemetry = 1,
+		Bulk = 2, // Recordings download, firmware upload
+		Debug = 3,
+		Response = 4, // Command responses and configuration, kept apart so that a full Bulk queue does not block the controller thread
+		ClassCount = 5
+	} TrafficClass;
+
+	LinkScheduler( Link* link, Config* config = nullptr, const std::string& object = "" );
+	~LinkScheduler();
+
+	Link* link() const;
+	int Write( const Packet* p, TrafficClass cls, bool ack = false );
+	int Write( const void* buf, uint32_t len, TrafficClass cls, bool ack = false );
+	// Average time spent by messages of a class waiting for their turn (us)
+	uint32_t queueDelay( TrafficClass cls );
+
+protected:
+	typedef struct {
+		uint8_t data[PACKET_MAX_SIZE];
+		uint32_t size;
+		uint64_t tick;
+		bool ack;
+	} Message;
+
+	typedef struct {
+		Message queue[LINK_SCHEDULER_QUEUE_SIZE];
+		uint32_t head;
+		uint32_t count;
+		uint32_t weight;
+		int32_t deficit;
+		// Token bucket, disabled when rate is 0
+		uint32_t rate; // bytes/s
+		uint32_t burst; // bytes
+		float tokens;
+		uint64_t refillTick;
+		float delay;
+	} Class;
+
+	bool run();
+	int Send( const uint8_t* buf, uint32_t len, bool ack );
+	Class* Pick( uint64_t* wait );
+	void Refill( Class* c, uint64_t tick );
+
+	Link* mLink;
+	HookThread< LinkScheduler >* mThread;
+	std::mutex mMutex;
+	std::condition_variable mCond;
+	std::condition_variable mRoomCond;
+	Class mClasses[ClassCount];
+	uint32_t mRound; // Class currently served by the round robin
+	bool mBusy;
+	bool mStopping;
+	Message mTxMessage;
+};
+
+#endif // LINKSCHEDULER_H
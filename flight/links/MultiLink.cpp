@@ -19,9 +19,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <algorithm>
 #include "MultiLink.h"
 #include <Main.h>
 #include <Config.h>
+#include <Thread.h>
+#include <Board.h>
 
 int MultiLink::flight_register( Main* main )
 {
@@ -35,6 +40,7 @@ Link* MultiLink::Instanciate( Config* config, const std::string& lua_object )
 	int senders_count = config->ArrayLength( lua_object + ".senders" );
 	int receivers_count = config->ArrayLength( lua_object + ".receivers" );
 	int read_timeout = config->integer( lua_object + ".read_timeout" );
+	bool sequenced = config->boolean( lua_object + ".sequenced", false );
 
 	if ( senders_count < 1 and receivers_count < 0 ) {
 		gDebug() << "WARNING : There should be at least 1 sender or receiver, cannot create Link !\n";
@@ -51,26 +57,44 @@ Link* MultiLink::Instanciate( Config* config, const std::string& lua_object )
 		receivers.emplace_back( Link::Create( config, lua_object + ".receivers[" + std::to_string(i+1) + "]" ) );
 	}
 
-	MultiLink* ret = new MultiLink( senders, receivers );
-// 	ret->setReadTimeout( read_timeout ); // TODO
+	MultiLink* ret = new MultiLink( senders, receivers, sequenced );
+	ret->setReadTimeout( read_timeout );
 	return ret;
 }
 
 
-MultiLink::MultiLink( std::list<Link*> senders, std::list<Link*> receivers )
+MultiLink::MultiLink( std::list<Link*> senders, std::list<Link*> receivers, bool sequenced )
 	: Link()
 	, mBlocking( true )
+	, mSequenced( sequenced )
+	, mReadTimeout( 0 )
 	, mSenders( senders )
 	, mReceivers( receivers )
+	, mQueue( new Message[MULTILINK_QUEUE_SIZE] )
+	, mQueueHead( 0 )
+	, mQueueCount( 0 )
+	, mRxSequenceValid( false )
+	, mRxSequence( 0 )
+	, mRxWindow( 0 )
+	, mTxSequence( 0 )
+	, mRankTick( 0 )
 {
+	memset( mFirstTicks, 0, sizeof( mFirstTicks ) );
+	memset( mFirstSequences, 0, sizeof( mFirstSequences ) );
+
 	for ( Link* link : mReceivers ) {
 		link->setBlocking( true );
+		Receiver* rx = new Receiver;
+		rx->link = link;
+		rx->thread = nullptr;
+		memset( &rx->stats, 0, sizeof( rx->stats ) );
+		mRx.emplace_back( rx );
 	}
 }
 
 
-MultiLink::MultiLink( std::initializer_list<Link*> senders, std::initializer_list<Link*> receivers )
-	: MultiLink( static_cast<std::list<Link*>>(senders), static_cast<std::list<Link*>>(receivers) )
+MultiLink::MultiLink( std::initializer_list<Link*> senders, std::initializer_list<Link*> receivers, bool sequenced )
+	: MultiLink( static_cast<std::list<Link*>>(senders), static_cast<std::list<Link*>>(receivers), sequenced )
 {
 }
 
@@ -95,6 +119,15 @@ int MultiLink::Connect()
 		}
 	}
 
+	// Every receiver is listened to by its own thread, so a stalled link cannot delay the others
+	for ( Receiver* rx : mRx ) {
+		if ( not rx->thread ) {
+			rx->thread = new HookThread< MultiLink >( "multilink_rx", this, [rx]( MultiLink* ml ) { return ml->ReceiveRun( rx ); } );
+			rx->thread->Start();
+			rx->thread->setPriority( 98 );
+		}
+	}
+
 	mConnected = not ret;
 	return ret;
 }
@@ -107,6 +140,12 @@ int MultiLink::setBlocking( bool blocking )
 }
 
 
+void MultiLink::setReadTimeout( int32_t timeout )
+{
+	mReadTimeout = timeout;
+}
+
+
 void MultiLink::setRetriesCount( int retries )
 {
 	for ( Link* link : mSenders ) {
@@ -141,7 +180,7 @@ int32_t MultiLink::Frequency()
 
 int32_t MultiLink::RxQuality()
 {
-	int32_t ret = 0;
+	int32_t ret = -1;
 
 	for ( Link* link : mReceivers ) {
 		int32_t qual = link->RxQuality();
@@ -177,6 +216,11 @@ uint32_t MultiLink::fullReadSpeed()
 
 int MultiLink::Write( const void* buf, uint32_t len, bool ack, int32_t timeout )
 {
+	if ( mSequenced ) {
+		struct iovec iov = { const_cast< void* >( buf ), len };
+		return Writev( &iov, 1, ack, timeout );
+	}
+
 	int32_t ret = 0;
 
 	for ( Link* link : mSenders ) {
@@ -190,46 +234,217 @@ int MultiLink::Write( const void* buf, uint32_t len, bool ack, int32_t timeout )
 }
 
 
-int MultiLink::Read( void* buf, uint32_t len, int32_t timeout )
+int MultiLink::Writev( const struct iovec* iov, int iovcnt, bool ack, int32_t timeout )
 {
-	int ret = 0;
-	int32_t hopping_timeout = 500;
-	uint32_t time_base = Board::GetTicks();
+	struct iovec parts[MULTILINK_MAX_IOV + 1];
+	uint32_t sequence = 0;
+	const struct iovec* send_iov = iov;
+	int send_iovcnt = iovcnt;
+
+	if ( mSequenced ) {
+		if ( iovcnt > MULTILINK_MAX_IOV ) {
+			return Link::Writev( iov, iovcnt, ack, timeout );
+		}
+		// Same sequence number on every sender, so that the receiving side can drop the extra copies
+		sequence = htonl( mTxSequence++ );
+		parts[0].iov_base = &sequence;
+		parts[0].iov_len = sizeof( sequence );
+		memcpy( &parts[1], iov, sizeof( struct iovec ) * iovcnt );
+		send_iov = parts;
+		send_iovcnt = iovcnt + 1;
+
+		if ( Board::GetTicks() - mRankTick >= MULTILINK_RANK_PERIOD ) {
+			mRankTick = Board::GetTicks();
+			RankSenders();
+		}
+	}
 
+	int32_t ret = 0;
+
+	for ( Link* link : mSenders ) {
+		int32_t r = link->Writev( send_iov, send_iovcnt, ack, timeout );
+		if ( mSequenced and r > 0 ) {
+			r -= std::min( r, (int32_t)sizeof( sequence ) );
+		}
+		if ( r > ret ) {
+			ret = r;
+		}
+	}
+
+	return ret;
+}
+
+
+int MultiLink::Read( void* buf, uint32_t len, int32_t timeout )
+{
 	if ( mReceivers.size() == 0 ) {
 		return -1;
 	}
 
-	if ( timeout > 0 ) {
-		hopping_timeout = timeout / mReceivers.size();
+	std::unique_lock< std::mutex > lock( mQueueMutex );
+
+	if ( mQueueCount == 0 ) {
+		int32_t wait = ReadWait( timeout, mReadTimeout, mBlocking );
+		if ( wait < 0 ) {
+			mQueueCond.wait( lock, [this]() { return mQueueCount > 0; } );
+		} else if ( not mQueueCond.wait_for( lock, std::chrono::milliseconds( wait ), [this]() { return mQueueCount > 0; } ) ) {
+			return LINK_ERROR_TIMEOUT;
+		}
+	}
+
+	Message* msg = &mQueue[mQueueHead];
+	int ret = std::min( len, msg->size );
+	memcpy( buf, msg->data, ret );
+	mQueueHead = ( mQueueHead + 1 ) % MULTILINK_QUEUE_SIZE;
+	mQueueCount--;
+
+	return ret;
+}
+
+
+bool MultiLink::ReceiveRun( Receiver* rx )
+{
+	int ret = rx->link->Read( rx->buffer, sizeof( rx->buffer ), 100 );
+	if ( ret == LINK_ERROR_TIMEOUT or ret == 0 ) {
+		return true;
+	}
+	if ( ret < 0 ) {
+		usleep( 1000 * 10 );
+		return true;
 	}
 
-	do  {
-		// First, try to receive using the first receiver
-		Link* front = mReceivers.front();
-		ret = front->Read( buf, len, hopping_timeout );
-		// If good, then return now
-		if ( ret > 0 ) {
-			return ret;
+	const uint8_t* data = rx->buffer;
+	uint32_t size = ret;
+	uint64_t tick = Board::GetTicks();
+
+	std::lock_guard< std::mutex > lock( mQueueMutex );
+	rx->stats.received++;
+
+	if ( mSequenced ) {
+		if ( size < sizeof( uint32_t ) ) {
+			return true;
+		}
+		uint32_t sequence = 0;
+		memcpy( &sequence, data, sizeof( sequence ) );
+		sequence = ntohl( sequence );
+		data += sizeof( sequence );
+		size -= sizeof( sequence );
+
+		int32_t gap = (int32_t)( sequence - rx->stats.lastSequence );
+		if ( rx->stats.sequenceValid and gap > 1 and gap < MULTILINK_RESET_DISTANCE ) {
+			rx->stats.lost += gap - 1;
+		}
+		if ( not rx->stats.sequenceValid or gap > 0 or gap <= -MULTILINK_RESET_DISTANCE ) {
+			rx->stats.lastSequence = sequence;
+			rx->stats.sequenceValid = true;
 		}
 
-		// Else, try with the others until one is responding
-		for ( Link* link : mReceivers ) {
-			if ( link != front ) {
-				ret = link->Read( buf, len, hopping_timeout );
-				// If good, put this receiver in front, and return now
-				if ( ret > 0 ) {
-					mReceivers.remove( link );
-					mReceivers.push_front( link );
-					return ret;
-				}
+		uint32_t slot = sequence % MULTILINK_WINDOW;
+		if ( not AcceptSequence( sequence ) ) {
+			rx->stats.duplicates++;
+			if ( mFirstSequences[slot] == sequence ) {
+				rx->stats.lag = rx->stats.lag * 0.9f + (float)( tick - mFirstTicks[slot] ) * 0.1f;
 			}
+			return true;
 		}
+		mFirstSequences[slot] = sequence;
+		mFirstTicks[slot] = tick;
+		rx->stats.lag = rx->stats.lag * 0.9f;
+	}
 
-		if ( Board::GetTicks() - time_base >= (uint64_t)timeout * 1000llu ) {
-			return LINK_ERROR_TIMEOUT;
+	rx->stats.first++;
+
+	// Queue is full, the oldest message is dropped
+	if ( mQueueCount == MULTILINK_QUEUE_SIZE ) {
+		mQueueHead = ( mQueueHead + 1 ) % MULTILINK_QUEUE_SIZE;
+		mQueueCount--;
+	}
+	Message* msg = &mQueue[( mQueueHead + mQueueCount ) % MULTILINK_QUEUE_SIZE];
+	memcpy( msg->data, data, size );
+	msg->size = size;
+	mQueueCount++;
+	mQueueCond.notify_one();
+
+	return true;
+}
+
+
+bool MultiLink::AcceptSequence( uint32_t sequence )
+{
+	int32_t diff = (int32_t)( sequence - mRxSequence );
+
+	if ( not mRxSequenceValid or diff <= -MULTILINK_RESET_DISTANCE ) {
+		// First message, or peer restarted its numbering
+		mRxSequenceValid = true;
+		mRxSequence = sequence;
+		mRxWindow = 1;
+		return true;
+	}
+
+	if ( diff > 0 ) {
+		mRxWindow = ( diff >= MULTILINK_WINDOW ) ? 1 : ( ( mRxWindow << diff ) | 1 );
+		mRxSequence = sequence;
+		return true;
+	}
+
+	if ( -diff >= MULTILINK_WINDOW ) {
+		// Too old to be told apart from a duplicate
+		return false;
+	}
+
+	uint64_t bit = 1llu << ( -diff );
+	if ( mRxWindow & bit ) {
+		return false;
+	}
+	mRxWindow |= bit;
+	return true;
+}
+
+
+float MultiLink::Score( const Stats& stats )
+{
+	// Lower is better : each percent of loss weights as much as 1ms of lag
+	float loss = 0.0f;
+	if ( stats.received + stats.lost > 0 ) {
+		loss = 100.0f * (float)stats.lost / (float)( stats.received + stats.lost );
+	}
+	return loss * 1000.0f + stats.lag;
+}
+
+
+void MultiLink::RankSenders()
+{
+	// Senders which are also receivers are ordered by the quality seen on their receiving side, so the best one sends first
+	std::map< Link*, float > scores;
+	{
+		std::lock_guard< std::mutex > lock( mQueueMutex );
+		for ( Receiver* rx : mRx ) {
+			scores[rx->link] = Score( rx->stats );
 		}
-	} while ( mBlocking );
+	}
+
+	mSenders.sort( [&scores]( Link* a, Link* b ) {
+		auto sa = scores.find( a );
+		auto sb = scores.find( b );
+		if ( sa == scores.end() or sb == scores.end() ) {
+			return sa != scores.end();
+		}
+		return sa->second < sb->second;
+	});
+}
+
+
+MultiLink::Stats MultiLink::stats( Link* receiver )
+{
+	std::lock_guard< std::mutex > lock( mQueueMutex );
+
+	for ( Receiver* rx : mRx ) {
+		if ( rx->link == receiver ) {
+			return rx->stats;
+		}
+	}
 
+	Stats ret;
+	memset( &ret, 0, sizeof( ret ) );
 	return ret;
 }
@@ -20,21 +20,42 @@
 #define MULTILINK_H
 
 #include <list>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
 #include "../links/Link.h"
 
 class Main;
 class Config;
+class Thread;
+
+#define MULTILINK_QUEUE_SIZE 32 // Messages received but not yet consumed by Read()
+#define MULTILINK_WINDOW 64 // Sequence numbers remembered for de-duplication
+#define MULTILINK_RESET_DISTANCE 1024 // A sequence number this far behind means that the peer restarted
+#define MULTILINK_MAX_IOV 15
+#define MULTILINK_RANK_PERIOD ( 2 * 1000 * 1000 )
 
 class MultiLink : public Link
 {
 public:
-	MultiLink( std::list<Link*> senders, std::list<Link*> receivers );
-	MultiLink( std::initializer_list<Link*> senders, std::initializer_list<Link*> receivers );
+	typedef struct {
+		uint64_t received;
+		uint64_t first; // Copies which were the first to arrive, thus delivered
+		uint64_t duplicates;
+		uint64_t lost; // Holes in the sequence numbers seen on this link
+		float lag; // Average delay behind the fastest link (us)
+		uint32_t lastSequence;
+		bool sequenceValid;
+	} Stats;
+
+	MultiLink( std::list<Link*> senders, std::list<Link*> receivers, bool sequenced = false );
+	MultiLink( std::initializer_list<Link*> senders, std::initializer_list<Link*> receivers, bool sequenced = false );
 	~MultiLink();
 
 	int Connect();
 	int setBlocking( bool blocking );
 	void setRetriesCount( int retries );
+	void setReadTimeout( int32_t timeout );
 	int retriesCount() const;
 	int32_t Channel();
 	int32_t Frequency();
@@ -43,16 +64,56 @@ public:
 	uint32_t fullReadSpeed();
 
 	int Write( const void* buf, uint32_t len, bool ack = false, int32_t timeout = -1 );
+	int Writev( const struct iovec* iov, int iovcnt, bool ack = false, int32_t timeout = -1 );
 	int Read( void* buf, uint32_t len, int32_t timeout );
 
+	Stats stats( Link* receiver );
+
 	static int flight_register( Main* main );
 
 protected:
 	static Link* Instanciate( Config* config, const std::string& lua_object );
 
+	typedef struct {
+		uint8_t data[PACKET_MAX_SIZE];
+		uint32_t size;
+	} Message;
+
+	typedef struct {
+		Link* link;
+		Thread* thread;
+		Stats stats;
+		uint8_t buffer[PACKET_MAX_SIZE];
+	} Receiver;
+
+	bool ReceiveRun( Receiver* rx );
+	bool AcceptSequence( uint32_t sequence );
+	void RankSenders();
+	static float Score( const Stats& stats );
+
 	bool mBlocking;
+	bool mSequenced;
+	int32_t mReadTimeout;
 	std::list< Link* > mSenders;
 	std::list< Link* > mReceivers;
+	std::vector< Receiver* > mRx;
+
+	// Filled by one thread per receiver, emptied by Read()
+	std::mutex mQueueMutex;
+	std::condition_variable mQueueCond;
+	Message* mQueue;
+	uint32_t mQueueHead;
+	uint32_t mQueueCount;
+
+	// Sliding window of delivered sequence numbers, protected by mQueueMutex
+	bool mRxSequenceValid;
+	uint32_t mRxSequence;
+	uint64_t mRxWindow;
+	uint64_t mFirstTicks[MULTILINK_WINDOW];
+	uint32_t mFirstSequences[MULTILINK_WINDOW];
+
+	uint32_t mTxSequence;
+	uint64_t mRankTick;
 };
 
 #endif // MULTILINK_H
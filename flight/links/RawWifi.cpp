@@ -76,6 +76,7 @@ Link* RawWifi::Instanciate( Config* config, const std::string& lua_object )
 	if ( config->boolean( lua_object + ".hamming84", false ) ) {
 		static_cast< RawWifi* >( link )->setTXFlags( RAWWIFI_BLOCK_FLAGS_HAMMING84 );
 	}
+	static_cast< RawWifi* >( link )->setFEC( config->integer( lua_object + ".fec.k", 4 ), config->integer( lua_object + ".fec.m", 0 ) );
 	return link;
 }
 
@@ -94,6 +95,8 @@ RawWifi::RawWifi( const std::string& device, int16_t out_port, int16_t in_port,
 	, mDrop( drop_invalid_packets )
 	, mRetries( 2 )
 	, mSendFlags( RAWWIFI_BLOCK_FLAGS_NONE )
+	, mFecK( 4 )
+	, mFecM( 0 )
 {
 }
 
@@ -174,6 +177,16 @@ void RawWifi::setTXFlags( RAWWIFI_BLOCK_FLAGS flags )
 }
 
 
+void RawWifi::setFEC( int k, int m )
+{
+	mFecK = std::max( 1, k );
+	mFecM = std::max( 0, m );
+	if ( mRawWifi ) {
+		rawwifi_set_send_fec( mRawWifi, mFecK, mFecM );
+	}
+}
+
+
 int32_t RawWifi::Channel()
 {
 	return mChannel;
@@ -201,6 +214,12 @@ int32_t RawWifi::RxLevel()
 }
 
 
+int RawWifi::fd()
+{
+	return rawwifi_recv_fd( mRawWifi );
+}
+
+
 uint32_t RawWifi::fullReadSpeed()
 {
 	return rawwifi_recv_speed( mRawWifi );
@@ -262,6 +281,7 @@ int RawWifi::Connect()
 		rawwifi_set_send_max_block_size( mRawWifi, mMaxBlockSize );
 	}
 	rawwifi_set_send_block_flags( mRawWifi, mSendFlags );
+	rawwifi_set_send_fec( mRawWifi, mFecK, mFecM );
 
 	mConnected = true;
 	return 0;
@@ -311,4 +331,19 @@ int RawWifi::Write( const void* buf, uint32_t len, bool ack, int timeout )
 	return ret;
 }
 
+
+int RawWifi::Writev( const struct iovec* iov, int iovcnt, bool ack, int32_t timeout )
+{
+	if ( !mConnected or mOutputPort < 0 ) {
+		return -1;
+	}
+
+	int ret = rawwifi_sendv_retry( mRawWifi, iov, iovcnt, mRetries );
+
+	if ( ret < 0 ) {
+		mConnected = false;
+	}
+	return ret;
+}
+
 #endif // ( BUILD_RAWWIFI == 1 )
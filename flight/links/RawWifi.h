@@ -43,11 +43,14 @@ public:
 	void setRetriesCount( int retries );
 	void setMaxBlockSize( int max );
 	void setTXFlags( RAWWIFI_BLOCK_FLAGS flags );
+	// Sends m Reed-Solomon parity packets for every k data packets, m = 0 disables it
+	void setFEC( int k, int m );
 
 	int32_t Channel();
 	int32_t Frequency();
 	int32_t RxQuality();
 	int32_t RxLevel();
+	int fd();
 	uint32_t TXHeadersSize();
 	RAWWIFI_BLOCK_FLAGS TXFlags();
 	int retriesCount() const { return mRetries; }
@@ -55,6 +58,7 @@ public:
 
 	int Read( void* buf, uint32_t len, int32_t timeout );
 	int Write( const void* buf, uint32_t len, bool ack = false, int32_t timeout = -1 );
+	int Writev( const struct iovec* iov, int iovcnt, bool ack = false, int32_t timeout = -1 );
 
 	static int flight_register( Main* main );
 
@@ -74,6 +78,8 @@ protected:
 	bool mDrop;
 	uint32_t mRetries;
 	RAWWIFI_BLOCK_FLAGS mSendFlags;
+	int mFecK;
+	int mFecM;
 
 	static std::mutex mInitializingMutex;
 	static bool mInitializing;
@@ -0,0 +1,109 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <Main.h>
+#include <Config.h>
+#include "SharedMemory.h"
+
+int SharedMemory::flight_register( Main* main )
+{
+	RegisterLink( "SharedMemory", &SharedMemory::Instanciate );
+	return 0;
+}
+
+
+Link* SharedMemory::Instanciate( Config* config, const std::string& lua_object )
+{
+	std::string name = config->string( lua_object + ".name", "controller" );
+	uint32_t timeout = config->integer( lua_object + ".read_timeout" );
+
+	return new SharedMemory( name, timeout );
+}
+
+
+SharedMemory::SharedMemory( const std::string& name, uint32_t timeout )
+	: Link()
+	, mName( name )
+	, mTimeout( timeout )
+	, mBlocking( true )
+{
+}
+
+
+SharedMemory::~SharedMemory()
+{
+}
+
+
+int SharedMemory::Connect()
+{
+	if ( mConnected ) {
+		return 0;
+	}
+
+	// Flight side owns the segment, the ground side attaches to it
+	if ( mRing.Open( mName, SharedMemoryRing::Server ) < 0 ) {
+		gDebug() << "SharedMemory : cannot create segment \"" << mName << "\" (" << strerror( errno ) << ")\n";
+		return -1;
+	}
+
+	mConnected = true;
+	return 0;
+}
+
+
+int SharedMemory::setBlocking( bool blocking )
+{
+	mBlocking = blocking;
+	return 0;
+}
+
+
+void SharedMemory::setRetriesCount( int retries )
+{
+}
+
+
+int SharedMemory::retriesCount() const
+{
+	return 1;
+}
+
+
+int SharedMemory::Read( void* buf, uint32_t len, int32_t timeout )
+{
+	if ( !mConnected ) {
+		return -1;
+	}
+
+	int ret = mRing.Read( buf, len, ReadWait( timeout, mTimeout, mBlocking ) );
+	if ( ret == SHARED_MEMORY_TIMEOUT ) {
+		return LINK_ERROR_TIMEOUT;
+	}
+	return ret;
+}
+
+
+int SharedMemory::Write( const void* buf, uint32_t len, bool ack, int32_t timeout )
+{
+	if ( !mConnected ) {
+		return -1;
+	}
+
+	return mRing.Write( buf, len );
+}
@@ -0,0 +1,53 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <SharedMemoryRing.h>
+#include "Link.h"
+
+class Main;
+
+// Link to a process running on the same host (e.g. a libcontroller client), mostly useful for protocol benchmarks
+class SharedMemory : public Link
+{
+public:
+	SharedMemory( const std::string& name, uint32_t timeout = 0 );
+	virtual ~SharedMemory();
+
+	int Connect();
+	int setBlocking( bool blocking );
+	void setRetriesCount( int retries );
+	int retriesCount() const;
+
+	int Read( void* buf, uint32_t len, int32_t timeout );
+	int Write( const void* buf, uint32_t len, bool ack = false, int32_t timeout = -1 );
+
+	static int flight_register( Main* main );
+
+protected:
+	static Link* Instanciate( Config* config, const std::string& lua_object );
+
+	std::string mName;
+	uint32_t mTimeout;
+	bool mBlocking;
+	SharedMemoryRing mRing;
+};
+
+#endif // SHAREDMEMORY_H
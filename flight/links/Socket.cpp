@@ -19,12 +19,14 @@
 #if ( BUILD_SOCKET == 1 )
 
 #include <stdlib.h>
+#include <algorithm>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/fcntl.h>
 #include <sys/socket.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -73,20 +75,41 @@ Link* Socket::Instanciate( Config* config, const std::string& lua_object )
 	int port = config->integer( lua_object + ".port" );
 	bool broadcast = config->boolean( lua_object + ".broadcast" );
 	uint32_t timeout = config->integer( lua_object + ".read_timeout" );
+	uint16_t coverage = config->integer( lua_object + ".checksum_coverage", 8 );
+	uint32_t max_datagram = config->integer( lua_object + ".max_datagram", 0 );
 
-	return new Socket( port, type, broadcast, timeout );
+	return new Socket( port, type, broadcast, timeout, coverage, max_datagram );
 }
 
 
-Socket::Socket( uint16_t port, PortType type, bool broadcast, uint32_t timeout )
+Socket::Socket( uint16_t port, PortType type, bool broadcast, uint32_t timeout, uint16_t udplite_coverage, uint32_t max_datagram )
 	: mPort( port )
 	, mPortType( type )
 	, mBroadcast( broadcast )
 	, mTimeout( timeout )
+	, mBlocking( true )
 	, mSocket( -1 )
 	, mClientSocket( -1 )
+	, mUDPLiteCoverage( udplite_coverage )
+	, mMaxDatagram( max_datagram )
+	, mRxQueue( nullptr )
+	, mRxCount( 0 )
+	, mRxIndex( 0 )
 	, mChannel( 0 )
 {
+	if ( mPortType == UDP or mPortType == UDPLite ) {
+		mRxQueue = new Datagram[SOCKET_BATCH_SIZE];
+		for ( uint32_t i = 0; i < SOCKET_BATCH_SIZE; i++ ) {
+			mRxIovecs[i].iov_base = mRxQueue[i].data;
+			mRxIovecs[i].iov_len = sizeof( mRxQueue[i].data );
+			memset( &mRxMsgs[i], 0, sizeof( mRxMsgs[i] ) );
+			mRxMsgs[i].msg_hdr.msg_iov = &mRxIovecs[i];
+			mRxMsgs[i].msg_hdr.msg_iovlen = 1;
+			mRxMsgs[i].msg_hdr.msg_name = &mRxQueue[i].addr;
+			mRxMsgs[i].msg_hdr.msg_namelen = sizeof( mRxQueue[i].addr );
+		}
+	}
+
 	iwstats stats;
 	wireless_config info;
 	iwrange range;
@@ -109,6 +132,7 @@ Socket::~Socket()
 		shutdown( mSocket, 2 );
 		closesocket( mSocket );
 	}
+	delete[] mRxQueue;
 }
 
 
@@ -122,7 +146,8 @@ int32_t Socket::RxQuality()
 {
 	iwstats stats;
 
-	int32_t ret = 0;
+	// No wireless stats (wired or loopback link) : quality is unknown
+	int32_t ret = -1;
 	int iwSocket = iw_sockets_open();
 	memset( &stats, 0, sizeof( stats ) );
 
@@ -153,8 +178,15 @@ int32_t Socket::RxLevel()
 }
 
 
+int Socket::fd()
+{
+	return ( mPortType == TCP ) ? mClientSocket : mSocket;
+}
+
+
 int Socket::setBlocking( bool blocking )
 {
+	mBlocking = blocking;
 	int flags = fcntl( mSocket, F_GETFL, 0 );
 	flags = blocking ? ( flags & ~O_NONBLOCK) : ( flags | O_NONBLOCK );
 	return ( fcntl( mSocket, F_SETFL, flags ) == 0 );
@@ -208,7 +240,8 @@ int Socket::Connect()
 			setsockopt( mSocket, SOL_SOCKET, SO_BROADCAST, &broadcastEnable, sizeof(broadcastEnable) );
 		}
 		if ( mPortType == UDPLite ) {
-			uint16_t checksum_coverage = 8;
+			// Coverage includes the 8 bytes of UDPLite header, 0 means whole datagram
+			int checksum_coverage = mUDPLiteCoverage;
 			setsockopt( mSocket, IPPROTO_UDPLITE, UDPLITE_SEND_CSCOV, &checksum_coverage, sizeof(checksum_coverage) );
 			setsockopt( mSocket, IPPROTO_UDPLITE, UDPLITE_RECV_CSCOV, &checksum_coverage, sizeof(checksum_coverage) );
 		}
@@ -259,6 +292,33 @@ int Socket::Connect()
 }
 
 
+int Socket::WaitReadable( int fd, int32_t timeout )
+{
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	// Deadline is kept across interruptions
+	int32_t wait = ReadWait( timeout, mTimeout, mBlocking );
+	uint64_t deadline = Board::GetTicks() + (uint64_t)std::max( wait, 0 ) * 1000ULL;
+	while ( true ) {
+		if ( wait > 0 ) {
+			uint64_t now = Board::GetTicks();
+			wait = ( now >= deadline ) ? 0 : (int)( ( deadline - now + 999 ) / 1000 );
+		}
+		int ret = poll( &pfd, 1, wait );
+		if ( ret < 0 and errno == EINTR ) {
+			continue;
+		}
+		if ( ret > 0 and ( pfd.revents & ( POLLERR | POLLNVAL ) ) ) {
+			return -1;
+		}
+		return ret;
+	}
+}
+
+
 int Socket::Read( void* buf, uint32_t len, int timeout )
 {
 	if ( !mConnected ) {
@@ -266,33 +326,50 @@ int Socket::Read( void* buf, uint32_t len, int timeout )
 	}
 
 	int ret = 0;
-	memset( buf, 0, len );
 
-	// If timeout is not set, default it to mTimeout
-	if ( timeout < 0 ) {
-		timeout = mTimeout;
-	}
+	if ( mPortType == UDP or mPortType == UDPLite ) {
+		if ( mRxIndex >= mRxCount ) {
+			mRxIndex = 0;
+			mRxCount = 0;
+			ret = WaitReadable( mSocket, timeout );
+			if ( ret == 0 ) {
+				return LINK_ERROR_TIMEOUT;
+			}
+			if ( ret > 0 ) {
+				for ( uint32_t i = 0; i < SOCKET_BATCH_SIZE; i++ ) {
+					mRxMsgs[i].msg_hdr.msg_namelen = sizeof( mRxQueue[i].addr );
+				}
+				ret = recvmmsg( mSocket, mRxMsgs, SOCKET_BATCH_SIZE, MSG_DONTWAIT, nullptr );
+				if ( ret < 0 and ( errno == EAGAIN or errno == EWOULDBLOCK ) ) {
+					return LINK_ERROR_TIMEOUT;
+				}
+			}
+			if ( ret <= 0 ) {
+				gDebug() << "UDP disconnected ( " << ret << " : " << errno << ", " << strerror( errno ) << " )\n";
+				mConnected = false;
+				return -1;
+			}
+			mRxCount = ret;
+		}
 
-	uint64_t timebase = Board::GetTicks();
-	if ( timeout > 0 ) {
-		struct timeval tv;
-		tv.tv_sec = timeout / 1000;
-		tv.tv_usec = 1000 * ( timeout % 1000 );
-		setsockopt( mSocket, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(struct timeval) );
+		// Serve next queued datagram
+		Datagram* dgram = &mRxQueue[mRxIndex];
+		ret = std::min( len, mRxMsgs[mRxIndex].msg_len );
+		memcpy( buf, dgram->data, ret );
+		memcpy( &mClientSin, &dgram->addr, sizeof( mClientSin ) );
+		mRxIndex++;
+		return ret;
 	}
 
-	if ( mPortType == UDP or mPortType == UDPLite ) {
-		uint32_t fromsize = sizeof( mClientSin );
-		ret = recvfrom( mSocket, buf, len, 0, (SOCKADDR *)&mClientSin, &fromsize );
-	} else {
+	ret = WaitReadable( mClientSocket, timeout );
+	if ( ret == 0 ) {
+		return LINK_ERROR_TIMEOUT;
+	}
+	if ( ret > 0 ) {
 		ret = recv( mClientSocket, buf, len, MSG_NOSIGNAL );
 	}
-
 	if ( ret <= 0 ) {
-		if ( ( Board::GetTicks() - timebase >= timeout * 1000ULL ) or errno == 11 ) {
-			return LINK_ERROR_TIMEOUT;
-		}
-		gDebug() << "UDP disconnected ( " << ret << " : " << errno << ", " << strerror( errno ) << " )\n";
+		gDebug() << "TCP disconnected ( " << ret << " : " << errno << ", " << strerror( errno ) << " )\n";
 		mConnected = false;
 		return -1;
 	}
@@ -301,6 +378,41 @@ int Socket::Read( void* buf, uint32_t len, int timeout )
 }
 
 
+int Socket::WriteFragmented( const void* buf, uint32_t len )
+{
+	// Split in mMaxDatagram sized datagrams, all sent by a single syscall
+	struct mmsghdr msgs[SOCKET_BATCH_SIZE];
+	struct iovec iovecs[SOCKET_BATCH_SIZE];
+	uint32_t offset = 0;
+
+	while ( offset < len ) {
+		uint32_t count = 0;
+		for ( ; count < SOCKET_BATCH_SIZE and offset < len; count++ ) {
+			uint32_t size = std::min( mMaxDatagram, len - offset );
+			iovecs[count].iov_base = (uint8_t*)buf + offset;
+			iovecs[count].iov_len = size;
+			memset( &msgs[count], 0, sizeof( msgs[count] ) );
+			msgs[count].msg_hdr.msg_iov = &iovecs[count];
+			msgs[count].msg_hdr.msg_iovlen = 1;
+			msgs[count].msg_hdr.msg_name = &mClientSin;
+			msgs[count].msg_hdr.msg_namelen = sizeof( mClientSin );
+			offset += size;
+		}
+		int ret = sendmmsg( mSocket, msgs, count, 0 );
+		if ( ret < (int)count ) {
+			// Partially sent, report what actually left
+			uint32_t sent = offset;
+			for ( uint32_t i = std::max( ret, 0 ); i < count; i++ ) {
+				sent -= iovecs[i].iov_len;
+			}
+			return ( sent > 0 ) ? (int)sent : ret;
+		}
+	}
+
+	return len;
+}
+
+
 int Socket::Write( const void* buf, uint32_t len, bool ack, int timeout )
 {
 	if ( !mConnected ) {
@@ -315,10 +427,62 @@ int Socket::Write( const void* buf, uint32_t len, bool ack, int timeout )
 			mClientSin.sin_port = htons( mPort );
 			mClientSin.sin_addr.s_addr = inet_addr( "192.168.32.255" );
 		}
-		uint32_t sendsize = sizeof( mClientSin );
-		ret = sendto( mSocket, buf, len, 0, (SOCKADDR *)&mClientSin, sendsize );
+		if ( mMaxDatagram > 0 and len > mMaxDatagram ) {
+			ret = WriteFragmented( buf, len );
+		} else {
+			uint32_t sendsize = sizeof( mClientSin );
+			ret = sendto( mSocket, buf, len, 0, (SOCKADDR *)&mClientSin, sendsize );
+		}
+	} else {
+		ret = send( mClientSocket, buf, len, MSG_NOSIGNAL );
+	}
+
+	if ( ret <= 0 and ( errno == EAGAIN or errno == -EAGAIN ) ) {
+		return 0;
+	}
+
+	if ( ret < 0 and mPortType != UDP and mPortType != UDPLite ) {
+		gDebug() << "TCP disconnected\n";
+		mConnected = false;
+		return -1;
+	}
+	return ret;
+}
+
+
+int Socket::Writev( const struct iovec* iov, int iovcnt, bool ack, int32_t timeout )
+{
+	if ( !mConnected ) {
+		return -1;
+	}
+
+	uint32_t len = 0;
+	for ( int i = 0; i < iovcnt; i++ ) {
+		len += iov[i].iov_len;
+	}
+
+	struct msghdr msg;
+	memset( &msg, 0, sizeof( msg ) );
+	msg.msg_iov = const_cast< struct iovec* >( iov );
+	msg.msg_iovlen = iovcnt;
+
+	int ret = 0;
+
+	if ( mPortType == UDP or mPortType == UDPLite ) {
+		if ( mMaxDatagram > 0 and len > mMaxDatagram ) {
+			// Datagram boundaries do not match the parts, let Write() split the gathered message
+			return Link::Writev( iov, iovcnt, ack, timeout );
+		}
+		if ( mBroadcast ) {
+			mClientSin.sin_family = AF_INET;
+			mClientSin.sin_port = htons( mPort );
+			mClientSin.sin_addr.s_addr = inet_addr( "192.168.32.255" );
+		}
+		msg.msg_name = &mClientSin;
+		msg.msg_namelen = sizeof( mClientSin );
+		ret = sendmsg( mSocket, &msg, 0 );
 	} else {
-		ret = send( mClientSocket, buf, len, 0 );
+		ret = sendmsg( mClientSocket, &msg, MSG_NOSIGNAL );
 	}
 
 	if ( ret <= 0 and ( errno == EAGAIN or errno == -EAGAIN ) ) {
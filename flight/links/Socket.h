@@ -21,9 +21,14 @@
 
 #if ( BUILD_SOCKET == 1 )
 
+#include <sys/socket.h>
 #include <netinet/in.h>
 #include "Link.h"
 
+// Number of datagrams fetched at once by recvmmsg
+#define SOCKET_BATCH_SIZE 8
+#define SOCKET_DATAGRAM_SIZE 65536
+
 class Main;
 
 class Socket : public Link
@@ -35,7 +40,7 @@ public:
 		UDPLite
 	} PortType;
 
-	Socket( uint16_t port, PortType type = TCP, bool broadcast = false, uint32_t timeout = 0 );
+	Socket( uint16_t port, PortType type = TCP, bool broadcast = false, uint32_t timeout = 0, uint16_t udplite_coverage = 8, uint32_t max_datagram = 0 );
 	virtual ~Socket();
 
 	int Connect();
@@ -45,23 +50,42 @@ public:
 	int32_t Channel();
 	int32_t RxQuality();
 	int32_t RxLevel();
+	int fd();
 
 	int Read( void* buf, uint32_t len, int32_t timeout );
 	int Write( const void* buf, uint32_t len, bool ack = false, int32_t timeout = -1 );
+	int Writev( const struct iovec* iov, int iovcnt, bool ack = false, int32_t timeout = -1 );
 
 	static int flight_register( Main* main );
 
 protected:
 	static Link* Instanciate( Config* config, const std::string& lua_object );
+	int WaitReadable( int fd, int32_t timeout );
+	int WriteFragmented( const void* buf, uint32_t len );
+
+	typedef struct {
+		uint8_t data[SOCKET_DATAGRAM_SIZE];
+		struct sockaddr_in addr;
+	} Datagram;
 
 	uint16_t mPort;
 	PortType mPortType;
 	bool mBroadcast;
 	uint32_t mTimeout;
+	bool mBlocking;
 	int mSocket;
 	struct sockaddr_in mSin;
 	int mClientSocket;
 	struct sockaddr_in mClientSin;
+	uint16_t mUDPLiteCoverage;
+	uint32_t mMaxDatagram;
+
+	// Datagrams received by the last recvmmsg, consumed one by one by Read()
+	Datagram* mRxQueue;
+	struct mmsghdr mRxMsgs[SOCKET_BATCH_SIZE];
+	struct iovec mRxIovecs[SOCKET_BATCH_SIZE];
+	uint32_t mRxCount;
+	uint32_t mRxIndex;
 
 	// Stats
 	int32_t mChannel;
@@ -17,6 +17,8 @@
 **/
 
 #include <unistd.h>
+#include <algorithm>
+#include <GPIO.h>
 #include "ADS1015.h"
 
 int ADS1015::flight_register( Main* main )
@@ -32,22 +34,53 @@ int ADS1015::flight_register( Main* main )
 
 Sensor* ADS1015::Instanciate( Config* config, const std::string& object )
 {
-	return new ADS1015();
+	// Detected on I2C bus, so no config object is given
+	if ( not config and Main::instance() ) {
+		config = Main::instance()->config();
+	}
+	int ready_pin = config ? config->integer( "ADS1015.ready_pin", -1 ) : -1;
+	int rate = config ? config->integer( "ADS1015.rate", 100 ) : 100;
+	return new ADS1015( ready_pin, std::max( 1, rate ) );
 }
 
 
-ADS1015::ADS1015()
+ADS1015::ADS1015( int ready_pin, uint32_t rate )
 	: mI2C( new I2C( 0x48 ) )
-	, mRingBuffer{ 0.0f }
-	, mRingSum( 0.0f )
-	, mRingIndex( 0 )
+	, mScanThread( nullptr )
+	, mReadyPin( ready_pin )
+	, mConversionTime( 1000000 / 3300 + 20 )
+	, mScanPeriod( 1000000 / rate )
+	, mScanTicks( 0 )
+	, mChannelsMask( 0 )
+	, mChannel( -1 )
+	, mStopping( false )
+	, mValues{ 0.0f }
+	, mTimestamps{ 0 }
+	, mReady( false )
 {
 	mNames = { "ADS1015" };
+
+	if ( mReadyPin >= 0 ) {
+		// ALERT/RDY pin pulses at the end of each conversion when Hi_thresh MSB is 1 and Lo_thresh MSB is 0
+		mI2C->Write16( ADS1015_REG_POINTER_HITHRESH, 0x0080 );
+		mI2C->Write16( ADS1015_REG_POINTER_LOWTHRESH, 0x0000 );
+		GPIO::setMode( mReadyPin, GPIO::Input );
+		GPIO::SetupInterrupt( mReadyPin, GPIO::Falling, [this](){ ReadyInterrupt(); } );
+	}
+
+	mScanThread = new HookThread< ADS1015 >( "ADS1015", this, &ADS1015::ScanRun );
+	mScanThread->Start();
+	mScanThread->setPriority( 1 );
 }
 
 
 ADS1015::~ADS1015()
 {
+	if ( mScanThread ) {
+		mStopping = true;
+		mScanThread->Join();
+		delete mScanThread;
+	}
 	delete mI2C;
 }
 
@@ -60,29 +93,126 @@ void ADS1015::Calibrate( float dt, bool last_pass )
 
 float ADS1015::Read( int channel )
 {
-	uint16_t _ret = 0;
-	uint32_t ret = 0;
-	uint16_t config = ADS1015_REG_CONFIG_CQUE_NONE    | // Disable the comparator (default val)
-					  ADS1015_REG_CONFIG_CLAT_NONLAT  | // Non-latching (default val)
+	if ( channel < 0 or channel > 3 ) {
+		return 0.0f;
+	}
+
+	uint32_t mask = mChannelsMask.fetch_or( 1 << channel );
+
+	std::unique_lock< std::mutex > lock( mValuesMutex );
+	if ( ( mask & ( 1 << channel ) ) == 0 and mTimestamps[channel] == 0 ) {
+		// First read of this channel, wait for its first conversion instead of returning 0
+		mValuesCond.wait_for( lock, std::chrono::milliseconds( 100 ), [this, channel](){ return mTimestamps[channel] != 0; } );
+	}
+	return mValues[channel];
+}
+
+
+uint64_t ADS1015::timestamp( int channel )
+{
+	if ( channel < 0 or channel > 3 ) {
+		return 0;
+	}
+
+	mValuesMutex.lock();
+	uint64_t ret = mTimestamps[channel];
+	mValuesMutex.unlock();
+	return ret;
+}
+
+
+void ADS1015::StartConversion( int channel )
+{
+	uint16_t config = ADS1015_REG_CONFIG_CLAT_NONLAT  | // Non-latching (default val)
 					  ADS1015_REG_CONFIG_CPOL_ACTVLOW | // Alert/Rdy active low   (default val)
 					  ADS1015_REG_CONFIG_CMODE_TRAD   | // Traditional comparator (default val)
-					  ADS1015_REG_CONFIG_DR_1600SPS   | // 1600 samples per second (default)
-					  ADS1015_REG_CONFIG_MODE_SINGLE;   // Single-shot mode (default)
-
+					  ADS1015_REG_CONFIG_DR_3300SPS   | // 3300 samples per second
+					  ADS1015_REG_CONFIG_MODE_CONTIN;   // Continuous conversion mode
+
+	if ( mReadyPin >= 0 ) {
+		config |= ADS1015_REG_CONFIG_CQUE_1CONV; // Conversion ready signal on ALERT/RDY pin
+	} else {
+		config |= ADS1015_REG_CONFIG_CQUE_NONE; // Disable the comparator (default val)
+	}
 	config |= ADS1015_REG_CONFIG_PGA_6_144V;
 	config |= ( ADS1015_REG_CONFIG_MUX_SINGLE_0 + ( channel << 12 ) );
-	config |= ADS1015_REG_CONFIG_OS_SINGLE;
 	config = ( ( config << 8 ) & 0xFF00 ) | ( ( config >> 8 ) & 0xFF );
 
 	mI2C->Write16( ADS1015_REG_POINTER_CONFIG, config );
-	usleep( 1000 );
-	mI2C->Read16( ADS1015_REG_POINTER_CONVERT, &_ret );
+}
 
-	ret = _ret;
+
+void ADS1015::ReadyInterrupt()
+{
+	std::lock_guard< std::mutex > lock( mReadyMutex );
+	mReady = true;
+	mReadyCond.notify_one();
+}
+
+
+void ADS1015::WaitReady()
+{
+	if ( mReadyPin < 0 ) {
+		usleep( mConversionTime );
+		return;
+	}
+
+	// Timeout in case an edge was missed
+	std::unique_lock< std::mutex > lock( mReadyMutex );
+	mReadyCond.wait_for( lock, std::chrono::microseconds( mConversionTime * 2 ), [this](){ return mReady; } );
+	mReady = false;
+}
+
+
+bool ADS1015::ScanRun()
+{
+	if ( mStopping ) {
+		return false;
+	}
+
+	uint32_t mask = mChannelsMask;
+	if ( mask == 0 ) {
+		// Nothing requested yet
+		usleep( 1000 * 10 );
+		return true;
+	}
+
+	// Round-robin over requested channels
+	int channel = mChannel;
+	do {
+		channel = ( channel + 1 ) % 4;
+	} while ( ( mask & ( 1 << channel ) ) == 0 );
+
+	if ( channel != mChannel ) {
+		StartConversion( channel );
+		mChannel = channel;
+		// New configuration only applies after the ongoing conversion, drop its result
+		WaitReady();
+	}
+	WaitReady();
+
+	uint16_t _ret = 0;
+	if ( mI2C->Read16( ADS1015_REG_POINTER_CONVERT, &_ret ) < 0 ) {
+		return true;
+	}
+	uint32_t ret = _ret;
 	ret = ( ( ret << 8 ) & 0xFF00 ) | ( ( ret >> 8 ) & 0xFF );
-	float fret = (float)( ret * 6.144f / 32768.0f );
 
-	return fret;
+	mValuesMutex.lock();
+	mValues[channel] = (float)( (int16_t)ret ) * 6.144f / 32768.0f;
+	mTimestamps[channel] = Board::GetTicks();
+	mValuesMutex.unlock();
+	mValuesCond.notify_all();
+
+	// Every channel only needs to be refreshed at the consumers rate, leave the I2C bus to the other sensors meanwhile
+	uint64_t period = mScanPeriod / __builtin_popcount( mask );
+	uint64_t ticks = Board::GetTicks();
+	if ( ticks - mScanTicks < period ) {
+		usleep( period - ( ticks - mScanTicks ) );
+	}
+	mScanTicks = Board::GetTicks();
+
+	return true;
 }
 
 
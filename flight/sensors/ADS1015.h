@@ -19,29 +19,52 @@
 #ifndef ADS1015_H
 #define ADS1015_H
 
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <I2C.h>
+#include <Thread.h>
 #include "Voltmeter.h"
 #include "CurrentSensor.h"
 
 class ADS1015 : public Voltmeter
 {
 public:
-	ADS1015();
+	ADS1015( int ready_pin = -1, uint32_t rate = 100 );
 	~ADS1015();
 
 	static int flight_register( Main* main );
 	static Sensor* Instanciate( Config* config, const std::string& object );
 
 	void Calibrate( float dt, bool last_pass = false );
+	// Returns the last conversion result of given channel, only waits for the first conversion of a channel
 	float Read( int channel );
+	uint64_t timestamp( int channel );
 
 	std::string infos();
 
 private:
+	bool ScanRun();
+	void StartConversion( int channel );
+	void WaitReady();
+	void ReadyInterrupt();
+
 	I2C* mI2C;
-	float mRingBuffer[16];
-	float mRingSum;
-	int mRingIndex;
+	HookThread< ADS1015 >* mScanThread;
+	int mReadyPin;
+	uint32_t mConversionTime; // µs
+	uint32_t mScanPeriod; // µs between two conversions of a same channel
+	uint64_t mScanTicks;
+	std::atomic< uint32_t > mChannelsMask; // Channels which have already been read, only these ones are scanned
+	int mChannel;
+	bool mStopping;
+	std::mutex mValuesMutex;
+	float mValues[4];
+	uint64_t mTimestamps[4];
+	std::condition_variable mValuesCond;
+	std::mutex mReadyMutex;
+	std::condition_variable mReadyCond;
+	bool mReady;
 };
 
 
@@ -34,3 +34,11 @@ const bool* Accelerometer::axes() const
 {
 	return mAxes;
 }
+
+
+void Accelerometer::ReadSample( Sample* sample )
+{
+	uint32_t sequence = mSampleSequence;
+	Read( &sample->value );
+	FillSample( sample, sequence );
+}
@@ -28,12 +28,15 @@
 class Accelerometer : public Sensor
 {
 public:
+	typedef SensorSample< Vector3f > Sample;
+
 	Accelerometer();
 	~Accelerometer();
 
 	const bool* axes() const;
 
 	virtual void Read( Vector3f* v, bool raw = false ) = 0;
+	virtual void ReadSample( Sample* sample );
 
 protected:
 	bool mAxes[3];
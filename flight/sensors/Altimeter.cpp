@@ -26,3 +26,11 @@ Altimeter::Altimeter()
 Altimeter::~Altimeter()
 {
 }
+
+
+void Altimeter::ReadSample( Sample* sample )
+{
+	uint32_t sequence = mSampleSequence;
+	Read( &sample->value );
+	FillSample( sample, sequence );
+}
@@ -24,6 +24,7 @@
 class Altimeter : public Sensor
 {
 public:
+	typedef SensorSample< float > Sample;
 	typedef enum {
 		Absolute,
 		Proximity
@@ -34,6 +35,7 @@ public:
 
 	virtual Type type() const { return Absolute; }
 	virtual void Read( float* altitude ) = 0;
+	virtual void ReadSample( Sample* sample );
 };
 
 #endif // ALTIMETER_H
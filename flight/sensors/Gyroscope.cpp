@@ -16,6 +16,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
+#include <cmath>
+#include <Board.h>
 #include "Gyroscope.h"
 
 Gyroscope::Gyroscope()
@@ -34,3 +36,89 @@ const bool* Gyroscope::axes() const
 {
 	return mAxes;
 }
+
+
+void Gyroscope::ReadSample( Sample* sample )
+{
+	uint32_t sequence = mSampleSequence;
+	Read( &sample->value );
+	FillSample( sample, sequence );
+}
+
+
+float Gyroscope::temperature()
+{
+	return (float)Board::CPUTemp();
+}
+
+
+Vector3f Gyroscope::offset() const
+{
+	return Vector3f();
+}
+
+
+void Gyroscope::setOffset( const Vector3f& offset )
+{
+}
+
+
+std::string Gyroscope::cacheRegister( int32_t bucket, const std::string& axis )
+{
+	std::string name = ( mNames.size() > 0 ) ? mNames.front() : "Unknown";
+	return name + ":Gyroscope:Bias:" + std::to_string( bucket ) + ":" + axis;
+}
+
+
+bool Gyroscope::LoadCachedBucket( int32_t bucket, Vector3f* offset )
+{
+	// Missing registers are reported as NaN
+	offset->x = Board::LoadRegisterFloat( cacheRegister( bucket, "X" ), NAN );
+	offset->y = Board::LoadRegisterFloat( cacheRegister( bucket, "Y" ), NAN );
+	offset->z = Board::LoadRegisterFloat( cacheRegister( bucket, "Z" ), NAN );
+	return not std::isnan( offset->x ) and not std::isnan( offset->y ) and not std::isnan( offset->z );
+}
+
+
+bool Gyroscope::LoadCachedOffset( float temperature )
+{
+	if ( not hasOffset() ) {
+		return false;
+	}
+
+	// Interpolate between the two buckets surrounding current temperature, or use the only one available
+	int32_t low = (int32_t)std::floor( temperature / GYROSCOPE_BIAS_TEMP_STEP ) * GYROSCOPE_BIAS_TEMP_STEP;
+	int32_t high = low + GYROSCOPE_BIAS_TEMP_STEP;
+	Vector3f low_offset;
+	Vector3f high_offset;
+	bool has_low = LoadCachedBucket( low, &low_offset );
+	bool has_high = LoadCachedBucket( high, &high_offset );
+
+	if ( has_low and has_high ) {
+		float t = ( temperature - (float)low ) / (float)GYROSCOPE_BIAS_TEMP_STEP;
+		setOffset( low_offset + ( high_offset - low_offset ) * t );
+	} else if ( has_low ) {
+		setOffset( low_offset );
+	} else if ( has_high ) {
+		setOffset( high_offset );
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+void Gyroscope::SaveCachedOffset( float temperature, std::map< std::string, std::string >* registers )
+{
+	if ( not hasOffset() ) {
+		return;
+	}
+
+	int32_t bucket = (int32_t)std::round( temperature / GYROSCOPE_BIAS_TEMP_STEP ) * GYROSCOPE_BIAS_TEMP_STEP;
+	Vector3f off = offset();
+
+	(*registers)[ cacheRegister( bucket, "X" ) ] = std::to_string( off.x );
+	(*registers)[ cacheRegister( bucket, "Y" ) ] = std::to_string( off.y );
+	(*registers)[ cacheRegister( bucket, "Z" ) ] = std::to_string( off.z );
+}
@@ -20,22 +20,44 @@
 #define GYROSCOPE_H
 
 #include <list>
+#include <map>
 #include <functional>
 #include <string>
 #include <Main.h>
 #include "Sensor.h"
 
+// Width of temperature buckets of the persisted bias table, in °C
+#define GYROSCOPE_BIAS_TEMP_STEP 5
+
 class Gyroscope : public Sensor
 {
 public:
+	typedef SensorSample< Vector3f > Sample;
+
 	Gyroscope();
 	~Gyroscope();
 
 	const bool* axes() const;
 
 	virtual void Read( Vector3f* v, bool raw = false ) = 0;
+	virtual void ReadSample( Sample* sample );
+
+	// Die temperature used to index calibration cache, defaults to CPU temperature
+	virtual float temperature();
+	// Only gyroscopes exposing their calibration offset can use the bias table
+	virtual bool hasOffset() const { return false; }
+	virtual Vector3f offset() const;
+	virtual void setOffset( const Vector3f& offset );
+
+	// Temperature-indexed bias table stored in Board registers, current offset is added to 'registers' to be saved with Board::SaveRegisters()
+	bool LoadCachedOffset( float temperature );
+	void SaveCachedOffset( float temperature, std::map< std::string, std::string >* registers );
 
 protected:
+	bool LoadCachedBucket( int32_t bucket, Vector3f* offset );
+	std::string cacheRegister( int32_t bucket, const std::string& axis );
+
+
 	bool mAxes[3];
 };
 
@@ -64,6 +64,12 @@ L3GD20H::~L3GD20H()
 
 void L3GD20H::Calibrate( float dt, bool last_pass )
 {
+	if ( mCalibrated ) {
+		mCalibrated = false;
+		mCalibrationAccum = Vector4f();
+		mOffset = Vector3f();
+	}
+
 	Vector3f gyro;
 	Read( &gyro, true );
 	mCalibrationAccum += Vector4f( gyro, 1.0f );
@@ -91,3 +97,27 @@ void L3GD20H::Read( Vector3f* v, bool raw )
 
 	mLastValues = *v;
 }
+
+
+float L3GD20H::temperature()
+{
+	uint8_t temp = 0;
+
+	// Uncalibrated die temperature (-1 LSB/°C), only consistent across readings of the same chip
+	mI2C->Read8( L3GD20_OUT_TEMP, &temp );
+	return 25.0f - (float)( (int8_t)temp );
+}
+
+
+Vector3f L3GD20H::offset() const
+{
+	return mOffset;
+}
+
+
+void L3GD20H::setOffset( const Vector3f& offset )
+{
+	mCalibrationAccum = Vector4f();
+	mOffset = offset;
+	mCalibrated = true;
+}
@@ -31,6 +31,10 @@ public:
 	static Gyroscope* Instanciate( Config* config, const std::string& object );
 	void Calibrate( float dt, bool last_pass = false );
 	void Read( Vector3f* v, bool raw = false );
+	float temperature();
+	bool hasOffset() const { return true; }
+	Vector3f offset() const;
+	void setOffset( const Vector3f& offset );
 
 	static int flight_register( Main* main );
 
@@ -108,10 +108,16 @@ MPU9150Mag::MPU9150Mag( int addr )
 	: Magnetometer()
 	, mI2C9150( new I2C( addr ) )
 	, mI2C( new I2C( 0x0C ) )
-	, mState( 0 )
+	, mReadoutThread( nullptr )
+	, mState( Trigger )
+	, mTriggerTicks( 0 )
 	, mData{ 0 }
+	, mPublished( Vector3f() )
+	, mPublishedTimestamp( 0 )
+	, mPublishedSequence( 0 )
 {
 	mNames = { "MPU9150" };
+	mSelfStamped = true;
 
 	uint8_t id = 0;
 	int ret = mI2C->Read8( MPU_9150_WIA, &id );
@@ -119,9 +125,10 @@ MPU9150Mag::MPU9150Mag( int addr )
 		return;
 	}
 
-	// Single measurement mode: 0b00000001
-	mI2C->Write8( MPU_9150_CNTL, 0b00000001 );
-	usleep( 100 * 1000 );
+	// AK8975 readout is done in background, the stabilizer thread only fetches last published measurement
+	mReadoutThread = new HookThread< MPU9150Mag >( "mpu9150_mag", this, &MPU9150Mag::ReadoutRun );
+	mReadoutThread->Start();
+	mReadoutThread->setPriority( 50 );
 }
 
 
@@ -137,6 +144,11 @@ MPU9150Gyro::~MPU9150Gyro()
 
 MPU9150Mag::~MPU9150Mag()
 {
+	if ( mReadoutThread ) {
+		mReadoutThread->Stop();
+		mReadoutThread->Join();
+		delete mReadoutThread;
+	}
 }
 
 
@@ -233,67 +245,94 @@ void MPU9150Gyro::Read( Vector3f* v, bool raw )
 }
 
 
-void MPU9150Mag::Read( Vector3f* v, bool raw )
+float MPU9150Gyro::temperature()
+{
+	uint8_t stemp[2] = { 0 };
+
+	mI2C->Read( MPU_9150_TEMP_OUT_H | 0x80, stemp, sizeof(stemp) );
+	return (float)( (int16_t)( stemp[0] << 8 | stemp[1] ) ) / 340.0f + 35.0f;
+}
+
+
+Vector3f MPU9150Gyro::offset() const
+{
+	return mOffset;
+}
+
+
+void MPU9150Gyro::setOffset( const Vector3f& offset )
+{
+	mCalibrationAccum = Vector4f();
+	mOffset = offset;
+	mCalibrated = true;
+}
+
+
+bool MPU9150Mag::ReadoutRun()
 {
 	switch( mState ) {
-		case 0 : {
-			// Check if data is ready.
+		case Trigger : {
+			// Single measurement mode: 0b00000001
+			mI2C->Write8( MPU_9150_CNTL, 0b00000001 );
+			mTriggerTicks = Board::GetTicks();
+			mState = WaitReady;
+			// A measurement takes at most 9ms
+			usleep( 7000 );
+			break;
+		}
+
+		case WaitReady : {
 			uint8_t status = 0;
 			mI2C->Read8( MPU_9150_ST1, &status );
 			if ( status & 0x01 ) {
-				mState = 1;
+				mState = Fetch;
+			} else if ( Board::GetTicks() - mTriggerTicks > 20 * 1000 ) {
+				// Measurement lost, trigger again
+				mState = Trigger;
+			} else {
+				usleep( 500 );
 			}
-			// Duplicate last measurements
-			*v = mLastValues;
 			break;
 		}
-		
-		case 1 : {
-			// Read X axis
-			for ( int i = 0; i < 2; i++ ) {
-				mI2C->Read8( MPU_9150_HXL + i, &mData[i] );
-			}
-			mState = 2;
 
-			// Duplicate last measurements
-			*v = mLastValues;
-			break;
-		}
-		
-		case 2 : {
-			// Read Y axis
-			for ( int i = 2; i < 4; i++ ) {
-				mI2C->Read8( MPU_9150_HXL + i, &mData[i] );
+		case Fetch : {
+			// Burst read HXL to HZH, followed by ST2 which also releases data protection
+			if ( mI2C->Read( MPU_9150_HXL, mData, 7 ) == 7 and ( mData[6] & 0b00001100 ) == 0 ) {
+				Vector3f v;
+				v.x = (float)( (int16_t)( mData[1] << 8 | mData[0] ) ) * 0.3001221001221001f;
+				v.y = (float)( (int16_t)( mData[3] << 8 | mData[2] ) ) * 0.3001221001221001f;
+				v.z = -(float)( (int16_t)( mData[5] << 8 | mData[4] ) ) * 0.3001221001221001f;
+
+				mPublishMutex.lock();
+				mPublished = v;
+				mPublishedTimestamp = Board::GetTicks();
+				mPublishedSequence++;
+				mPublishMutex.unlock();
 			}
-			mState = 3;
-
-			// Duplicate last measurements
-			*v = mLastValues;
+			mState = Trigger;
 			break;
 		}
-		
-		case 3 : {
-			// Read Z axis
-			for ( int i = 4; i < 6; i++ ) {
-				mI2C->Read8( MPU_9150_HXL + i, &mData[i] );
-			}
-
-			v->x = (float)( (int16_t)( mData[1] << 8 | mData[0] ) ) * 0.3001221001221001f;
-			v->y = (float)( (int16_t)( mData[3] << 8 | mData[2] ) ) * 0.3001221001221001f;
-			v->z = -(float)( (int16_t)( mData[5] << 8 | mData[4] ) ) * 0.3001221001221001f;
 
-			mLastValues = *v;
-			
-			// Re-arm single measurement mode
-			mI2C->Write8( MPU_9150_CNTL, 0b00000001 );
-			mState = 0;
-			break;
-		}
-		
 		default : {
-			mState = 0;
+			mState = Trigger;
 		}
 	}
+
+	return true;
+}
+
+
+void MPU9150Mag::Read( Vector3f* v, bool raw )
+{
+	mPublishMutex.lock();
+	if ( mPublishedSequence != mSampleSequence ) {
+		mLastValues = mPublished;
+		mSampleTimestamp = mPublishedTimestamp;
+		mSampleSequence = mPublishedSequence;
+	}
+	mPublishMutex.unlock();
+
+	*v = mLastValues.xyz();
 }
 
 
@@ -22,7 +22,9 @@
 #include <Accelerometer.h>
 #include <Gyroscope.h>
 #include <Magnetometer.h>
+#include <mutex>
 #include <I2C.h>
+#include <Thread.h>
 #include <Quaternion.h>
 
 
@@ -52,6 +54,10 @@ public:
 
 	void Calibrate( float dt, bool last_pass = false );
 	void Read( Vector3f* v, bool raw = false );
+	float temperature();
+	bool hasOffset() const { return true; }
+	Vector3f offset() const;
+	void setOffset( const Vector3f& offset );
 
 	std::string infos();
 
@@ -74,10 +80,25 @@ public:
 	std::string infos();
 
 private:
+	typedef enum {
+		Trigger,
+		WaitReady,
+		Fetch,
+	} State;
+
+	bool ReadoutRun();
+
 	I2C* mI2C9150;
 	I2C* mI2C;
-	int mState;
-	uint8_t mData[6];
+	HookThread< MPU9150Mag >* mReadoutThread;
+	State mState;
+	uint64_t mTriggerTicks;
+	uint8_t mData[7];
+	// Last measurement, published by the readout thread
+	std::mutex mPublishMutex;
+	Vector3f mPublished;
+	uint64_t mPublishedTimestamp;
+	uint32_t mPublishedSequence;
 };
 
 
@@ -127,6 +148,8 @@ public:
 #define MPU_9150_ACCEL_YOUT_L           0x3E    // Accel Y axis Low
 #define MPU_9150_ACCEL_ZOUT_H           0x3F    // Accel Z axis High
 #define MPU_9150_ACCEL_ZOUT_L           0x40    // Accel Z axis Low
+#define MPU_9150_TEMP_OUT_H             0x41    // Temperature High
+#define MPU_9150_TEMP_OUT_L             0x42    // Temperature Low
 #define MPU_9150_GYRO_XOUT_H            0x43    // Gyro X axis High
 #define MPU_9150_GYRO_XOUT_L            0x44    // Gyro X axis Low
 #define MPU_9150_GYRO_YOUT_H            0x45    // Gyro Y axis High
@@ -34,3 +34,11 @@ const bool* Magnetometer::axes() const
 {
 	return mAxes;
 }
+
+
+void Magnetometer::ReadSample( Sample* sample )
+{
+	uint32_t sequence = mSampleSequence;
+	Read( &sample->value );
+	FillSample( sample, sequence );
+}
@@ -28,12 +28,15 @@
 class Magnetometer : public Sensor
 {
 public:
+	typedef SensorSample< Vector3f > Sample;
+
 	Magnetometer();
 	~Magnetometer();
 
 	const bool* axes() const;
 
 	virtual void Read( Vector3f* v, bool raw = false ) = 0;
+	virtual void ReadSample( Sample* sample );
 
 protected:
 	bool mAxes[3];
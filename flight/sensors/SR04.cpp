@@ -17,6 +17,13 @@
 **/
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include <algorithm>
 #include <Debug.h>
 #include <GPIO.h>
 #include "SR04.h"
@@ -45,20 +52,61 @@ SR04::SR04( uint32_t gpio_trigger, uint32_t gpio_echo )
 	: Altimeter()
 	, mTriggerPin( gpio_trigger )
 	, mEchoPin( gpio_echo )
-	, mRiseTick( 0 )
+	, mEventFD( -1 )
+	, mRangingThread( nullptr )
+	, mCycleTick( 0 )
+	, mMedian{ 0.0f }
+	, mMedianIndex( 0 )
+	, mMedianCount( 0 )
+	, mRejected( 0 )
+	, mMissed( 0 )
 	, mAltitude( 0.0f )
+	, mAltitudeTimestamp( 0 )
+	, mAltitudeSequence( 0 )
 {
 	mNames.emplace_back( "SR04" );
 	mNames.emplace_back( "sr04" );
+	mSelfStamped = true;
 
 	GPIO::setMode( mTriggerPin, GPIO::Output );
-	GPIO::setMode( mEchoPin, GPIO::Input );
-	GPIO::SetupInterrupt( mEchoPin, GPIO::Both, [this](){ this->Interrupt(); } );
+	GPIO::Write( mTriggerPin, false );
+
+	// Echo edges are timestamped by the kernel, through the GPIO character device
+	int chip = open( "/dev/gpiochip0", O_RDONLY );
+	if ( chip < 0 ) {
+		gDebug() << "SR04 : cannot open /dev/gpiochip0 : " << strerror( errno ) << "\n";
+		return;
+	}
+	struct gpioevent_request req;
+	memset( &req, 0, sizeof(req) );
+	req.lineoffset = mEchoPin;
+	req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+	req.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
+	strncpy( req.consumer_label, "sr04", sizeof(req.consumer_label) - 1 );
+	if ( ioctl( chip, GPIO_GET_LINEEVENT_IOCTL, &req ) < 0 ) {
+		gDebug() << "SR04 : cannot request edge events on pin " << mEchoPin << " : " << strerror( errno ) << "\n";
+		close( chip );
+		return;
+	}
+	close( chip );
+	mEventFD = req.fd;
+
+	mRangingThread = new HookThread< SR04 >( "sr04", this, &SR04::RangingRun );
+	mRangingThread->Start();
+	mRangingThread->setPriority( 1 );
 }
 
 
 SR04::~SR04()
 {
+	if ( mRangingThread ) {
+		mRangingThread->Stop();
+		mRangingThread->Join();
+		delete mRangingThread;
+	}
+	if ( mEventFD >= 0 ) {
+		close( mEventFD );
+	}
 }
 
 
@@ -67,34 +115,101 @@ void SR04::Calibrate( float dt, bool last_pass )
 }
 
 
-void SR04::Interrupt()
+bool SR04::Measure( float* altitude )
 {
-	mISRLock.lock();
-	if ( mRiseTick == 0 ) {
-		mRiseTick = Board::GetTicks();
+	struct gpioevent_data event;
+	uint64_t rise = 0;
+
+	// Drop any pending edge
+	struct pollfd pfd;
+	pfd.fd = mEventFD;
+	pfd.events = POLLIN;
+	while ( poll( &pfd, 1, 0 ) > 0 and read( mEventFD, &event, sizeof(event) ) == sizeof(event) );
+
+	GPIO::Write( mTriggerPin, true );
+	usleep( 12 );
+	GPIO::Write( mTriggerPin, false );
+
+	// Echo pulse lasts at most ~25ms (400cm), give up after 40ms
+	uint64_t start = Board::GetTicks();
+	while ( Board::GetTicks() - start < 40000 ) {
+		int timeout = std::max( 1, (int)( 40 - ( Board::GetTicks() - start ) / 1000 ) );
+		if ( poll( &pfd, 1, timeout ) <= 0 ) {
+			break;
+		}
+		if ( read( mEventFD, &event, sizeof(event) ) != sizeof(event) ) {
+			break;
+		}
+		if ( event.id == GPIOEVENT_EVENT_RISING_EDGE ) {
+			rise = event.timestamp;
+		} else if ( event.id == GPIOEVENT_EVENT_FALLING_EDGE and rise != 0 ) {
+			float time = (float)( event.timestamp - rise ) / 1000.0f; // µs
+			float cm = time / 58.0f;
+			// HC-SR04 range is 2cm - 400cm
+			if ( cm < 2.0f or cm > 400.0f ) {
+				return false;
+			}
+			*altitude = ( cm - 1.0f ) / 100.0f;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool SR04::RangingRun()
+{
+	float altitude = 0.0f;
+
+	if ( Measure( &altitude ) ) {
+		mMissed = 0;
+		mMedian[mMedianIndex] = altitude;
+		mMedianIndex = ( mMedianIndex + 1 ) % SR04_MEDIAN_SIZE;
+		mMedianCount = std::min( mMedianCount + 1, (uint32_t)SR04_MEDIAN_SIZE );
+
+		float sorted[SR04_MEDIAN_SIZE];
+		memcpy( sorted, mMedian, sizeof(float) * mMedianCount );
+		std::nth_element( sorted, sorted + mMedianCount / 2, sorted + mMedianCount );
+
+		mPublishMutex.lock();
+		mAltitude = sorted[mMedianCount / 2];
+		mAltitudeTimestamp = Board::GetTicks();
+		mAltitudeSequence++;
+		mPublishMutex.unlock();
 	} else {
-		uint64_t time = Board::GetTicks() - mRiseTick;
-		mRiseTick = 0;
-		if ( time > 40000 ) {
+		mRejected++;
+		if ( ++mMissed == SR04_MAX_MISSED ) {
+			// Out of range or lost echoes, do not keep the last altitude published
+			mMedianCount = 0;
+			mMedianIndex = 0;
+			mPublishMutex.lock();
 			mAltitude = 0.0f;
-		} else {
-			mAltitude = ( (float)time / 58.0f - 1.0f ) / 100.0f;
+			mAltitudeTimestamp = Board::GetTicks();
+			mAltitudeSequence++;
+			mPublishMutex.unlock();
 		}
 	}
-	mISRLock.unlock();
+
+	// Sensor needs 60ms between two measurements, so echoes fade out
+	mCycleTick = Board::WaitTick( 60000, mCycleTick, 0 );
+	return true;
 }
 
 
 void SR04::Read( float* altitude )
 {
-	GPIO::Write( mTriggerPin, true );
-	usleep( 12 );
-	GPIO::Write( mTriggerPin, false );
+	mPublishMutex.lock();
+	if ( mAltitudeSequence != mSampleSequence ) {
+		mSampleTimestamp = mAltitudeTimestamp;
+		mSampleSequence = mAltitudeSequence;
+	}
 	*altitude = mAltitude;
+	mPublishMutex.unlock();
 }
 
 
 std::string SR04::infos()
 {
-	return "";
+	return "Range = \"0.02m - 4m\", Rejected = " + std::to_string( mRejected );
 }
@@ -19,8 +19,13 @@
 #ifndef SR04_H
 #define SR04_H
 
+#include <mutex>
+#include <Thread.h>
 #include "Altimeter.h"
 
+#define SR04_MEDIAN_SIZE 5
+#define SR04_MAX_MISSED 5 // Consecutive failed measurements after which nothing is considered in range
+
 class SR04 : public Altimeter
 {
 public:
@@ -37,13 +42,25 @@ public:
 	static int flight_register( Main* main );
 
 protected:
-	void Interrupt();
+	bool RangingRun();
+	bool Measure( float* altitude );
 
 	uint32_t mTriggerPin;
 	uint32_t mEchoPin;
-	uint64_t mRiseTick;
+	int mEventFD;
+	HookThread< SR04 >* mRangingThread;
+	uint64_t mCycleTick;
+	float mMedian[SR04_MEDIAN_SIZE];
+	uint32_t mMedianIndex;
+	uint32_t mMedianCount;
+	uint32_t mRejected;
+	uint32_t mMissed;
+
+	// Filtered altitude, published by the ranging thread
+	std::mutex mPublishMutex;
 	float mAltitude;
-	std::mutex mISRLock;
+	uint64_t mAltitudeTimestamp;
+	uint32_t mAltitudeSequence;
 };
 
 #endif // SR04_H
@@ -24,6 +24,7 @@
 #include "Altimeter.h"
 #include "Voltmeter.h"
 #include "CurrentSensor.h"
+#include "SensorRecorder.h"
 #include <Matrix.h>
 
 std::list< Sensor::Device > Sensor::mKnownDevices;
@@ -35,12 +36,16 @@ std::list< Altimeter* > Sensor::mAltimeters;
 std::list< GPS* > Sensor::mGPSes;
 std::list< Voltmeter* > Sensor::mVoltmeters;
 std::list< CurrentSensor* > Sensor::mCurrentSensors;
+SensorRecorder* Sensor::mRecorder = nullptr;
 
 Sensor::Sensor()
 	: mCalibrated( false )
 	, mSwapMode( SwapModeNone )
 	, mAxisSwap{ 0, 0, 0, 0 }
 	, mAxisMatrix( Matrix( 4, 4 ) )
+	, mSelfStamped( false )
+	, mSampleTimestamp( 0 )
+	, mSampleSequence( 0 )
 {
 }
 
@@ -68,6 +73,43 @@ Vector4f Sensor::lastValues() const
 }
 
 
+uint64_t Sensor::sampleTimestamp() const
+{
+	return mSampleTimestamp;
+}
+
+
+uint32_t Sensor::sampleSequence() const
+{
+	return mSampleSequence;
+}
+
+
+bool Sensor::selfStamped() const
+{
+	return mSelfStamped;
+}
+
+
+void Sensor::StampSample( uint64_t timestamp )
+{
+	mSampleTimestamp = ( timestamp != 0 ) ? timestamp : Board::GetTicks();
+	mSampleSequence++;
+}
+
+
+void Sensor::setRecorder( SensorRecorder* recorder )
+{
+	mRecorder = recorder;
+}
+
+
+void Sensor::RecordSample( uint64_t timestamp, uint32_t sequence, const float* values, uint8_t count )
+{
+	mRecorder->Record( this, timestamp, sequence, values, count );
+}
+
+
 void Sensor::setAxisSwap( const int swap[4] )
 {
 	memcpy( mAxisSwap, swap, sizeof(int)*4 );
@@ -33,6 +33,17 @@ class Altimeter;
 class GPS;
 class Voltmeter;
 class CurrentSensor;
+class SensorRecorder;
+class SensorReplay;
+
+template< typename T > class SensorSample
+{
+public:
+	SensorSample() : value( T() ), timestamp( 0 ), sequence( 0 ) {}
+	T value;
+	uint64_t timestamp; // Board::GetTicks() time base (µs)
+	uint32_t sequence; // Incremented for each new sample produced by the sensor
+};
 
 class Sensor
 {
@@ -51,6 +62,9 @@ public:
 	const std::list< std::string >& names() const;
 	const bool calibrated() const;
 	Vector4f lastValues() const;
+	uint64_t sampleTimestamp() const;
+	uint32_t sampleSequence() const;
+	bool selfStamped() const;
 
 	void setAxisSwap( const int swap[4] );
 	void setAxisMatrix( const Matrix& matrix );
@@ -78,6 +92,7 @@ public:
 
 	virtual std::string infos() { return ""; }
 	static std::string infosAll();
+	static void setRecorder( SensorRecorder* recorder );
 
 protected:
 	typedef enum {
@@ -92,9 +107,27 @@ protected:
 	int mSwapMode;
 	int mAxisSwap[4];
 	Matrix mAxisMatrix;
+	bool mSelfStamped; // Set by drivers which call StampSample() themselves when new data is available
+	uint64_t mSampleTimestamp;
+	uint32_t mSampleSequence;
 
 	void ApplySwap( Vector3f& v );
 	void ApplySwap( Vector4f& v );
+	void StampSample( uint64_t timestamp = 0 );
+	template< typename T > void FillSample( SensorSample< T >* sample, uint32_t previous_sequence ) {
+		if ( not mSelfStamped and mSampleSequence == previous_sequence ) {
+			// Driver does not know if data is fresh, consider every read as a new sample
+			StampSample();
+		}
+		sample->timestamp = mSampleTimestamp;
+		sample->sequence = mSampleSequence;
+		if ( mRecorder and mSampleSequence != previous_sequence ) {
+			RecordSample( sample->timestamp, sample->sequence, (const float*)&sample->value, SampleValuesCount( sample->value ) );
+		}
+	}
+	void RecordSample( uint64_t timestamp, uint32_t sequence, const float* values, uint8_t count );
+	static uint8_t SampleValuesCount( const float& v ) { return 1; }
+	static uint8_t SampleValuesCount( const Vector3f& v ) { return 3; }
 
 	static std::list< Device > mKnownDevices; // Contains all the known devices by this software
 	static std::list< Sensor* > mDevices; // Contains all the detected devices
@@ -105,8 +138,10 @@ protected:
 	static std::list< GPS* > mGPSes; // ^
 	static std::list< Voltmeter* > mVoltmeters; // ^
 	static std::list< CurrentSensor* > mCurrentSensors; // ^
+	static SensorRecorder* mRecorder;
 
 	static void UpdateDevices();
+	friend class SensorReplay; // registers the replayed devices
 };
 
 #endif // SENSOR_H
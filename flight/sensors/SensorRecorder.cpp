@@ -0,0 +1,184 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <Debug.h>
+#include <Board.h>
+#include "SensorRecorder.h"
+#include "Sensor.h"
+#include "Gyroscope.h"
+#include "Accelerometer.h"
+#include "Magnetometer.h"
+#include "Altimeter.h"
+
+// Samples are dropped above this amount of pending data, to never stall the stabilizer loop
+#define SENSOR_RECORDER_MAX_PENDING ( 1024 * 1024 )
+// A single Record() call appends at most a device declaration and a sample, each one with a payload of at most 255 bytes
+#define SENSOR_RECORDER_MAX_RECORD ( 2 * ( sizeof(RecordHeader) + 255 ) )
+
+SensorRecorder::SensorRecorder( const std::string& filename )
+	: Thread( "sensors_recorder" )
+	, mFile( nullptr )
+	, mDropped( 0 )
+{
+	mFile = fopen( filename.c_str(), "wb" );
+	if ( not mFile ) {
+		gDebug() << "SensorRecorder : cannot open \"" << filename << "\" : " << strerror( errno ) << "\n";
+		return;
+	}
+
+	FileHeader header;
+	header.magic = Magic;
+	header.version = Version;
+	header.reserved = 0;
+	header.start_ticks = Board::GetTicks();
+	fwrite( &header, sizeof(header), 1, mFile );
+
+	// Both buffers are allocated once, so that Record() never reallocates from the stabilizer thread
+	mBuffer.reserve( SENSOR_RECORDER_MAX_PENDING + SENSOR_RECORDER_MAX_RECORD );
+	mFlushBuffer.reserve( SENSOR_RECORDER_MAX_PENDING + SENSOR_RECORDER_MAX_RECORD );
+	gDebug() << "Recording raw sensors samples to \"" << filename << "\"\n";
+}
+
+
+SensorRecorder::~SensorRecorder()
+{
+	// Flush thread must be done with the file before the remaining samples are written
+	Stop();
+	Join();
+
+	if ( mFile ) {
+		fwrite( mBuffer.data(), 1, mBuffer.size(), mFile );
+		fclose( mFile );
+	}
+}
+
+
+uint32_t SensorRecorder::dropped() const
+{
+	return mDropped;
+}
+
+
+SensorRecorder::Kind SensorRecorder::SensorKind( Sensor* dev )
+{
+	if ( dynamic_cast< Gyroscope* >( dev ) != nullptr ) {
+		return KindGyroscope;
+	}
+	if ( dynamic_cast< Accelerometer* >( dev ) != nullptr ) {
+		return KindAccelerometer;
+	}
+	if ( dynamic_cast< Magnetometer* >( dev ) != nullptr ) {
+		return KindMagnetometer;
+	}
+	if ( dynamic_cast< Altimeter* >( dev ) != nullptr ) {
+		return ( static_cast< Altimeter* >( dev )->type() == Altimeter::Proximity ) ? KindAltimeterProximity : KindAltimeterAbsolute;
+	}
+	return KindUnknown;
+}
+
+
+void SensorRecorder::Record( Sensor* dev, uint64_t timestamp, uint32_t sequence, const float* values, uint8_t count )
+{
+	if ( not mFile ) {
+		return;
+	}
+
+	mMutex.lock();
+	int32_t id = DeviceID( dev );
+	if ( id < 0 or mBuffer.size() >= SENSOR_RECORDER_MAX_PENDING ) {
+		mDropped++;
+		mMutex.unlock();
+		return;
+	}
+
+	RecordHeader header;
+	header.type = RecordSample;
+	header.device = (uint8_t)id;
+	header.size = sizeof(SampleHeader) + sizeof(float) * count;
+	header.count = count;
+	SampleHeader sample;
+	sample.timestamp = timestamp;
+	sample.sequence = sequence;
+	Append( header, &sample, sizeof(sample), values, sizeof(float) * count );
+	mMutex.unlock();
+}
+
+
+int32_t SensorRecorder::DeviceID( Sensor* dev )
+{
+	auto it = mDevicesIDs.find( dev );
+	if ( it != mDevicesIDs.end() ) {
+		return it->second;
+	}
+	if ( mDevicesIDs.size() >= 255 ) {
+		return -1;
+	}
+
+	uint8_t id = mDevicesIDs.size();
+	mDevicesIDs.emplace( std::make_pair( dev, id ) );
+
+	// Declare device the first time it is seen
+	std::string name = dev->names().size() > 0 ? dev->names().front() : "";
+	name = name.substr( 0, 254 );
+	uint8_t kind = SensorKind( dev );
+	RecordHeader header;
+	header.type = RecordDeclare;
+	header.device = id;
+	header.size = 1 + name.length();
+	header.count = 0;
+	Append( header, &kind, 1, name.data(), name.length() );
+
+	return id;
+}
+
+
+void SensorRecorder::Append( const RecordHeader& header, const void* payload, uint32_t payload_size, const void* data, uint32_t data_size )
+{
+	const uint8_t* h = (const uint8_t*)&header;
+	mBuffer.insert( mBuffer.end(), h, h + sizeof(header) );
+	mBuffer.insert( mBuffer.end(), (const uint8_t*)payload, (const uint8_t*)payload + payload_size );
+	if ( data and data_size > 0 ) {
+		mBuffer.insert( mBuffer.end(), (const uint8_t*)data, (const uint8_t*)data + data_size );
+	}
+}
+
+
+bool SensorRecorder::run()
+{
+	if ( not mFile ) {
+		return false;
+	}
+
+	usleep( 1000 * 100 );
+
+	// Swap buffers, so the stabilizer thread is never blocked by file I/O
+	mMutex.lock();
+	mBuffer.swap( mFlushBuffer );
+	mMutex.unlock();
+
+	if ( mFlushBuffer.size() > 0 ) {
+		fwrite( mFlushBuffer.data(), 1, mFlushBuffer.size(), mFile );
+		fflush( mFile );
+		mFlushBuffer.clear();
+	}
+
+	return true;
+}
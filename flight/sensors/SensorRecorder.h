@@ -0,0 +1,100 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef SENSORRECORDER_H
+#define SENSORRECORDER_H
+
+#include <stdio.h>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <vector>
+#include <string>
+#include <Thread.h>
+
+class Sensor;
+
+/** File layout :
+ *   - FileHeader
+ *   - list of records, each one starting with a RecordHeader :
+ *     - RecordDeclare : uint8_t kind, followed by the device name (not NUL-terminated)
+ *     - RecordSample : SampleHeader followed by 'count' float values
+ * Samples are recorded by Sensor::ReadSample() as the IMU gets them, after the drivers applied
+ * their calibration, so only gyroscopes, accelerometers, magnetometers and altimeters are covered
+ **/
+class SensorRecorder : public Thread
+{
+public:
+	typedef enum {
+		KindUnknown = 0,
+		KindGyroscope = 1,
+		KindAccelerometer = 2,
+		KindMagnetometer = 3,
+		KindAltimeterAbsolute = 4,
+		KindAltimeterProximity = 5,
+	} Kind;
+
+	typedef enum {
+		RecordDeclare = 1,
+		RecordSample = 2,
+	} RecordType;
+
+	typedef struct __attribute__((packed)) {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t reserved;
+		uint64_t start_ticks;
+	} FileHeader;
+
+	typedef struct __attribute__((packed)) {
+		uint8_t type;
+		uint8_t device;
+		uint8_t size; // payload size, following this header
+		uint8_t count; // values count for RecordSample
+	} RecordHeader;
+
+	typedef struct __attribute__((packed)) {
+		uint64_t timestamp;
+		uint32_t sequence;
+	} SampleHeader;
+
+	static const uint32_t Magic = 0x52534342; // "BCSR"
+	static const uint16_t Version = 1;
+
+	SensorRecorder( const std::string& filename );
+	~SensorRecorder();
+
+	void Record( Sensor* dev, uint64_t timestamp, uint32_t sequence, const float* values, uint8_t count );
+	uint32_t dropped() const;
+
+	static Kind SensorKind( Sensor* dev );
+
+protected:
+	virtual bool run();
+	int32_t DeviceID( Sensor* dev );
+	void Append( const RecordHeader& header, const void* payload, uint32_t payload_size, const void* data = nullptr, uint32_t data_size = 0 );
+
+	FILE* mFile;
+	std::mutex mMutex;
+	std::vector< uint8_t > mBuffer;
+	std::vector< uint8_t > mFlushBuffer;
+	std::map< Sensor*, uint8_t > mDevicesIDs;
+	std::atomic< uint32_t > mDropped;
+};
+
+#endif // SENSORRECORDER_H
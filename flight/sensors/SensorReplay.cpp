@@ -0,0 +1,325 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <Debug.h>
+#include <Board.h>
+#include "SensorReplay.h"
+
+int SensorReplay::flight_register( Main* main )
+{
+	Sensor::Device dev;
+	dev.iI2CAddr = 0;
+	dev.name = "Replay";
+	dev.fInstanciate = SensorReplay::Instanciate;
+	Sensor::mKnownDevices.push_back( dev );
+	return 0;
+}
+
+
+Sensor* SensorReplay::Instanciate( Config* config, const std::string& object )
+{
+	SensorReplay* replay = new SensorReplay( config->string( object + ".file", "sensors.rec" ), config->boolean( object + ".realtime", true ) );
+	if ( not replay->valid() ) {
+		delete replay;
+		return nullptr;
+	}
+
+	// Manually add sensors to mDevices, only the first one is returned
+	Sensor* ret = nullptr;
+	for ( uint32_t i = 0; i < replay->mRecordedDevices.size(); i++ ) {
+		Sensor* sensor = nullptr;
+		const std::string& name = replay->mRecordedDevices[i].name;
+		switch ( replay->mRecordedDevices[i].kind ) {
+			case SensorRecorder::KindGyroscope :
+				sensor = new ReplayGyroscope( replay, i, name );
+				break;
+			case SensorRecorder::KindAccelerometer :
+				sensor = new ReplayAccelerometer( replay, i, name );
+				break;
+			case SensorRecorder::KindMagnetometer :
+				sensor = new ReplayMagnetometer( replay, i, name );
+				break;
+			case SensorRecorder::KindAltimeterAbsolute :
+				sensor = new ReplayAltimeter( replay, i, name, Altimeter::Absolute );
+				break;
+			case SensorRecorder::KindAltimeterProximity :
+				sensor = new ReplayAltimeter( replay, i, name, Altimeter::Proximity );
+				break;
+			default:
+				break;
+		}
+		if ( sensor == nullptr ) {
+			continue;
+		}
+		if ( ret == nullptr ) {
+			ret = sensor;
+		} else {
+			Sensor::AddDevice( sensor );
+		}
+	}
+
+	return ret;
+}
+
+
+SensorReplay::SensorReplay( const std::string& filename, bool realtime )
+	: mData( nullptr )
+	, mSize( 0 )
+	, mRealtime( realtime )
+	, mFinished( false )
+	, mFileStart( 0 )
+	, mReplayStart( 0 )
+{
+	int fd = open( filename.c_str(), O_RDONLY );
+	if ( fd < 0 ) {
+		gDebug() << "SensorReplay : cannot open \"" << filename << "\" : " << strerror( errno ) << "\n";
+		return;
+	}
+
+	struct stat st;
+	if ( fstat( fd, &st ) < 0 or st.st_size < (off_t)sizeof(SensorRecorder::FileHeader) ) {
+		gDebug() << "SensorReplay : invalid file \"" << filename << "\"\n";
+		close( fd );
+		return;
+	}
+
+	void* data = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( data == MAP_FAILED ) {
+		gDebug() << "SensorReplay : mmap failed : " << strerror( errno ) << "\n";
+		return;
+	}
+	mData = (uint8_t*)data;
+	mSize = st.st_size;
+	madvise( mData, mSize, MADV_SEQUENTIAL );
+
+	SensorRecorder::FileHeader header;
+	memcpy( &header, mData, sizeof(header) );
+	if ( header.magic != SensorRecorder::Magic or header.version != SensorRecorder::Version ) {
+		gDebug() << "SensorReplay : \"" << filename << "\" is not a sensors recording\n";
+		munmap( mData, mSize );
+		mData = nullptr;
+		mSize = 0;
+		return;
+	}
+	mFileStart = header.start_ticks;
+
+	// Collect declared devices
+	uint32_t offset = sizeof(header);
+	while ( offset + sizeof(SensorRecorder::RecordHeader) <= mSize ) {
+		SensorRecorder::RecordHeader record;
+		memcpy( &record, mData + offset, sizeof(record) );
+		uint32_t payload = offset + sizeof(record);
+		if ( payload + record.size > mSize ) {
+			break;
+		}
+		if ( record.type == SensorRecorder::RecordDeclare and record.device == mRecordedDevices.size() and record.size >= 1 ) {
+			RecordedDevice dev;
+			dev.kind = (SensorRecorder::Kind)mData[payload];
+			dev.name = std::string( (const char*)mData + payload + 1, record.size - 1 );
+			dev.cursor = payload + record.size;
+			mRecordedDevices.emplace_back( dev );
+		}
+		offset = payload + record.size;
+	}
+
+	gDebug() << "Replaying " << mRecordedDevices.size() << " sensor(s) from \"" << filename << "\" (" << ( mRealtime ? "realtime" : "fast" ) << ")\n";
+}
+
+
+SensorReplay::~SensorReplay()
+{
+	if ( mData ) {
+		munmap( mData, mSize );
+	}
+}
+
+
+bool SensorReplay::valid() const
+{
+	return ( mData != nullptr and mRecordedDevices.size() > 0 );
+}
+
+
+bool SensorReplay::finished() const
+{
+	return mFinished;
+}
+
+
+bool SensorReplay::Next( uint8_t device, uint64_t* timestamp, uint32_t* sequence, float* values, uint8_t count )
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+
+	if ( device >= mRecordedDevices.size() ) {
+		return false;
+	}
+	if ( mReplayStart == 0 ) {
+		mReplayStart = Board::GetTicks();
+	}
+
+	uint32_t offset = mRecordedDevices[device].cursor;
+	while ( offset + sizeof(SensorRecorder::RecordHeader) <= mSize ) {
+		SensorRecorder::RecordHeader record;
+		memcpy( &record, mData + offset, sizeof(record) );
+		uint32_t payload = offset + sizeof(record);
+		if ( payload + record.size > mSize ) {
+			break;
+		}
+		if ( record.type != SensorRecorder::RecordSample or record.device != device or record.size < sizeof(SensorRecorder::SampleHeader) ) {
+			offset = payload + record.size;
+			continue;
+		}
+
+		SensorRecorder::SampleHeader sample;
+		memcpy( &sample, mData + payload, sizeof(sample) );
+		uint64_t ticks = mReplayStart + ( sample.timestamp - mFileStart );
+		if ( mRealtime and ticks > Board::GetTicks() ) {
+			// Not due yet
+			mRecordedDevices[device].cursor = offset;
+			return false;
+		}
+
+		uint8_t n = std::min( count, record.count );
+		memcpy( values, mData + payload + sizeof(sample), sizeof(float) * n );
+		*timestamp = ticks;
+		*sequence = sample.sequence;
+		mRecordedDevices[device].cursor = payload + record.size;
+		return true;
+	}
+
+	mRecordedDevices[device].cursor = offset;
+	if ( not mFinished ) {
+		mFinished = true;
+		gDebug() << "SensorReplay : end of recording reached\n";
+	}
+	return false;
+}
+
+
+ReplayGyroscope::ReplayGyroscope( SensorReplay* replay, uint8_t device, const std::string& name )
+	: Gyroscope()
+	, mReplay( replay )
+	, mDevice( device )
+{
+	mNames = { "Replay:" + name };
+	mAxes[0] = mAxes[1] = mAxes[2] = true;
+	mCalibrated = true;
+	mSelfStamped = true;
+}
+
+
+void ReplayGyroscope::Read( Vector3f* v, bool raw )
+{
+	uint64_t timestamp = 0;
+	uint32_t sequence = 0;
+	float values[3] = { 0.0f };
+
+	if ( mReplay->Next( mDevice, &timestamp, &sequence, values, 3 ) ) {
+		mLastValues = Vector3f( values[0], values[1], values[2] );
+		mSampleTimestamp = timestamp;
+		mSampleSequence = sequence;
+	}
+	*v = mLastValues.xyz();
+}
+
+
+ReplayAccelerometer::ReplayAccelerometer( SensorReplay* replay, uint8_t device, const std::string& name )
+	: Accelerometer()
+	, mReplay( replay )
+	, mDevice( device )
+{
+	mNames = { "Replay:" + name };
+	mAxes[0] = mAxes[1] = mAxes[2] = true;
+	mCalibrated = true;
+	mSelfStamped = true;
+}
+
+
+void ReplayAccelerometer::Read( Vector3f* v, bool raw )
+{
+	uint64_t timestamp = 0;
+	uint32_t sequence = 0;
+	float values[3] = { 0.0f };
+
+	if ( mReplay->Next( mDevice, &timestamp, &sequence, values, 3 ) ) {
+		mLastValues = Vector3f( values[0], values[1], values[2] );
+		mSampleTimestamp = timestamp;
+		mSampleSequence = sequence;
+	}
+	*v = mLastValues.xyz();
+}
+
+
+ReplayMagnetometer::ReplayMagnetometer( SensorReplay* replay, uint8_t device, const std::string& name )
+	: Magnetometer()
+	, mReplay( replay )
+	, mDevice( device )
+{
+	mNames = { "Replay:" + name };
+	mAxes[0] = mAxes[1] = mAxes[2] = true;
+	mCalibrated = true;
+	mSelfStamped = true;
+}
+
+
+void ReplayMagnetometer::Read( Vector3f* v, bool raw )
+{
+	uint64_t timestamp = 0;
+	uint32_t sequence = 0;
+	float values[3] = { 0.0f };
+
+	if ( mReplay->Next( mDevice, &timestamp, &sequence, values, 3 ) ) {
+		mLastValues = Vector3f( values[0], values[1], values[2] );
+		mSampleTimestamp = timestamp;
+		mSampleSequence = sequence;
+	}
+	*v = mLastValues.xyz();
+}
+
+
+ReplayAltimeter::ReplayAltimeter( SensorReplay* replay, uint8_t device, const std::string& name, Type type )
+	: Altimeter()
+	, mReplay( replay )
+	, mDevice( device )
+	, mType( type )
+	, mAltitude( 0.0f )
+{
+	mNames = { "Replay:" + name };
+	mCalibrated = true;
+	mSelfStamped = true;
+}
+
+
+void ReplayAltimeter::Read( float* altitude )
+{
+	uint64_t timestamp = 0;
+	uint32_t sequence = 0;
+
+	if ( mReplay->Next( mDevice, &timestamp, &sequence, &mAltitude, 1 ) ) {
+		mSampleTimestamp = timestamp;
+		mSampleSequence = sequence;
+	}
+	*altitude = mAltitude;
+}
@@ -0,0 +1,117 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef SENSORREPLAY_H
+#define SENSORREPLAY_H
+
+#include <mutex>
+#include <vector>
+#include <string>
+#include "Gyroscope.h"
+#include "Accelerometer.h"
+#include "Magnetometer.h"
+#include "Altimeter.h"
+#include "SensorRecorder.h"
+
+/** Plays back a file written by SensorRecorder, instanciating one Replay* sensor per recorded device
+ *  Usage in config.lua : RegisterSensor( "Replay", { file = "sensors.rec", realtime = true } )
+ *    realtime = false feeds a new sample at each read, as fast as the stabilizer loop runs
+ **/
+class SensorReplay
+{
+public:
+	SensorReplay( const std::string& filename, bool realtime );
+	~SensorReplay();
+
+	bool valid() const;
+	bool finished() const;
+	// Fetches the next due sample of given device, returns false if none is available yet
+	bool Next( uint8_t device, uint64_t* timestamp, uint32_t* sequence, float* values, uint8_t count );
+
+	static Sensor* Instanciate( Config* config, const std::string& object );
+	static int flight_register( Main* main );
+
+protected:
+	typedef struct {
+		SensorRecorder::Kind kind;
+		std::string name;
+		uint32_t cursor;
+	} RecordedDevice;
+
+	uint8_t* mData;
+	uint32_t mSize;
+	bool mRealtime;
+	bool mFinished;
+	uint64_t mFileStart;
+	uint64_t mReplayStart;
+	std::vector< RecordedDevice > mRecordedDevices;
+	std::mutex mMutex;
+};
+
+
+class ReplayGyroscope : public Gyroscope
+{
+public:
+	ReplayGyroscope( SensorReplay* replay, uint8_t device, const std::string& name );
+	virtual void Calibrate( float dt, bool last_pass = false ) {}
+	virtual void Read( Vector3f* v, bool raw = false );
+protected:
+	SensorReplay* mReplay;
+	uint8_t mDevice;
+};
+
+
+class ReplayAccelerometer : public Accelerometer
+{
+public:
+	ReplayAccelerometer( SensorReplay* replay, uint8_t device, const std::string& name );
+	virtual void Calibrate( float dt, bool last_pass = false ) {}
+	virtual void Read( Vector3f* v, bool raw = false );
+protected:
+	SensorReplay* mReplay;
+	uint8_t mDevice;
+};
+
+
+class ReplayMagnetometer : public Magnetometer
+{
+public:
+	ReplayMagnetometer( SensorReplay* replay, uint8_t device, const std::string& name );
+	virtual void Calibrate( float dt, bool last_pass = false ) {}
+	virtual void Read( Vector3f* v, bool raw = false );
+protected:
+	SensorReplay* mReplay;
+	uint8_t mDevice;
+};
+
+
+class ReplayAltimeter : public Altimeter
+{
+public:
+	ReplayAltimeter( SensorReplay* replay, uint8_t device, const std::string& name, Type type );
+	virtual Type type() const { return mType; }
+	virtual void Calibrate( float dt, bool last_pass = false ) {}
+	virtual void Read( float* altitude );
+protected:
+	SensorReplay* mReplay;
+	uint8_t mDevice;
+	Type mType;
+	float mAltitude;
+};
+
+#endif // SENSORREPLAY_H
@@ -0,0 +1,418 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <termios.h>
+#include <Debug.h>
+#include "SerialGPS.h"
+
+int SerialGPS::flight_register( Main* main )
+{
+	Device dev;
+	dev.iI2CAddr = 0;
+	dev.name = "SerialGPS";
+	dev.fInstanciate = SerialGPS::Instanciate;
+	mKnownDevices.push_back( dev );
+	return 0;
+}
+
+
+Sensor* SerialGPS::Instanciate( Config* config, const std::string& object )
+{
+	SerialGPS* gps = new SerialGPS( config->string( object + ".device", "/dev/ttyAMA0" ), config->integer( object + ".speed", 9600 ) );
+	if ( gps->mFD < 0 ) {
+		delete gps;
+		return nullptr;
+	}
+	return gps;
+}
+
+
+SerialGPS::SerialGPS( const std::string& device, int speed )
+	: GPS()
+	, mDevice( device )
+	, mSpeed( speed )
+	, mFD( -1 )
+	, mThread( nullptr )
+	, mRingHead( 0 )
+	, mRingTail( 0 )
+	, mState( WaitStart )
+	, mNMEALength( 0 )
+	, mNMEAChecksum( 0 )
+	, mNMEAReceivedChecksum( 0 )
+	, mNMEAChecksumLength( 0 )
+	, mUBXLength( 0 )
+	, mUBXIndex( 0 )
+	, mCurrent{ 0.0, 0.0, 0.0f, 0.0f, 0, false }
+	, mErrors( 0 )
+	, mFixSequence( 0 )
+	, mFix{ 0.0, 0.0, 0.0f, 0.0f, 0, false }
+{
+	mNames = { "SerialGPS" };
+
+	mFD = open( mDevice.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK );
+	if ( mFD < 0 ) {
+		gDebug() << "SerialGPS : cannot open \"" << mDevice << "\" : " << strerror( errno ) << "\n";
+		return;
+	}
+
+	speed_t baudrate = B9600;
+	switch ( speed ) {
+		case 4800 : baudrate = B4800; break;
+		case 9600 : baudrate = B9600; break;
+		case 19200 : baudrate = B19200; break;
+		case 38400 : baudrate = B38400; break;
+		case 57600 : baudrate = B57600; break;
+		case 115200 : baudrate = B115200; break;
+		case 230400 : baudrate = B230400; break;
+		default : gDebug() << "SerialGPS : unsupported speed " << speed << ", using 9600\n"; break;
+	}
+
+	struct termios options;
+	if ( tcgetattr( mFD, &options ) == 0 ) {
+		cfmakeraw( &options );
+		cfsetispeed( &options, baudrate );
+		cfsetospeed( &options, baudrate );
+		options.c_cflag |= ( CLOCAL | CREAD );
+		tcsetattr( mFD, TCSANOW, &options );
+	}
+
+	mThread = new HookThread< SerialGPS >( "gps", this, &SerialGPS::ReadRun );
+	mThread->Start();
+	mThread->setPriority( 1 );
+}
+
+
+SerialGPS::~SerialGPS()
+{
+	if ( mThread ) {
+		mThread->Stop();
+		mThread->Join();
+		delete mThread;
+	}
+	if ( mFD >= 0 ) {
+		close( mFD );
+	}
+}
+
+
+void SerialGPS::Calibrate( float dt, bool last_pass )
+{
+	// Nothing to do
+}
+
+
+uint32_t SerialGPS::errors() const
+{
+	return mErrors;
+}
+
+
+void SerialGPS::fix( Fix* ret ) const
+{
+	uint32_t seq0;
+	uint32_t seq1;
+	do {
+		seq0 = mFixSequence.load( std::memory_order_acquire );
+		memcpy( ret, &mFix, sizeof(Fix) );
+		std::atomic_thread_fence( std::memory_order_acquire );
+		seq1 = mFixSequence.load( std::memory_order_relaxed );
+	} while ( ( seq0 & 1 ) or seq0 != seq1 );
+}
+
+
+void SerialGPS::Read( float* lattitude, float* longitude, float* altitude, float* speed )
+{
+	Fix f;
+	fix( &f );
+
+	if ( f.valid ) {
+		*lattitude = f.latitude;
+		*longitude = f.longitude;
+		*altitude = f.altitude;
+		*speed = f.speed;
+		mLastValues = Vector4f( f.latitude, f.longitude, f.altitude, f.speed );
+	}
+}
+
+
+void SerialGPS::Publish()
+{
+	mCurrent.timestamp = Board::GetTicks();
+
+	uint32_t seq = mFixSequence.load( std::memory_order_relaxed );
+	mFixSequence.store( seq + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	memcpy( &mFix, &mCurrent, sizeof(Fix) );
+	mFixSequence.store( seq + 2, std::memory_order_release );
+}
+
+
+bool SerialGPS::ReadRun()
+{
+	struct pollfd pfd;
+	pfd.fd = mFD;
+	pfd.events = POLLIN;
+	if ( poll( &pfd, 1, 500 ) <= 0 ) {
+		return true;
+	}
+
+	// Read into the contiguous free space of the ring
+	uint32_t head = mRingHead % sizeof(mRing);
+	uint32_t tail = mRingTail % sizeof(mRing);
+	uint32_t space = sizeof(mRing) - ( mRingHead - mRingTail );
+	uint32_t contiguous = std::min( space, (uint32_t)sizeof(mRing) - head );
+	if ( contiguous > 0 ) {
+		ssize_t ret = read( mFD, &mRing[head], contiguous );
+		if ( ret < 0 and errno != EAGAIN ) {
+			gDebug() << "SerialGPS : read error : " << strerror( errno ) << "\n";
+			usleep( 1000 * 100 );
+		} else if ( ret > 0 ) {
+			mRingHead += ret;
+		}
+	}
+
+	while ( mRingTail != mRingHead ) {
+		tail = mRingTail % sizeof(mRing);
+		Parse( mRing[tail] );
+		mRingTail++;
+	}
+
+	return true;
+}
+
+
+void SerialGPS::Parse( uint8_t c )
+{
+	switch ( mState ) {
+		case WaitStart : {
+			if ( c == '$' ) {
+				mNMEALength = 0;
+				mNMEAChecksum = 0;
+				mState = NMEAData;
+			} else if ( c == 0xB5 ) {
+				mState = UBXSync;
+			}
+			break;
+		}
+
+		case NMEAData : {
+			if ( c == '*' ) {
+				mNMEA[mNMEALength] = '\0';
+				mNMEAReceivedChecksum = 0;
+				mNMEAChecksumLength = 0;
+				mState = NMEAChecksum;
+			} else if ( c == '\r' or c == '\n' or c == '$' or mNMEALength >= sizeof(mNMEA) - 1 ) {
+				// Truncated sentence
+				mErrors++;
+				mState = ( c == '$' ) ? NMEAData : WaitStart;
+				mNMEALength = 0;
+				mNMEAChecksum = 0;
+			} else {
+				mNMEA[mNMEALength++] = c;
+				mNMEAChecksum ^= c;
+			}
+			break;
+		}
+
+		case NMEAChecksum : {
+			uint8_t v = 0xFF;
+			if ( c >= '0' and c <= '9' ) {
+				v = c - '0';
+			} else if ( c >= 'A' and c <= 'F' ) {
+				v = c - 'A' + 10;
+			} else if ( c >= 'a' and c <= 'f' ) {
+				v = c - 'a' + 10;
+			}
+			if ( v == 0xFF ) {
+				mErrors++;
+				mState = WaitStart;
+				break;
+			}
+			mNMEAReceivedChecksum = ( mNMEAReceivedChecksum << 4 ) | v;
+			if ( ++mNMEAChecksumLength == 2 ) {
+				if ( mNMEAReceivedChecksum == mNMEAChecksum ) {
+					ParseNMEA();
+				} else {
+					mErrors++;
+				}
+				mState = WaitStart;
+			}
+			break;
+		}
+
+		case UBXSync : {
+			if ( c == 0x62 ) {
+				mUBXIndex = 0;
+				mState = UBXHeader;
+			} else {
+				mState = ( c == '$' ) ? NMEAData : WaitStart;
+				mNMEALength = 0;
+				mNMEAChecksum = 0;
+			}
+			break;
+		}
+
+		case UBXHeader : {
+			mUBXHeader[mUBXIndex++] = c;
+			if ( mUBXIndex == 4 ) {
+				mUBXLength = mUBXHeader[2] | ( mUBXHeader[3] << 8 );
+				mUBXIndex = 0;
+				mUBXChecksum[0] = 0;
+				mUBXChecksum[1] = 0;
+				for ( uint32_t i = 0; i < 4; i++ ) {
+					mUBXChecksum[0] += mUBXHeader[i];
+					mUBXChecksum[1] += mUBXChecksum[0];
+				}
+				mState = ( mUBXLength == 0 ) ? UBXChecksum : UBXPayload;
+			}
+			break;
+		}
+
+		case UBXPayload : {
+			// Oversized messages are checksummed but not stored
+			if ( mUBXIndex < sizeof(mUBX) ) {
+				mUBX[mUBXIndex] = c;
+			}
+			mUBXIndex++;
+			mUBXChecksum[0] += c;
+			mUBXChecksum[1] += mUBXChecksum[0];
+			if ( mUBXIndex == mUBXLength ) {
+				mUBXIndex = 0;
+				mState = UBXChecksum;
+			}
+			break;
+		}
+
+		case UBXChecksum : {
+			if ( c != mUBXChecksum[mUBXIndex] ) {
+				mErrors++;
+				mState = WaitStart;
+				break;
+			}
+			if ( ++mUBXIndex == 2 ) {
+				if ( mUBXLength <= sizeof(mUBX) ) {
+					ParseUBX();
+				}
+				mState = WaitStart;
+			}
+			break;
+		}
+
+		default : {
+			mState = WaitStart;
+			break;
+		}
+	}
+}
+
+
+double SerialGPS::NMEACoordinate( const char* value, const char* hemisphere )
+{
+	// [d]ddmm.mmmm format
+	double raw = atof( value );
+	double degrees = (double)( (int)( raw / 100.0 ) );
+	double ret = degrees + ( raw - degrees * 100.0 ) / 60.0;
+	if ( hemisphere[0] == 'S' or hemisphere[0] == 'W' ) {
+		ret = -ret;
+	}
+	return ret;
+}
+
+
+void SerialGPS::ParseNMEA()
+{
+	// Split fields in place
+	const char* fields[24];
+	uint32_t count = 0;
+	fields[count++] = mNMEA;
+	for ( uint32_t i = 0; i < mNMEALength and count < 24; i++ ) {
+		if ( mNMEA[i] == ',' ) {
+			mNMEA[i] = '\0';
+			fields[count++] = &mNMEA[i + 1];
+		}
+	}
+	if ( strlen( fields[0] ) != 5 ) {
+		return;
+	}
+	const char* type = fields[0] + 2; // Skip talker ID (GP, GN, GL..)
+
+	if ( not strcmp( type, "GGA" ) and count >= 10 ) {
+		// $--GGA,time,lat,N/S,lon,E/W,quality,satellites,hdop,altitude,M,...
+		if ( atoi( fields[6] ) == 0 or fields[2][0] == '\0' or fields[4][0] == '\0' ) {
+			mCurrent.valid = false;
+		} else {
+			mCurrent.latitude = NMEACoordinate( fields[2], fields[3] );
+			mCurrent.longitude = NMEACoordinate( fields[4], fields[5] );
+			mCurrent.altitude = atof( fields[9] );
+			mCurrent.valid = true;
+		}
+		Publish();
+	} else if ( not strcmp( type, "RMC" ) and count >= 8 ) {
+		// $--RMC,time,A/V,lat,N/S,lon,E/W,speed(knots),...
+		if ( fields[2][0] != 'A' or fields[3][0] == '\0' or fields[5][0] == '\0' ) {
+			mCurrent.valid = false;
+		} else {
+			mCurrent.latitude = NMEACoordinate( fields[3], fields[4] );
+			mCurrent.longitude = NMEACoordinate( fields[5], fields[6] );
+			mCurrent.speed = atof( fields[7] ) * 0.514444f;
+			mCurrent.valid = true;
+		}
+		Publish();
+	}
+}
+
+
+void SerialGPS::ParseUBX()
+{
+	// NAV-PVT
+	if ( mUBXHeader[0] == 0x01 and mUBXHeader[1] == 0x07 and mUBXLength >= 92 ) {
+		uint8_t fixType = mUBX[20];
+		uint8_t flags = mUBX[21];
+		int32_t lon = 0;
+		int32_t lat = 0;
+		int32_t hMSL = 0;
+		int32_t gSpeed = 0;
+		memcpy( &lon, &mUBX[24], 4 );
+		memcpy( &lat, &mUBX[28], 4 );
+		memcpy( &hMSL, &mUBX[36], 4 );
+		memcpy( &gSpeed, &mUBX[60], 4 );
+
+		if ( ( flags & 0x01 ) and ( fixType == 2 or fixType == 3 ) ) {
+			mCurrent.latitude = (double)lat * 1.0e-7;
+			mCurrent.longitude = (double)lon * 1.0e-7;
+			mCurrent.altitude = (float)hMSL / 1000.0f;
+			mCurrent.speed = (float)gSpeed / 1000.0f;
+			mCurrent.valid = true;
+		} else {
+			mCurrent.valid = false;
+		}
+		Publish();
+	}
+}
+
+
+std::string SerialGPS::infos()
+{
+	return "Device = \"" + mDevice + "\", Speed = " + std::to_string( mSpeed ) + ", Protocols = \"NMEA, UBX\"";
+}
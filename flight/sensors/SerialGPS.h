@@ -0,0 +1,105 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef SERIALGPS_H
+#define SERIALGPS_H
+
+#include <atomic>
+#include <Thread.h>
+#include "GPS.h"
+
+/** Native NMEA / u-blox UBX GPS, reading a UART from its own thread
+ *  Usage in config.lua : RegisterSensor( "SerialGPS", { device = "/dev/ttyAMA0", speed = 9600 } )
+ *  Any tty can be used, so recorded logs can be replayed through a pty, e.g. :
+ *    socat pty,raw,echo=0,link=/tmp/gps0 pty,raw,echo=0,link=/tmp/gps1 & cat gps.log > /tmp/gps1
+ **/
+class SerialGPS : public GPS
+{
+public:
+	typedef struct {
+		double latitude;
+		double longitude;
+		float altitude;
+		float speed; // m/s
+		uint64_t timestamp; // Board::GetTicks() when the fix was received
+		bool valid;
+	} Fix;
+
+	SerialGPS( const std::string& device, int speed );
+	~SerialGPS();
+
+	virtual void Calibrate( float dt, bool last_pass );
+	virtual void Read( float* lattitude, float* longitude, float* altitude, float* speed );
+	// Copies last published fix, never blocks
+	void fix( Fix* ret ) const;
+	uint32_t errors() const;
+
+	virtual std::string infos();
+
+	static Sensor* Instanciate( Config* config, const std::string& object );
+	static int flight_register( Main* main );
+
+protected:
+	bool ReadRun();
+	void Parse( uint8_t c );
+	void ParseNMEA();
+	void ParseUBX();
+	void Publish();
+	static double NMEACoordinate( const char* value, const char* hemisphere );
+
+	typedef enum {
+		WaitStart,
+		NMEAData,
+		NMEAChecksum,
+		UBXSync,
+		UBXHeader,
+		UBXPayload,
+		UBXChecksum,
+	} ParserState;
+
+	std::string mDevice;
+	int mSpeed;
+	int mFD;
+	HookThread< SerialGPS >* mThread;
+
+	// Raw UART data, written by read() and consumed by the parser
+	uint8_t mRing[4096];
+	uint32_t mRingHead;
+	uint32_t mRingTail;
+
+	// Parser state, fixed size buffers only
+	ParserState mState;
+	char mNMEA[96];
+	uint32_t mNMEALength;
+	uint8_t mNMEAChecksum;
+	uint8_t mNMEAReceivedChecksum;
+	uint32_t mNMEAChecksumLength;
+	uint8_t mUBXHeader[4];
+	uint8_t mUBX[256];
+	uint32_t mUBXLength;
+	uint32_t mUBXIndex;
+	uint8_t mUBXChecksum[2];
+	Fix mCurrent;
+	uint32_t mErrors;
+
+	// Published fix, seqlock protected (odd sequence means writing in progress)
+	std::atomic< uint32_t > mFixSequence;
+	Fix mFix;
+};
+
+#endif // SERIALGPS_H
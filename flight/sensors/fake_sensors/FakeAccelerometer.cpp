@@ -16,15 +16,15 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
-#include <cmath>
 #include "FakeAccelerometer.h"
 
 
+uint32_t FakeAccelerometer::mInstances = 0;
+
 FakeAccelerometer::FakeAccelerometer( int axisCount, const Vector3f& noiseGain )
 	: Accelerometer()
 	, mAxisCount( axisCount )
-	, mNoiseGain( noiseGain )
-	, mSinCounter( 0.0f )
+	, mNoise( DefaultModel( noiseGain ), 0x61636365ULL + mInstances++ )
 {
 	mNames = { "FakeAccelerometer" };
 }
@@ -35,6 +35,29 @@ FakeAccelerometer::~FakeAccelerometer()
 }
 
 
+FakeNoise::Model FakeAccelerometer::DefaultModel( const Vector3f& noiseGain )
+{
+	FakeNoise::Model model;
+	model.white = noiseGain;
+	model.bias_walk = 0.001f;
+	model.temperature_drift = 0.002f;
+	model.temperature_rise = 15.0f;
+	model.temperature_tau = 120.0f;
+	model.vibration = 1.0f;
+	model.vibration_frequency = 150.0f;
+	model.lsb = 16.0f * 9.8f / 32768.0f; // ±16g on 16 bits
+	model.range = 16.0f * 9.8f;
+	model.sample_rate = 0.0f;
+	return model;
+}
+
+
+void FakeAccelerometer::LoadNoiseModel( Config* config, const std::string& object )
+{
+	mNoise.Load( config, object );
+}
+
+
 void FakeAccelerometer::Calibrate( float dt, bool last_pass )
 {
 }
@@ -42,17 +65,15 @@ void FakeAccelerometer::Calibrate( float dt, bool last_pass )
 
 void FakeAccelerometer::Read( Vector3f* v, bool raw )
 {
-	for ( int i = 0; i < mAxisCount; i++ ) {
-		v->operator[](0) = 0.0f * std::sin( mSinCounter ) + mNoiseGain[0] * ( (float)( rand() % 65536 ) - 32768.0f ) / 32768.0f;
-		v->operator[](1) = mNoiseGain[1] * ( (float)( rand() % 65536 ) - 32768.0f ) / 32768.0f;
-		v->operator[](2) = 9.8f + mNoiseGain[2] * ( (float)( rand() % 65536 ) - 32768.0f ) / 32768.0f;
+	*v = mNoise.Apply( Vector3f( 0.0f, 0.0f, 9.8f ) );
+	for ( int i = mAxisCount; i < 3; i++ ) {
+		v->operator[](i) = 0.0f;
 	}
 	mLastValues = *v;
-	mSinCounter += 0.01;
 }
 
 
 std::string FakeAccelerometer::infos()
 {
-	return "Resolution = \"32 bits float\", Scale = \"16g\"";
+	return "Resolution = \"16 bits\", Scale = \"16g\""; // See DefaultModel()
 }
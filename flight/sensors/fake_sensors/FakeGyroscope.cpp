@@ -16,14 +16,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
-#include <cmath>
 #include "FakeGyroscope.h"
 
+uint32_t FakeGyroscope::mInstances = 0;
+
 FakeGyroscope::FakeGyroscope( int axisCount, const Vector3f& noiseGain )
 	: Gyroscope()
 	, mAxisCount( axisCount )
-	, mNoiseGain( noiseGain )
-	, mSinCounter( 0.0f )
+	, mNoise( DefaultModel( noiseGain ), 0x6779726FULL + mInstances++ )
 {
 	mNames = { "FakeGyroscope" };
 }
@@ -34,6 +34,29 @@ FakeGyroscope::~FakeGyroscope()
 }
 
 
+FakeNoise::Model FakeGyroscope::DefaultModel( const Vector3f& noiseGain )
+{
+	FakeNoise::Model model;
+	model.white = noiseGain;
+	model.bias_walk = 0.01f;
+	model.temperature_drift = 0.02f;
+	model.temperature_rise = 15.0f;
+	model.temperature_tau = 120.0f;
+	model.vibration = 0.5f;
+	model.vibration_frequency = 150.0f;
+	model.lsb = 0.061037018952f; // ±2000°/s on 16 bits
+	model.range = 2000.0f;
+	model.sample_rate = 0.0f;
+	return model;
+}
+
+
+void FakeGyroscope::LoadNoiseModel( Config* config, const std::string& object )
+{
+	mNoise.Load( config, object );
+}
+
+
 void FakeGyroscope::Calibrate( float dt, bool last_pass )
 {
 }
@@ -41,17 +64,15 @@ void FakeGyroscope::Calibrate( float dt, bool last_pass )
 
 void FakeGyroscope::Read( Vector3f* v, bool raw )
 {
-	for ( int i = 0; i < mAxisCount; i++ ) {
-		v->operator[](0) = 0.0f * std::sin( mSinCounter + 3.14 / 2 ) + mNoiseGain[0] * ( (float)( rand() % 65536 ) - 32768.0f ) / 32768.0f;
-		v->operator[](1) = mNoiseGain[1] * ( (float)( rand() % 65536 ) - 32768.0f ) / 32768.0f;
-		v->operator[](2) = mNoiseGain[2] * ( (float)( rand() % 65536 ) - 32768.0f ) / 32768.0f;
+	*v = mNoise.Apply( Vector3f() );
+	for ( int i = mAxisCount; i < 3; i++ ) {
+		v->operator[](i) = 0.0f;
 	}
 	mLastValues = *v;
-	mSinCounter += 0.1;
 }
 
 
 std::string FakeGyroscope::infos()
 {
-	return "Resolution = \"32 bits float\", Scale = \"16g\"";
+	return "Resolution = \"16 bits\", Scale = \"2000°/s\""; // See DefaultModel()
 }
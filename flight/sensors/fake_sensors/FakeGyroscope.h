@@ -20,6 +20,7 @@
 #define FAKEGYROSCOPE_H
 
 #include <Gyroscope.h>
+#include "FakeNoise.h"
 
 class FakeGyroscope : public Gyroscope
 {
@@ -27,15 +28,18 @@ public:
 	FakeGyroscope( int axisCount = 3, const Vector3f& noiseGain = Vector3f( 0.4f, 0.4f, 0.4f ) );
 	~FakeGyroscope();
 
+	void LoadNoiseModel( Config* config, const std::string& object );
 	void Read( Vector3f* v, bool raw = false );
 	void Calibrate( float dt, bool last_pass = false );
 
 	std::string infos();
 
 protected:
+	static FakeNoise::Model DefaultModel( const Vector3f& noiseGain );
+
 	int mAxisCount;
-	Vector3f mNoiseGain;
-	float mSinCounter;
+	FakeNoise mNoise;
+	static uint32_t mInstances;
 };
 
 #endif // FAKEGYROSCOPE_H
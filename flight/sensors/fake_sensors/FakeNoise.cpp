@@ -0,0 +1,166 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <cmath>
+#include <Main.h>
+#include "FakeNoise.h"
+
+FakeNoise::FakeNoise( const Model& model, uint64_t salt )
+	: mModel( model )
+	, mSalt( salt )
+	, mState( 0 )
+	, mTicks( 0 )
+	, mSamples( 0 )
+	, mBias( Vector3f() )
+	, mTemperatureCoefficients( Vector3f() )
+	, mPhaseCos( Vector3f() )
+	, mPhaseSin( Vector3f() )
+	, mTemperature( 0.0f )
+	, mWarmup( 1.0f )
+	, mVibrationCos( 1.0f )
+	, mVibrationSin( 0.0f )
+	, mStepWalk( 0.0f )
+	, mStepDecay( 1.0f )
+	, mStepCos( 1.0f )
+	, mStepSin( 0.0f )
+{
+	Seed( salt );
+	Precompute();
+}
+
+
+FakeNoise::~FakeNoise()
+{
+}
+
+
+void FakeNoise::Load( Config* config, const std::string& object )
+{
+	mModel.white.x = config->number( object + ".white.x", mModel.white.x );
+	mModel.white.y = config->number( object + ".white.y", mModel.white.y );
+	mModel.white.z = config->number( object + ".white.z", mModel.white.z );
+	mModel.bias_walk = config->number( object + ".bias_walk", mModel.bias_walk );
+	mModel.temperature_drift = config->number( object + ".temperature_drift", mModel.temperature_drift );
+	mModel.temperature_rise = config->number( object + ".temperature_rise", mModel.temperature_rise );
+	mModel.temperature_tau = config->number( object + ".temperature_tau", mModel.temperature_tau );
+	mModel.vibration = config->number( object + ".vibration", mModel.vibration );
+	mModel.vibration_frequency = config->number( object + ".vibration_frequency", mModel.vibration_frequency );
+	mModel.lsb = config->number( object + ".lsb", mModel.lsb );
+	mModel.range = config->number( object + ".range", mModel.range );
+	mModel.sample_rate = config->number( object + ".sample_rate", mModel.sample_rate );
+
+	int32_t seed = config->integer( object + ".seed", 0 );
+	if ( seed != 0 ) {
+		Seed( (uint64_t)seed * 0x9E3779B97F4A7C15ULL ^ mSalt );
+	}
+	Precompute();
+}
+
+
+void FakeNoise::Seed( uint64_t state )
+{
+	mState = state ? state : 0x9E3779B97F4A7C15ULL;
+
+	// Each axis gets its own drift direction and vibration phase
+	for ( int i = 0; i < 3; i++ ) {
+		mTemperatureCoefficients[i] = Uniform();
+		float phase = Uniform() * M_PI;
+		mPhaseCos[i] = std::cos( phase );
+		mPhaseSin[i] = std::sin( phase );
+	}
+}
+
+
+void FakeNoise::Precompute()
+{
+	if ( mModel.sample_rate <= 0.0f ) {
+		return;
+	}
+
+	float dt = std::min( 1.0f, 1.0f / mModel.sample_rate );
+	double step = 2.0 * M_PI * mModel.vibration_frequency / mModel.sample_rate;
+	mStepWalk = mModel.bias_walk * std::sqrt( dt );
+	mStepDecay = ( mModel.temperature_tau > 0.0f ) ? std::exp( -dt / mModel.temperature_tau ) : 1.0f;
+	mStepCos = std::cos( step );
+	mStepSin = std::sin( step );
+}
+
+
+float FakeNoise::temperature() const
+{
+	return mTemperature;
+}
+
+
+Vector3f FakeNoise::Apply( const Vector3f& value )
+{
+	// The first sample only starts the clock
+	float walk = 0.0f;
+	if ( mModel.sample_rate > 0.0f ) {
+		if ( mSamples++ > 0 ) {
+			walk = mStepWalk;
+			mWarmup *= mStepDecay;
+			Rotate( mStepCos, mStepSin );
+		}
+	} else {
+		uint64_t ticks = Board::GetTicks();
+		if ( mTicks != 0 ) {
+			float dt = std::min( 1.0f, (float)( ticks - mTicks ) / 1000000.0f );
+			double step = 2.0 * M_PI * mModel.vibration_frequency * dt;
+			walk = mModel.bias_walk * std::sqrt( dt );
+			if ( mModel.temperature_tau > 0.0f ) {
+				mWarmup *= std::exp( -dt / mModel.temperature_tau );
+			}
+			if ( mModel.vibration != 0.0f ) {
+				Rotate( std::cos( step ), std::sin( step ) );
+			}
+		}
+		mTicks = ticks;
+	}
+	if ( mModel.temperature_tau > 0.0f ) {
+		mTemperature = mModel.temperature_rise * ( 1.0f - mWarmup );
+	}
+
+	// Harmonic from the double angle of the fundamental
+	float c = mVibrationCos;
+	float s = mVibrationSin;
+	float c2 = c * c - s * s;
+	float s2 = 2.0f * s * c;
+
+	Vector3f ret;
+	for ( int i = 0; i < 3; i++ ) {
+		mBias[i] += walk * Gaussian();
+		float v = value[i] + mBias[i];
+		v += mModel.white[i] * Gaussian();
+		v += mModel.temperature_drift * mTemperatureCoefficients[i] * mTemperature;
+		if ( mModel.vibration != 0.0f ) {
+			float fundamental = s * mPhaseCos[i] + c * mPhaseSin[i];
+			float harmonic = s2 * mPhaseCos[i] + c2 * mPhaseSin[i];
+			v += mModel.vibration * ( fundamental + 0.5f * harmonic );
+		}
+		if ( mModel.lsb > 0.0f ) {
+			v = std::round( v / mModel.lsb ) * mModel.lsb;
+		}
+		if ( mModel.range > 0.0f ) {
+			v = std::max( -mModel.range, std::min( mModel.range, v ) );
+		}
+		ret[i] = v;
+	}
+
+	return ret;
+}
@@ -0,0 +1,110 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef FAKENOISE_H
+#define FAKENOISE_H
+
+#include <stdint.h>
+#include <string>
+#include <Vector.h>
+
+class Config;
+
+/** Noise model used by fake sensors, applied independently on each axis :
+ *   - white noise
+ *   - bias random walk
+ *   - temperature drift, with the sensor warming up from ambient temperature
+ *   - motors vibrations (fundamental and first harmonic)
+ *   - quantisation and saturation, as done by a real ADC
+ **/
+class FakeNoise
+{
+public:
+	typedef struct {
+		Vector3f white;
+		float bias_walk; // unit/√s
+		float temperature_drift; // unit/°C
+		float temperature_rise; // °C, reached after warm-up
+		float temperature_tau; // warm-up time constant, in seconds
+		float vibration; // unit, amplitude of the fundamental
+		float vibration_frequency; // Hz
+		float lsb; // quantisation step, 0 to disable
+		float range; // saturation, 0 to disable
+		float sample_rate; // Hz, time is derived from the samples count instead of the clock when set, so that seeded runs are reproducible
+	} Model;
+
+	// salt is mixed into every seed, so that sensors of different types or instances sharing a configured seed stay uncorrelated
+	FakeNoise( const Model& model, uint64_t salt );
+	~FakeNoise();
+
+	void Load( Config* config, const std::string& object );
+	Vector3f Apply( const Vector3f& value );
+	float temperature() const;
+
+protected:
+	void Seed( uint64_t state );
+	void Precompute();
+	// Advances the vibration by an angle given as its cosine and sine, renormalising to keep rounding errors from accumulating
+	inline void Rotate( double c, double s ) {
+		double x = mVibrationCos * c - mVibrationSin * s;
+		double y = mVibrationSin * c + mVibrationCos * s;
+		double k = 1.5 - 0.5 * ( x * x + y * y );
+		mVibrationCos = x * k;
+		mVibrationSin = y * k;
+	}
+
+	// xorshift64* generator, much faster than rand() and without any global lock
+	inline uint64_t Next() {
+		mState ^= mState >> 12;
+		mState ^= mState << 25;
+		mState ^= mState >> 27;
+		return mState * 2685821657736338717ULL;
+	}
+	// Uniform in [-1;1[
+	inline float Uniform() {
+		return (float)( Next() >> 40 ) * ( 2.0f / 16777216.0f ) - 1.0f;
+	}
+	// Approximately normal, unit variance (Irwin-Hall with 4 samples)
+	inline float Gaussian() {
+		uint64_t r = Next();
+		float sum = (float)( r & 0xFFFF ) + (float)( ( r >> 16 ) & 0xFFFF ) + (float)( ( r >> 32 ) & 0xFFFF ) + (float)( r >> 48 );
+		return ( sum * ( 1.0f / 65536.0f ) - 2.0f ) * 1.7320508f;
+	}
+
+	Model mModel;
+	uint64_t mSalt;
+	uint64_t mState;
+	uint64_t mTicks;
+	uint64_t mSamples;
+	Vector3f mBias;
+	Vector3f mTemperatureCoefficients;
+	Vector3f mPhaseCos;
+	Vector3f mPhaseSin;
+	float mTemperature;
+	float mWarmup; // remaining fraction of temperature_rise
+	// Vibration fundamental, kept as a rotating unit vector instead of calling sin() on each sample (in double, long runs would drift in phase otherwise)
+	double mVibrationCos;
+	double mVibrationSin;
+	// Per-sample steps, constant when sample_rate is set
+	float mStepWalk;
+	float mStepDecay;
+	double mStepCos;
+	double mStepSin;
+};
+
+#endif // FAKENOISE_H
@@ -34,6 +34,7 @@ IMU::IMU( Main* main )
 	, mState( Off )
 	, mAcceleration( Vector3f() )
 	, mGyroscope( Vector3f() )
+	, mGyroscopeDt( 0.0f )
 	, mMagnetometer( Vector3f() )
 	, mAltitude( 0.0f )
 	, mAltitudeOffset( 0.0f )
@@ -44,6 +45,10 @@ IMU::IMU( Main* main )
 	, mRPYOffset( Vector3f() )
 	, mCalibrationStep( 0 )
 	, mCalibrationTimer( 0 )
+	, mCalibrationCache( main->config()->boolean( "stabilizer.calibration_cache", true ) )
+	, mCalibrationResidual( Vector4f() )
+	, mCalibrationMotion( 0.0f )
+	, mCalibrationSaveThread( new HookThread<IMU>( "imu_calib_save", this, &IMU::CalibrationSaveRun ) )
 	, mRPYAccum( Vector4f() )
 	, mGravity( Vector3f() )
 	, mRates( 3, 3 )
@@ -53,6 +58,7 @@ IMU::IMU( Main* main )
 	, mVelocity( 3, 3 )
 	, mLastAccelAttitude( Vector4f() )
 	, mLastAcceleration( Vector3f() )
+	, mSampleGaps( 0 )
 {
 	/** mRates matrix :
 	 *   - Inputs :
@@ -219,6 +225,12 @@ const float IMU::altitude() const
 }
 
 
+const uint32_t IMU::sampleGaps() const
+{
+	return mSampleGaps;
+}
+
+
 const Vector3f IMU::velocity() const
 {
 	return mVelocity.state( 0 );
@@ -323,6 +335,12 @@ void IMU::Calibrate( float dt, bool all )
 		case 0 : {
 			gDebug() << "Calibrating " << ( all ? "all " : "" ) << "sensors\n";
 			mCalibrationStep++;
+			if ( not all and LoadCalibrationCache() ) {
+				gDebug() << "Checking cached gyroscope offsets\n";
+				mCalibrationResidual = Vector4f();
+				mCalibrationMotion = 0.0f;
+				mCalibrationStep = 6;
+			}
 			mCalibrationTimer = Board::GetTicks();
 			break;
 		}
@@ -344,6 +362,14 @@ void IMU::Calibrate( float dt, bool all )
 					dev->Calibrate( dt, true );
 				}
 			}
+			mCalibrationSaveMutex.lock();
+			for ( Gyroscope* dev : Sensor::Gyroscopes() ) {
+				dev->SaveCachedOffset( dev->temperature(), &mCalibrationSave );
+			}
+			if ( mCalibrationSave.size() > 0 ) {
+				mCalibrationSaveThread->Start();
+			}
+			mCalibrationSaveMutex.unlock();
 			mCalibrationStep++;
 			if ( all == false ) {
 				mCalibrationStep = 5;
@@ -374,15 +400,72 @@ void IMU::Calibrate( float dt, bool all )
 			mRPY = Vector3f();
 			mdRPY = Vector3f();
 			mRate = Vector3f();
+			mGyroscopeDt = 0.0f;
+			mSamplesStates.clear();
 			gDebug() << "Calibration done !\n";
 			mMain->frame()->Disarm(); // Activate motors
 			break;
 		}
+		case 6 : {
+			// Cached offsets are applied, the drone must be still and gyroscopes must read zero
+			for ( Gyroscope* dev : Sensor::Gyroscopes() ) {
+				Vector3f gyro;
+				dev->Read( &gyro );
+				mCalibrationResidual += Vector4f( gyro, 1.0f );
+				mCalibrationMotion = std::max( mCalibrationMotion, std::max( std::abs( gyro.x ), std::max( std::abs( gyro.y ), std::abs( gyro.z ) ) ) );
+			}
+			if ( Board::GetTicks() - mCalibrationTimer >= IMU_CALIBRATION_CACHE_CHECK_TIME ) {
+				Vector3f residual = mCalibrationResidual.xyz() / std::max( mCalibrationResidual.w, 1.0f );
+				if ( mCalibrationMotion < IMU_CALIBRATION_CACHE_MAX_MOTION and std::abs( residual.x ) < IMU_CALIBRATION_CACHE_MAX_RESIDUAL and std::abs( residual.y ) < IMU_CALIBRATION_CACHE_MAX_RESIDUAL and std::abs( residual.z ) < IMU_CALIBRATION_CACHE_MAX_RESIDUAL ) {
+					gDebug() << "Cached gyroscope offsets valid\n";
+					mCalibrationStep = 5;
+				} else {
+					// Motion or temperature drift, fall back to full gyroscope calibration
+					gDebug() << "Cached gyroscope offsets rejected (residual " << residual.x << ", " << residual.y << ", " << residual.z << ", motion " << mCalibrationMotion << ")\n";
+					mCalibrationStep = 1;
+					mCalibrationTimer = Board::GetTicks();
+				}
+			}
+			break;
+		}
 		default: break;
 	}
 }
 
 
+bool IMU::CalibrationSaveRun()
+{
+	std::map< std::string, std::string > registers;
+
+	// Pause before taking the registers, so that offsets queued meanwhile start the thread again
+	mCalibrationSaveMutex.lock();
+	mCalibrationSaveThread->Pause();
+	registers.swap( mCalibrationSave );
+	mCalibrationSaveMutex.unlock();
+
+	if ( registers.size() > 0 ) {
+		Board::SaveRegisters( registers );
+	}
+	return true;
+}
+
+
+bool IMU::LoadCalibrationCache()
+{
+	if ( not mCalibrationCache or Sensor::Gyroscopes().size() == 0 ) {
+		return false;
+	}
+
+	for ( Gyroscope* dev : Sensor::Gyroscopes() ) {
+		if ( not dev->LoadCachedOffset( dev->temperature() ) ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
 void IMU::Recalibrate()
 {
 	bool cal_all = false;
@@ -432,6 +515,32 @@ void IMU::ResetYaw()
 }
 
 
+float IMU::SampleDelta( Sensor* dev, uint64_t timestamp, uint32_t sequence, float dt )
+{
+	// Drivers which are not self-stamped get a new sample stamped on every read, so the delta
+	// below is the time between two reads and no gap can be detected for them
+	SampleState& last = mSamplesStates[ dev ];
+
+	if ( last.timestamp != 0 ) {
+		if ( sequence == last.sequence or timestamp <= last.timestamp ) {
+			// Duplicate or stale read
+			return 0.0f;
+		}
+		if ( sequence > last.sequence + 1 ) {
+			mSampleGaps += sequence - last.sequence - 1;
+		}
+	}
+
+	float ret = dt;
+	if ( last.timestamp != 0 and timestamp - last.timestamp < 1000 * 1000 ) {
+		ret = (float)( timestamp - last.timestamp ) / 1000000.0f;
+	}
+	last.timestamp = timestamp;
+	last.sequence = sequence;
+	return ret;
+}
+
+
 void IMU::UpdateSensors( float dt, bool gyro_only )
 {
 	Vector4f total_accel;
@@ -440,41 +549,70 @@ void IMU::UpdateSensors( float dt, bool gyro_only )
 	Vector2f total_alti;
 	Vector2f total_proxi;
 	Vector3f total_lat_lon;
-	Vector3f vtmp;
-	float ftmp;
-
+	Gyroscope::Sample gyro_sample;
+	Accelerometer::Sample accel_sample;
+	Magnetometer::Sample magn_sample;
+	Altimeter::Sample alti_sample;
+	uint32_t gyro_count = 0;
+	float sdt;
+
+	// Each sample is weighted by the time it covers, duplicate reads are skipped
 	for ( Gyroscope* dev : Sensor::Gyroscopes() ) {
-		dev->Read( &vtmp );
-		total_gyro += Vector4f( vtmp, 1.0f );
+		dev->ReadSample( &gyro_sample );
+		sdt = SampleDelta( dev, gyro_sample.timestamp, gyro_sample.sequence, dt );
+		if ( sdt > 0.0f ) {
+			total_gyro += Vector4f( gyro_sample.value * sdt, sdt );
+			gyro_count++;
+		}
+	}
+	if ( gyro_count > 0 ) {
+		mGyroscope = total_gyro.xyz() / total_gyro.w;
+		mGyroscopeDt = total_gyro.w / (float)gyro_count;
+	} else {
+		mGyroscopeDt = 0.0f;
 	}
-	mGyroscope = total_gyro.xyz() / total_gyro.w;
 
 	// Update RPY only at 1/4 update frequency when in Rate mode
 	mAcroRPYCounter = ( mAcroRPYCounter + 1 ) % 4;
 	if ( mState == Running and ( not gyro_only or mAcroRPYCounter == 0 ) )
 	{
 		for ( Accelerometer* dev : Sensor::Accelerometers() ) {
-			dev->Read( &vtmp );
-			total_accel += Vector4f( vtmp, 1.0f );
+			dev->ReadSample( &accel_sample );
+			sdt = SampleDelta( dev, accel_sample.timestamp, accel_sample.sequence, dt );
+			if ( sdt > 0.0f ) {
+				total_accel += Vector4f( accel_sample.value * sdt, sdt );
+			}
+		}
+		if ( total_accel.w > 0.0f ) {
+			mLastAcceleration = mAcceleration;
+			mAcceleration = total_accel.xyz() / total_accel.w;
 		}
-		mLastAcceleration = mAcceleration;
-		mAcceleration = total_accel.xyz() / total_accel.w;
 
-		if ( mSensorsUpdateSlow % 16 == 0 ) {
-			for ( Magnetometer* dev : Sensor::Magnetometers() ) {
-				dev->Read( &vtmp );
-				total_magn += Vector4f( vtmp, 1.0f );
+		// Self-stamped magnetometers are read in background and can be polled every loop, only new measurements are accounted
+		// Others do a blocking bus read on each call, so they are only read at 1/16 update frequency
+		for ( Magnetometer* dev : Sensor::Magnetometers() ) {
+			if ( not dev->selfStamped() and mSensorsUpdateSlow % 16 != 0 ) {
+				continue;
+			}
+			dev->ReadSample( &magn_sample );
+			sdt = SampleDelta( dev, magn_sample.timestamp, magn_sample.sequence, dt );
+			if ( sdt > 0.0f ) {
+				total_magn += Vector4f( magn_sample.value * sdt, sdt );
 			}
+		}
+		if ( total_magn.w > 0.0f ) {
 			mMagnetometer = total_magn.xyz() / total_magn.w;
 		}
 
 		if ( mSensorsUpdateSlow % 32 == 0 ) {
 			for ( Altimeter* dev : Sensor::Altimeters() ) {
-				dev->Read( &ftmp );
-				if ( dev->type() == Altimeter::Proximity and ftmp > 0.0f ) {
-					total_proxi += Vector2f( ftmp, 1.0f );
+				dev->ReadSample( &alti_sample );
+				// Stale altimeter values are still valid, only their sequence gaps are accounted
+				SampleDelta( dev, alti_sample.timestamp, alti_sample.sequence, dt );
+				if ( dev->type() == Altimeter::Proximity and alti_sample.value > 0.0f ) {
+					total_proxi += Vector2f( alti_sample.value, 1.0f );
 				} else if ( dev->type() == Altimeter::Absolute ) {
-					total_alti += Vector2f( ftmp, 1.0f );
+					total_alti += Vector2f( alti_sample.value, 1.0f );
 				}
 			}
 			for ( GPS* dev : Sensor::GPSes() ) {
@@ -516,12 +654,17 @@ void IMU::UpdateSensors( float dt, bool gyro_only )
 
 void IMU::UpdateAttitude( float dt )
 {
+	// Integrate rates over the time actually covered by the gyroscope samples, none if there is no new one since last loop
+	float gdt = std::max( 0.0f, mGyroscopeDt );
+
 	// Process rates Extended-Kalman-Filter
-	mRates.UpdateInput( 0, mGyroscope.x );
-	mRates.UpdateInput( 1, mGyroscope.y );
-	mRates.UpdateInput( 2, mGyroscope.z );
-	mRates.Process( dt );
-	mRate = mRates.state( 0 );
+	if ( gdt > 0.0f ) {
+		mRates.UpdateInput( 0, mGyroscope.x );
+		mRates.UpdateInput( 1, mGyroscope.y );
+		mRates.UpdateInput( 2, mGyroscope.z );
+		mRates.Process( gdt );
+		mRate = mRates.state( 0 );
+	}
 
 	// Process acceleration Extended-Kalman-Filter
 	mAccelerationSmoother.UpdateInput( 0, mAcceleration.x );
@@ -544,12 +687,12 @@ void IMU::UpdateAttitude( float dt )
 	if ( mMain->stabilizer()->mode() != Stabilizer::Rate and 0 /*TODO*/ ) {
 // 		mAttitude.UpdateInput( 2, magnetometer.heading );
 	} else {
-		mAttitude.UpdateInput( 2, mRPY.z + mRate.z * dt );
+		mAttitude.UpdateInput( 2, mRPY.z + mRate.z * gdt );
 	}
 	// Integrate and update rates values
-	mAttitude.UpdateInput( 3, mRPY.x + mRate.x * dt );
-	mAttitude.UpdateInput( 4, mRPY.y + mRate.y * dt );
-	mAttitude.UpdateInput( 5, mRPY.z + mRate.z * dt );
+	mAttitude.UpdateInput( 3, mRPY.x + mRate.x * gdt );
+	mAttitude.UpdateInput( 4, mRPY.y + mRate.y * gdt );
+	mAttitude.UpdateInput( 5, mRPY.z + mRate.z * gdt );
 
 	// Process Extended-Kalman-Filter
 	mAttitude.Process( dt );
@@ -558,9 +701,9 @@ void IMU::UpdateAttitude( float dt )
 	Vector4f rpy = mAttitude.state( 0 );
 
 	//TEST
-	rpy.x = 0.98f * ( mRPY.x + mRate.x * dt ) + 0.02f * accel_roll_pitch.x;
-	rpy.y = 0.98f * ( mRPY.y + mRate.y * dt ) + 0.02f * accel_roll_pitch.y;
-	rpy.z = mRPY.z + mRate.z * dt;
+	rpy.x = 0.98f * ( mRPY.x + mRate.x * gdt ) + 0.02f * accel_roll_pitch.x;
+	rpy.y = 0.98f * ( mRPY.y + mRate.y * gdt ) + 0.02f * accel_roll_pitch.y;
+	rpy.z = mRPY.z + mRate.z * gdt;
 
 	mdRPY = ( rpy - mRPY ) * dt;
 	mRPY = rpy;
@@ -19,6 +19,7 @@
 #ifndef IMU_H
 #define IMU_H
 
+#include <map>
 #include <Main.h>
 #include <Thread.h>
 #include <Vector.h>
@@ -26,6 +27,13 @@
 
 #define IMU_RPY_SMOOTH_RATIO 0.02f
 
+// Stillness test validating cached gyroscope offsets at boot
+#define IMU_CALIBRATION_CACHE_CHECK_TIME ( 1000 * 300 )
+#define IMU_CALIBRATION_CACHE_MAX_RESIDUAL 0.5f
+#define IMU_CALIBRATION_CACHE_MAX_MOTION 3.0f
+
+class Sensor;
+
 class IMU
 {
 public:
@@ -52,6 +60,7 @@ public:
 	const Vector3f velocity() const;
 	const Vector3f position() const;
 	const float altitude() const;
+	const uint32_t sampleGaps() const;
 
 	void Recalibrate();
 	void RecalibrateAll();
@@ -62,10 +71,18 @@ public:
 protected:
 	bool SensorsThreadRun();
 	void Calibrate( float dt, bool all = false );
+	bool LoadCalibrationCache();
+	bool CalibrationSaveRun();
 	void UpdateSensors( float dt, bool gyro_only = false );
 	void UpdateAttitude( float dt );
 	void UpdateVelocity( float dt );
 	void UpdatePosition( float dt );
+	float SampleDelta( Sensor* dev, uint64_t timestamp, uint32_t sequence, float dt );
+
+	typedef struct {
+		uint64_t timestamp;
+		uint32_t sequence;
+	} SampleState;
 
 	Main* mMain;
 	HookThread<IMU>* mSensorsThread;
@@ -79,6 +96,7 @@ protected:
 	State mState;
 	Vector3f mAcceleration;
 	Vector3f mGyroscope;
+	float mGyroscopeDt;
 	Vector3f mMagnetometer;
 	Vector2f mLattitudeLongitude;
 	float mAltitude;
@@ -93,6 +111,13 @@ protected:
 	// Calibration states
 	uint32_t mCalibrationStep;
 	uint64_t mCalibrationTimer;
+	bool mCalibrationCache;
+	Vector4f mCalibrationResidual;
+	float mCalibrationMotion;
+	// Gyroscope offsets are written to the registers file from their own thread, off the stabilizer loop
+	HookThread<IMU>* mCalibrationSaveThread;
+	std::mutex mCalibrationSaveMutex;
+	std::map< std::string, std::string > mCalibrationSave;
 	Vector4f mRPYAccum;
 	Vector4f mdRPYAccum;
 	Vector3f mGravity;
@@ -107,6 +132,10 @@ protected:
 
 	Vector3f mLastAcceleration;
 	uint32_t mAcroRPYCounter;
+
+	// Last consumed sample of each sensor, used to skip duplicate reads
+	std::map< Sensor*, SampleState > mSamplesStates;
+	uint32_t mSampleGaps;
 };
 
 #endif // IMU_H
@@ -77,7 +77,7 @@ bool HUD::run()
 	}
 	LinkStats linkStats;
 	if ( controller and controller->link() ) {
-		linkStats.qual = controller->link()->RxQuality();
+		linkStats.qual = std::max( 0, controller->link()->RxQuality() );
 		linkStats.level = controller->link()->RxLevel();
 		linkStats.noise = 0;
 		linkStats.channel = ( mShowFrequency ? controller->link()->Frequency() : controller->link()->Channel() );
@@ -423,14 +423,17 @@ bool Raspicam::LiveThreadRun()
 		mHeadersTick = Board::GetTicks();
 		const std::map< uint32_t, uint8_t* > headers = mEncoder->headers();
 		if ( headers.size() > 0 ) {
+			// All the headers go in a single live message
+			std::vector< struct iovec > iov;
 			for ( auto hdr : headers ) {
-				if ( not mDirectMode ) {
-					LiveSend( (char*)hdr.second, hdr.first );
-				}
+				iov.push_back( { hdr.second, hdr.first } );
 				if ( mRecording and not mBetterRecording ) {
 					RecordWrite( (char*)hdr.second, hdr.first );
 				}
 			}
+			if ( not mDirectMode ) {
+				LiveSend( iov.data(), iov.size() );
+			}
 		}
 	}
 
@@ -481,6 +484,18 @@ int Raspicam::LiveSend( char* data, int datalen )
 }
 
 
+int Raspicam::LiveSend( const struct iovec* iov, int iovcnt )
+{
+	int err = mLink->Writev( iov, iovcnt, false, 0 );
+
+	if ( err < 0 ) {
+		gDebug() << "Link->Writev() error : " << strerror(errno) << " (" << errno << ")\n";
+		return -1;
+	}
+	return 0;
+}
+
+
 int Raspicam::RecordWrite( char* data, int datalen, int64_t pts, bool audio )
 {
 	int ret = 0;
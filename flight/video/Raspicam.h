@@ -71,6 +71,7 @@ protected:
 	bool TakePictureThreadRun();
 
 	int LiveSend( char* data, int datalen );
+	int LiveSend( const struct iovec* iov, int iovcnt );
 	int RecordWrite( char* data, int datalen, int64_t pts = 0, bool audio = false );
 
 	Config* mConfig;
@@ -19,13 +19,16 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <stdlib.h>
 #include <signal.h>
 #include <math.h>
 //#include <netinet/in.h>
 //#include <netinet/tcp.h>
 #include <stdio.h>
 #include <iostream>
+#include <algorithm>
 #include "Controller.h"
+#include "Crc32c.h"
 #include "links/RawWifi.h"
 
 
@@ -61,14 +64,28 @@ Controller::Controller( Link* link, bool spectate )
 	, mSensorsInfos( "" )
 	, mConfigFile( "" )
 	, mRecordingsList( "" )
-	, mUpdateUploadValid( false )
+	, mUpdateUploadStatus( -1 )
 	, mConfigUploadValid( false )
 	, mTicks( 0 )
 	, mSwitches{ 0 }
 	, mVideoRecording( false )
 	, mAcceleration( 0.0f )
 	, mLocalBatteryVoltage( 0 )
+	, mTelemetryBytes( 0 )
+	, mTelemetryLegacyBytes( 0 )
 {
+	mTelemetryFrameBytes = 0;
+	mTelemetrySavings = 0;
+	mRTT = 0;
+	mClockOffset = 0;
+	mOffsetIndex = 0;
+	mDownloadStatus = -1;
+	mDownloadSize = 0;
+	mDownloadChunk = 0;
+	mDownloadOffset = 0;
+	mDownloadFile = nullptr;
+	memset( mOffsetRTT, 0xFF, sizeof(mOffsetRTT) );
+	memset( mOffsetSample, 0, sizeof(mOffsetSample) );
 	mMode = Rate;
 	memset( mSwitches, 0, sizeof( mSwitches ) );
 
@@ -243,11 +260,14 @@ bool Controller::run()
 	bool request_ack = false;
 	if ( Thread::GetTick() - mPingTimer >= 100 ) {
 		request_ack = true;
-		uint64_t ticks = Thread::GetTick();
 		mXferMutex.lock();
 		mTxFrame.WriteU16( PING );
-		mTxFrame.WriteU16( (uint16_t)( ticks & 0x0000FFFFL ) );
-		mTxFrame.WriteU16( mPing ); // Report current ping
+		PingPayload* ping = SerializePayload< PingPayload >( &mTxFrame );
+		ping->origin = Thread::GetTickMicros();
+		ping->receive = 0;
+		ping->transmit = 0;
+		ping->reported_rtt = mRTT; // Report current round-trip and clock offset
+		ping->reported_offset = mClockOffset;
 		mXferMutex.unlock();
 
 		if ( not mRxThread->running() ) {
@@ -306,9 +326,11 @@ bool Controller::RxRun()
 		usleep( 500 );
 		return true;
 	}
+	uint64_t receive_ticks = Thread::GetTickMicros();
 	Cmd cmd = (Cmd)0;
+	bool readable = true;
 
-	while ( telemetry.ReadU16( (uint16_t*)&cmd ) > 0 ) {
+	while ( readable and telemetry.ReadU16( (uint16_t*)&cmd ) > 0 ) {
 // 		std::cout << "Received command : " << mCommandsNames[(cmd)] << "\n";
 
 		switch( cmd ) {
@@ -316,19 +338,55 @@ bool Controller::RxRun()
 				break;
 			}
 			case PING : {
-				uint32_t ret = telemetry.ReadU16();
-				uint32_t reported_ping = telemetry.ReadU16();
-				uint32_t curr = (uint32_t)( Thread::GetTick() & 0x0000FFFFL );
-				mPing = curr - ret;
+				const PingPayload* ping = ParsePayload< PingPayload >( &telemetry );
+				if ( not ping ) {
+					break;
+				}
 				if ( mSpectate ) {
-					mPing = reported_ping;
+					// Origin timestamp belongs to the piloting controller, only use what it reported
+					mRTT = ping->reported_rtt;
+					mClockOffset = ping->reported_offset;
+					mPing = mRTT / 1000;
+					mConnectionEstablished = true;
+					break;
+				}
+				// NTP-style exchange : t1 ground transmit, t2 drone receive, t3 drone transmit, t4 ground receive
+				uint64_t t1 = ping->origin;
+				uint64_t t2 = ping->receive;
+				uint64_t t3 = ping->transmit;
+				uint64_t t4 = receive_ticks;
+				if ( t4 < t1 or t3 < t2 or t3 - t2 > t4 - t1 ) {
+					// Not an answer to one of our pings, or inconsistent drone timestamps
+					break;
+				}
+				uint64_t rtt = ( t4 - t1 ) - ( t3 - t2 );
+				mOffsetRTT[mOffsetIndex] = (uint32_t)std::min( rtt, (uint64_t)0xFFFFFFFF );
+				// Same as ( ( t2 - t1 ) + ( t3 - t4 ) ) / 2, without overflowing on distant clocks
+				mOffsetSample[mOffsetIndex] = (int64_t)( t2 - t1 - rtt / 2 );
+				mOffsetIndex = ( mOffsetIndex + 1 ) % PING_OFFSET_WINDOW;
+				// Lowest round-trip exchange has the least queuing asymmetry, so the most accurate offset
+				uint32_t best = 0;
+				for ( uint32_t i = 1; i < PING_OFFSET_WINDOW; i++ ) {
+					if ( mOffsetRTT[i] < mOffsetRTT[best] ) {
+						best = i;
+					}
 				}
+				mClockOffset = mOffsetSample[best];
+				mRTT = mOffsetRTT[( mOffsetIndex + PING_OFFSET_WINDOW - 1 ) % PING_OFFSET_WINDOW];
+				mPing = mRTT / 1000;
+				mRTTHistogram.Add( mRTT );
+				mUplinkHistogram.Add( (uint32_t)std::max( (int64_t)0, (int64_t)( t2 - t1 - mClockOffset ) ) );
+				mDownlinkHistogram.Add( (uint32_t)std::max( (int64_t)0, (int64_t)( t4 - t3 + mClockOffset ) ) );
+				mRTTPercentiles = { mRTTHistogram.Percentile( 0.5f ), mRTTHistogram.Percentile( 0.95f ), mRTTHistogram.Percentile( 0.99f ) };
+				mUplinkPercentiles = { mUplinkHistogram.Percentile( 0.5f ), mUplinkHistogram.Percentile( 0.95f ), mUplinkHistogram.Percentile( 0.99f ) };
+				mDownlinkPercentiles = { mDownlinkHistogram.Percentile( 0.5f ), mDownlinkHistogram.Percentile( 0.95f ), mDownlinkHistogram.Percentile( 0.99f ) };
 				mConnectionEstablished = true;
 				break;
 			}
 			case STATUS : {
-				uint32_t status = 0;
-				if ( telemetry.ReadU32( &status ) == sizeof(uint32_t) ) {
+				const StatusPayload* payload = ParsePayload< StatusPayload >( &telemetry );
+				if ( payload ) {
+					uint32_t status = payload->status;
 					mArmed = status & STATUS_ARMED;
 					mCalibrated = status & STATUS_CALIBRATED;
 					mCalibrating = status & STATUS_CALIBRATING;
@@ -350,6 +408,123 @@ bool Controller::RxRun()
 				mDroneRxLevel = data.rx_level;
 				break;
 			}
+			case TELEMETRY_FRAME : {
+				const TelemetryFrameHeaderPayload* header = ParsePayload< TelemetryFrameHeaderPayload >( &telemetry );
+				if ( not header or header->version != TELEMETRY_FRAME_VERSION ) {
+					std::cout << "Unsupported telemetry frame\n" << std::flush;
+					// Layout is unknown, nothing else can be read from this packet
+					mTelemetryFrameBytes = 0;
+					readable = false;
+					break;
+				}
+				uint8_t sections = header->sections;
+				uint8_t status = header->status;
+				// Frame size, compared to the size of the same values sent as tag + 32 bits value pairs
+				uint32_t size = sizeof(uint16_t) + sizeof(TelemetryFrameHeaderPayload);
+				uint32_t legacy_size = 6 + 14 + 6 + 6;
+				mArmed = status & STATUS_ARMED;
+				mCalibrated = status & STATUS_CALIBRATED;
+				mCalibrating = status & STATUS_CALIBRATING;
+				mNightMode = status & STATUS_NIGHTMODE;
+				mCameraMissing = status & STATUS_CAMERA_MISSING;
+
+				if ( mSpectate ) {
+					mThrust = Dequantize( header->thrust, TELEMETRY_SCALE_THRUST );
+				}
+				mRPY.x = Dequantize( header->roll, TELEMETRY_SCALE_ANGLE );
+				mRPY.y = Dequantize( header->pitch, TELEMETRY_SCALE_ANGLE );
+				mRPY.z = Dequantize( header->yaw, TELEMETRY_SCALE_ANGLE );
+				mAcceleration = Dequantize( header->acceleration, TELEMETRY_SCALE_ACCELERATION );
+				float altitude = Dequantize( header->altitude, TELEMETRY_SCALE_ALTITUDE );
+				vec4 rpy;
+				rpy.x = mRPY.x;
+				rpy.y = mRPY.y;
+				rpy.z = mRPY.z;
+				rpy.w = (double)( Thread::GetTick() - mTickBase ) / 1000.0;
+				mHistoryMutex.lock();
+				mRPYHistory.emplace_back( rpy );
+				if ( mRPYHistory.size() > 256 ) {
+					mRPYHistory.pop_front();
+				}
+				mAltitude = altitude;
+				mAltitudeHistory.emplace_back( mAltitude );
+				if ( mAltitudeHistory.size() > 256 ) {
+					mAltitudeHistory.pop_front();
+				}
+				mHistoryMutex.unlock();
+
+				if ( sections & TELEMETRY_SECTION_POWER ) {
+					mBatteryVoltage = (float)telemetry.ReadU16() / TELEMETRY_SCALE_VOLTAGE;
+					mTotalCurrent = telemetry.ReadU16();
+					mCurrentDraw = (float)telemetry.ReadU16() / TELEMETRY_SCALE_CURRENT;
+					mBatteryLevel = (float)telemetry.ReadU8() / 100.0f;
+					size += 7;
+					legacy_size += 4 * 6;
+				}
+				if ( sections & TELEMETRY_SECTION_SYSTEM ) {
+					mCPULoad = telemetry.ReadU8();
+					mCPUTemp = telemetry.ReadU8();
+					mDroneRxQuality = telemetry.ReadU8();
+					mDroneRxLevel = (int8_t)telemetry.ReadU8();
+					size += 4;
+					legacy_size += 4 * 6;
+				}
+				if ( sections & TELEMETRY_SECTION_STABILIZER ) {
+					mStabilizerFrequency = telemetry.ReadU16();
+					size += 2;
+					legacy_size += 6;
+				}
+				if ( sections & TELEMETRY_SECTION_MOTORS ) {
+					uint32_t count = telemetry.ReadU8();
+					mMotorsSpeed.clear();
+					for ( uint32_t i = 0; i < count; i++ ) {
+						mMotorsSpeed.push_back( Dequantize( telemetry.ReadU16(), TELEMETRY_SCALE_MOTOR ) );
+					}
+					size += 1 + count * 2;
+					legacy_size += 6 + count * 4;
+				}
+				if ( sections & TELEMETRY_SECTION_SENSORS ) {
+					vec4 rates;
+					rates.x = Dequantize( telemetry.ReadU16(), TELEMETRY_SCALE_RATE );
+					rates.y = Dequantize( telemetry.ReadU16(), TELEMETRY_SCALE_RATE );
+					rates.z = Dequantize( telemetry.ReadU16(), TELEMETRY_SCALE_RATE );
+					rates.w = (double)( Thread::GetTick() - mTickBase ) / 1000.0;
+					mHistoryMutex.lock();
+					mRatesHistory.emplace_back( rates );
+					if ( mRatesHistory.size() > 256 ) {
+						mRatesHistory.pop_front();
+					}
+					mHistoryMutex.unlock();
+					// Accelerometer and magnetometer are not displayed yet
+					for ( uint32_t i = 0; i < 6; i++ ) {
+						(void)telemetry.ReadU16();
+					}
+					size += 18;
+					legacy_size += 3 * 14;
+				}
+				if ( sections & TELEMETRY_SECTION_QOS ) {
+					mQueueDelays.clear();
+					for ( uint32_t i = 0; i < 4; i++ ) {
+						mQueueDelays.push_back( (float)( telemetry.ReadU16() * TELEMETRY_QUEUE_DELAY_UNIT ) / 1000.0f );
+					}
+					size += 8;
+					legacy_size += 4 * 6;
+				}
+				if ( sections & TELEMETRY_SECTION_LATENCY ) {
+					mDroneLatency.clear();
+					for ( uint32_t i = 0; i < 4; i++ ) {
+						mDroneLatency.push_back( telemetry.ReadU16() * TELEMETRY_LATENCY_UNIT );
+					}
+					size += 8;
+					legacy_size += 4 * 6;
+				}
+
+				mTelemetryFrameBytes = size;
+				mTelemetryLegacyBytes += legacy_size;
+				mTelemetryBytes += size;
+				mTelemetrySavings = 100 - (uint32_t)( mTelemetryBytes * 100 / mTelemetryLegacyBytes );
+				break;
+			}
 			case DEBUG_OUTPUT : {
 				mDebugMutex.lock();
 				std::string str = telemetry.ReadString();
@@ -393,19 +568,25 @@ bool Controller::RxRun()
 			}
 
 			case GET_BOARD_INFOS : {
-				mBoardInfos = telemetry.ReadString();
+				std::string content;
+				if ( ReceiveText( cmd, &telemetry, &content ) > 0 ) {
+					mBoardInfos = content;
+				}
 				break;
 			}
 			case GET_SENSORS_INFOS : {
-				mSensorsInfos = telemetry.ReadString();
+				std::string content;
+				if ( ReceiveText( cmd, &telemetry, &content ) > 0 ) {
+					mSensorsInfos = content;
+				}
 				break;
 			}
 			case GET_CONFIG_FILE : {
-				uint32_t crc = telemetry.ReadU32();
-				std::string content = telemetry.ReadString();
-				if ( crc32( (uint8_t*)content.c_str(), content.length() ) == crc ) {
+				std::string content;
+				int ret = ReceiveText( cmd, &telemetry, &content );
+				if ( ret > 0 ) {
 					mConfigFile = content;
-				} else {
+				} else if ( ret < 0 ) {
 					std::cout << "Received broken config flie, retrying...\n" << std::flush;
 					mConfigFile = "";
 				}
@@ -416,10 +597,24 @@ bool Controller::RxRun()
 				mConfigUploadValid = ( telemetry.ReadU32() == 0 );
 				break;
 			}
+			case UPDATE_UPLOAD_INIT : {
+				mUpdateUploadStatus = telemetry.ReadU32();
+				break;
+			}
 			case UPDATE_UPLOAD_DATA : {
-				bool ok = ( telemetry.ReadU32() == 1 );
-				std::cout << "UPDATE_UPLOAD_DATA : " << ok << "\n" << std::flush;
-				mUpdateUploadValid = ok;
+				uint32_t status = telemetry.ReadU32();
+				uint32_t offset = telemetry.ReadU32();
+				mUpdateUploadMutex.lock();
+				auto chunk = mUpdateUploadPending.find( offset );
+				if ( chunk != mUpdateUploadPending.end() ) {
+					if ( status == 1 ) {
+						mUpdateUploadPending.erase( chunk );
+					} else {
+						// Rejected, send it again right away
+						chunk->second = 0;
+					}
+				}
+				mUpdateUploadMutex.unlock();
 				break;
 			}
 
@@ -474,97 +669,156 @@ bool Controller::RxRun()
 			case MOTORS_SPEED: {
 				uint32_t size = telemetry.ReadU32();
 				mMotorsSpeed.clear();
-				for ( uint32_t i = 0; i < size; i++ ) {
-// 					mMotorsSpeed.push_back( telemetry.ReadFloat() );
-					(void)telemetry.ReadFloat();
+				float speed = 0.0f;
+				// Count comes from the packet, stop at its end
+				for ( uint32_t i = 0; i < size and telemetry.ReadFloat( &speed ) > 0; i++ ) {
+// 					mMotorsSpeed.push_back( speed );
 				}
 				break;
 			}
 
 			case ROLL_PID_FACTORS : {
-				mRollPID.x = telemetry.ReadFloat();
-				mRollPID.y = telemetry.ReadFloat();
-				mRollPID.z = telemetry.ReadFloat();
+				const Vector3Payload* pid = ParsePayload< Vector3Payload >( &telemetry );
+				if ( not pid ) {
+					break;
+				}
+				mRollPID.x = pid->x;
+				mRollPID.y = pid->y;
+				mRollPID.z = pid->z;
 				mPIDsLoaded = true;
 				break;
 			}
 			case PITCH_PID_FACTORS : {
-				mPitchPID.x = telemetry.ReadFloat();
-				mPitchPID.y = telemetry.ReadFloat();
-				mPitchPID.z = telemetry.ReadFloat();
+				const Vector3Payload* pid = ParsePayload< Vector3Payload >( &telemetry );
+				if ( not pid ) {
+					break;
+				}
+				mPitchPID.x = pid->x;
+				mPitchPID.y = pid->y;
+				mPitchPID.z = pid->z;
 				mPIDsLoaded = true;
 				break;
 			}
 			case YAW_PID_FACTORS : {
-				mYawPID.x = telemetry.ReadFloat();
-				mYawPID.y = telemetry.ReadFloat();
-				mYawPID.z = telemetry.ReadFloat();
+				const Vector3Payload* pid = ParsePayload< Vector3Payload >( &telemetry );
+				if ( not pid ) {
+					break;
+				}
+				mYawPID.x = pid->x;
+				mYawPID.y = pid->y;
+				mYawPID.z = pid->z;
 				mPIDsLoaded = true;
 				break;
 			}
 			case OUTER_PID_FACTORS : {
-				mOuterPID.x = telemetry.ReadFloat();
-				mOuterPID.y = telemetry.ReadFloat();
-				mOuterPID.z = telemetry.ReadFloat();
+				const Vector3Payload* pid = ParsePayload< Vector3Payload >( &telemetry );
+				if ( not pid ) {
+					break;
+				}
+				mOuterPID.x = pid->x;
+				mOuterPID.y = pid->y;
+				mOuterPID.z = pid->z;
 				mPIDsLoaded = true;
 				break;
 			}
 			case HORIZON_OFFSET : {
-				mHorizonOffset.x = telemetry.ReadFloat();
-				mHorizonOffset.y = telemetry.ReadFloat();
+				const Vector2Payload* offset = ParsePayload< Vector2Payload >( &telemetry );
+				if ( offset ) {
+					mHorizonOffset.x = offset->x;
+					mHorizonOffset.y = offset->y;
+				}
 				break;
 			}
 			case SET_ROLL_PID_P : {
-				mRollPID.x = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mRollPID.x = value->value;
+				}
 				break;
 			}
 			case SET_ROLL_PID_I : {
-				mRollPID.y = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mRollPID.y = value->value;
+				}
 				break;
 			}
 			case SET_ROLL_PID_D : {
-				mRollPID.z = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mRollPID.z = value->value;
+				}
 				break;
 			}
 			case SET_PITCH_PID_P : {
-				mPitchPID.x = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mPitchPID.x = value->value;
+				}
 				break;
 			}
 			case SET_PITCH_PID_I : {
-				mPitchPID.y = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mPitchPID.y = value->value;
+				}
 				break;
 			}
 			case SET_PITCH_PID_D : {
-				mPitchPID.z = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mPitchPID.z = value->value;
+				}
 				break;
 			}
 			case SET_YAW_PID_P : {
-				mYawPID.x = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mYawPID.x = value->value;
+				}
 				break;
 			}
 			case SET_YAW_PID_I : {
-				mYawPID.y = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mYawPID.y = value->value;
+				}
 				break;
 			}
 			case SET_YAW_PID_D : {
-				mYawPID.z = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mYawPID.z = value->value;
+				}
 				break;
 			}
 			case SET_OUTER_PID_P : {
-				mOuterPID.x = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mOuterPID.x = value->value;
+				}
 				break;
 			}
 			case SET_OUTER_PID_I : {
-				mOuterPID.y = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mOuterPID.y = value->value;
+				}
 				break;
 			}
 			case SET_OUTER_PID_D : {
-				mOuterPID.z = telemetry.ReadFloat();
+				const ValuePayload* value = ParsePayload< ValuePayload >( &telemetry );
+				if ( value ) {
+					mOuterPID.z = value->value;
+				}
 				break;
 			}
 			case SET_HORIZON_OFFSET : {
-				mHorizonOffset.x = telemetry.ReadFloat();
-				mHorizonOffset.y = telemetry.ReadFloat();
+				const Vector2Payload* offset = ParsePayload< Vector2Payload >( &telemetry );
+				if ( offset ) {
+					mHorizonOffset.x = offset->x;
+					mHorizonOffset.y = offset->y;
+				}
 				break;
 			}
 
@@ -647,17 +901,53 @@ bool Controller::RxRun()
 				break;
 			}
 			case GET_RECORDINGS_LIST : {
-				uint32_t crc = telemetry.ReadU32();
-				std::string content = telemetry.ReadString();
-				if ( crc32( (uint8_t*)content.c_str(), content.length() ) == crc ) {
+				std::string content;
+				int ret = ReceiveText( cmd, &telemetry, &content );
+				if ( ret > 0 ) {
 					mRecordingsList = content;
-				} else {
+				} else if ( ret < 0 ) {
 					std::cout << "Received broken recordings list, retrying...\n";
 					mRecordingsList = "broken";
 				}
 				break;
 			}
 
+			case RECORD_DOWNLOAD_INIT : {
+				uint32_t status = telemetry.ReadU32();
+				mDownloadSize = telemetry.ReadU32();
+				mDownloadChunk = std::max( 1U, telemetry.ReadU32() );
+				mDownloadStatus = status;
+				break;
+			}
+			case RECORD_DOWNLOAD_DATA : {
+				uint32_t offset = telemetry.ReadU32();
+				uint32_t size = telemetry.ReadU32();
+				uint32_t crc = telemetry.ReadU32();
+				const uint8_t* data = telemetry.Peek( size );
+				if ( not data ) {
+					break;
+				}
+				mDownloadMutex.lock();
+				auto request = mDownloadRequests.find( offset );
+				if ( request != mDownloadRequests.end() and mDownloadFile ) {
+					if ( crc32c( data, size ) != crc ) {
+						// Broken chunk, ask for it again right away
+						request->second = 0;
+					} else {
+						mDownloadRequests.erase( request );
+						mDownloadPending[offset] = std::vector< uint8_t >( data, data + size );
+						while ( mDownloadPending.size() > 0 and mDownloadPending.begin()->first == mDownloadOffset ) {
+							std::vector< uint8_t >& chunk = mDownloadPending.begin()->second;
+							fwrite( chunk.data(), 1, chunk.size(), mDownloadFile );
+							mDownloadOffset += chunk.size();
+							mDownloadPending.erase( mDownloadPending.begin() );
+						}
+					}
+				}
+				mDownloadMutex.unlock();
+				break;
+			}
+
 			case GET_USERNAME : {
 				mUsername = telemetry.ReadString();
 				break;
@@ -670,7 +960,12 @@ bool Controller::RxRun()
 			}
 
 			default :
-				std::cout << "WARNING : Received unknown packet (" << (uint32_t)cmd << ") !\n" << std::flush;
+				if ( PayloadSize( cmd ) > 0 ) {
+					// Known fixed-size payload which is not used here, skip it
+					telemetry.Peek( PayloadSize( cmd ) );
+				} else {
+					std::cout << "WARNING : Received unknown packet (" << (uint32_t)cmd << ") !\n" << std::flush;
+				}
 				break;
 		}
 	}
@@ -801,6 +1096,19 @@ std::string Controller::getBoardInfos()
 }
 
 
+uint32_t Controller::firmwareCRC()
+{
+	// Infos are fetched again, firmware may have changed since last time
+	mBoardInfos = "";
+	std::string infos = getBoardInfos();
+	size_t pos = infos.find( "Firmware CRC:" );
+	if ( pos == std::string::npos ) {
+		return 0;
+	}
+	return strtoul( infos.c_str() + pos + strlen( "Firmware CRC:" ), nullptr, 16 );
+}
+
+
 std::string Controller::getSensorsInfos()
 {
 	// Wait for data to be filled by RX Thread (RxRun())
@@ -836,17 +1144,23 @@ std::string Controller::getConfigFile()
 void Controller::setConfigFile( const std::string& content )
 {
 	std::cout << "setConfigFile...\n" << std::flush;
-	Packet packet( SET_CONFIG_FILE );
-	packet.WriteU32( crc32( (uint8_t*)content.c_str(), content.length() ) );
-	packet.WriteString( content );
+	uint32_t crc = crc32( (uint8_t*)content.c_str(), content.length() );
 
 	mConfigUploadValid = false;
 	while ( not mConfigUploadValid ) {
 		mXferMutex.lock();
-// 		mTxFrame.WriteU16( SET_CONFIG_FILE );
-// 		mTxFrame.WriteString( content );
-		std::cout << "Sending " << packet.data().size()*4 << " bytes\n";
-		mLink->Write( &packet );
+		std::cout << "Sending " << content.length() << " bytes\n";
+		uint32_t offset = 0;
+		do {
+			uint32_t len = std::min( (uint32_t)content.length() - offset, (uint32_t)TEXT_PART_SIZE );
+			Packet packet( SET_CONFIG_FILE );
+			packet.WriteU32( crc );
+			packet.WriteU32( content.length() );
+			packet.WriteU32( offset );
+			packet.Write( (const uint8_t*)content.c_str() + offset, len );
+			mLink->Write( &packet );
+			offset += len;
+		} while ( offset < content.length() );
 		mXferMutex.unlock();
 		usleep( 1000 * 250 );
 	};
@@ -855,47 +1169,82 @@ void Controller::setConfigFile( const std::string& content )
 }
 
 
-void Controller::UploadUpdateInit()
+bool Controller::UploadUpdateInit( uint32_t size )
 {
 	Packet init( UPDATE_UPLOAD_INIT );
-	for ( uint32_t retries = 0; retries < 8; retries++ ) {
+	init.WriteU32( size );
+
+	mUpdateUploadStatus = -1;
+	for ( uint32_t retries = 0; retries < 8 and mUpdateUploadStatus < 0; retries++ ) {
 		mXferMutex.lock();
 		mLink->Write( &init );
 		mXferMutex.unlock();
-		usleep( 1000 * 50 );
+		usleep( 1000 * 250 );
 	}
+
+	return ( mUpdateUploadStatus == 1 );
 }
 
 
-void Controller::UploadUpdateData( const uint8_t* buf, uint32_t offset, uint32_t size )
+bool Controller::UploadUpdateData( const uint8_t* buf, uint32_t size, std::function< void( uint32_t, uint32_t ) > progress )
 {
-
-	Packet packet( UPDATE_UPLOAD_DATA );
-	packet.WriteU32( crc32( buf, size ) );
-	packet.WriteU32( offset );
-	packet.WriteU32( offset );
-	packet.WriteU32( size );
-	packet.WriteU32( size );
-	packet.Write( buf, size );
-
-
-	mUpdateUploadValid = false;
-	mXferMutex.lock();
-	int retries = 1;
-	mLink->retriesCount();
-	mLink->setRetriesCount( 1 );
-	do {
-		mLink->Write( &packet );
-		usleep( 1000 * 50 );
-		if ( not mUpdateUploadValid ) {
-			std::cout << "Broken data received, retrying...\n" << std::flush;
-			usleep( 1000 * 10 );
+	uint32_t next = 0;
+	uint32_t done = 0;
+	uint64_t progress_tick = Thread::GetTick();
+
+	mUpdateUploadMutex.lock();
+	mUpdateUploadPending.clear();
+	mUpdateUploadMutex.unlock();
+
+	while ( done < size ) {
+		uint64_t now = Thread::GetTick();
+		std::vector< uint32_t > chunks;
+
+		// Send again only the chunks not acknowledged in time, then fill the window with new ones
+		mUpdateUploadMutex.lock();
+		for ( auto& chunk : mUpdateUploadPending ) {
+			if ( now - chunk.second >= UPDATE_UPLOAD_TIMEOUT ) {
+				chunk.second = now;
+				chunks.push_back( chunk.first );
+			}
+		}
+		while ( next < size and mUpdateUploadPending.size() < UPDATE_UPLOAD_WINDOW ) {
+			mUpdateUploadPending[next] = now;
+			chunks.push_back( next );
+			next += UPDATE_UPLOAD_CHUNK;
+		}
+		uint32_t acked = next - std::min( next, (uint32_t)mUpdateUploadPending.size() * UPDATE_UPLOAD_CHUNK );
+		mUpdateUploadMutex.unlock();
+
+		for ( uint32_t offset : chunks ) {
+			uint32_t sz = std::min( (uint32_t)UPDATE_UPLOAD_CHUNK, size - offset );
+			uint32_t header[2] = { htonl( offset ), htonl( sz ) };
+			Packet packet( UPDATE_UPLOAD_DATA );
+			packet.WriteU32( crc32c( buf + offset, sz, crc32c( (uint8_t*)header, sizeof(header) ) ) );
+			packet.WriteU32( offset );
+			packet.WriteU32( sz );
+			packet.Write( buf + offset, sz );
+			mXferMutex.lock();
+			mLink->Write( &packet );
+			mXferMutex.unlock();
 		}
-	} while ( not mUpdateUploadValid );
 
-	mLink->setRetriesCount( retries );
-	mXferMutex.unlock();
+		if ( acked != done ) {
+			done = std::min( acked, size );
+			progress_tick = now;
+			if ( progress ) {
+				progress( done, size );
+			}
+		} else if ( now - progress_tick > 10000 ) {
+			std::cout << "Firmware upload stalled at " << done << " bytes\n";
+			return false;
+		}
+		if ( chunks.size() == 0 ) {
+			usleep( 1000 * 2 );
+		}
+	}
 
+	return true;
 }
 
 
@@ -1206,6 +1555,111 @@ std::vector< std::string > Controller::recordingsList()
 }
 
 
+bool Controller::DownloadRecording( const std::string& filename, const std::string& destination, std::function< void( uint32_t, uint32_t ) > progress )
+{
+	mDownloadStatus = -1;
+	for ( uint32_t retry = 0; mDownloadStatus < 0 and retry < 16; retry++ ) {
+		mXferMutex.lock();
+		mTxFrame.WriteU16( RECORD_DOWNLOAD_INIT );
+		mTxFrame.WriteString( filename );
+		mXferMutex.unlock();
+		usleep( 1000 * 250 );
+	}
+	if ( mDownloadStatus != 0 ) {
+		std::cout << "Recording \"" << filename << "\" is not available\n";
+		return false;
+	}
+
+	// Resume right after what a previous attempt fully received
+	std::string part = destination + ".part";
+	FILE* fp = fopen( part.c_str(), "ab" );
+	if ( fp ) {
+		fseek( fp, 0, SEEK_END );
+		if ( (uint64_t)ftell( fp ) > mDownloadSize ) {
+			fclose( fp );
+			fp = fopen( part.c_str(), "wb" );
+		}
+	}
+	if ( not fp ) {
+		std::cout << "Cannot open \"" << part << "\"\n";
+		return false;
+	}
+
+	mDownloadMutex.lock();
+	mDownloadFile = fp;
+	mDownloadOffset = ftell( fp );
+	mDownloadRequests.clear();
+	mDownloadPending.clear();
+	uint32_t next = mDownloadOffset;
+	uint32_t done = mDownloadOffset;
+	mDownloadMutex.unlock();
+	if ( done > 0 ) {
+		std::cout << "Resuming download of \"" << filename << "\" at " << done << " bytes\n";
+	}
+
+	uint64_t progress_tick = Thread::GetTick();
+	bool ok = true;
+	while ( done < mDownloadSize ) {
+		uint64_t now = Thread::GetTick();
+		std::vector< uint32_t > requests;
+
+		mDownloadMutex.lock();
+		for ( auto& request : mDownloadRequests ) {
+			if ( now - request.second >= RECORD_DOWNLOAD_TIMEOUT ) {
+				request.second = now;
+				requests.push_back( request.first );
+			}
+		}
+		while ( next < mDownloadSize and mDownloadRequests.size() + mDownloadPending.size() < RECORD_DOWNLOAD_WINDOW ) {
+			mDownloadRequests[next] = now;
+			requests.push_back( next );
+			next += mDownloadChunk;
+		}
+		uint32_t offset = mDownloadOffset;
+		mDownloadMutex.unlock();
+
+		if ( requests.size() > 0 ) {
+			mXferMutex.lock();
+			for ( uint32_t request : requests ) {
+				mTxFrame.WriteU16( RECORD_DOWNLOAD_DATA );
+				mTxFrame.WriteU32( request );
+			}
+			mXferMutex.unlock();
+		}
+
+		if ( offset != done ) {
+			done = offset;
+			progress_tick = now;
+			if ( progress ) {
+				progress( done, mDownloadSize );
+			}
+		} else if ( now - progress_tick > 10000 or not mLink->isConnected() ) {
+			std::cout << "Download of \"" << filename << "\" stalled at " << done << " bytes\n";
+			ok = false;
+			break;
+		}
+		usleep( 1000 * 2 );
+	}
+
+	mDownloadMutex.lock();
+	mDownloadFile = nullptr;
+	mDownloadRequests.clear();
+	mDownloadPending.clear();
+	mDownloadMutex.unlock();
+	fclose( fp );
+
+	mXferMutex.lock();
+	mTxFrame.WriteU16( RECORD_DOWNLOAD_PROCESS );
+	mXferMutex.unlock();
+
+	if ( ok ) {
+		remove( destination.c_str() );
+		ok = ( rename( part.c_str(), destination.c_str() ) == 0 );
+	}
+	return ok;
+}
+
+
 float Controller::acceleration() const
 {
 	return mAcceleration;
@@ -1254,21 +1708,39 @@ float Controller::localBatteryVoltage() const
 }
 
 
-uint32_t Controller::crc32( const uint8_t* buf, uint32_t len )
+int Controller::ReceiveText( uint16_t cmd, Packet* packet, std::string* text )
 {
-	uint32_t k = 0;
-	uint32_t crc = 0;
+	uint32_t crc = packet->ReadU32();
+	uint32_t length = packet->ReadU32();
+	uint32_t offset = packet->ReadU32();
+	std::string& parts = mTextParts[cmd];
 
-	crc = ~crc;
+	if ( offset == 0 ) {
+		parts = "";
+	}
+	std::string part( std::min( length - std::min( offset, length ), (uint32_t)TEXT_PART_SIZE ), '\0' );
+	if ( packet->Read( (uint8_t*)&part[0], part.length() ) != (int32_t)part.length() or offset != parts.length() ) {
+		// A part has been lost, wait for the next request to send the whole text again
+		parts = "";
+		return 0;
+	}
+	parts += part;
+	if ( parts.length() < length ) {
+		return 0;
+	}
 
-	while ( len-- ) {
-		crc ^= *buf++;
-		for ( k = 0; k < 8; k++ ) {
-			crc = ( crc & 1 ) ? ( (crc >> 1) ^ 0x82f63b78 ) : ( crc >> 1 );
-		}
+	*text = parts;
+	parts = "";
+	if ( crc32( (uint8_t*)text->c_str(), text->length() ) != crc ) {
+		return -1;
 	}
+	return 1;
+}
+
 
-	return ~crc;
+uint32_t Controller::crc32( const uint8_t* buf, uint32_t len )
+{
+	return crc32c( buf, len );
 }
 
 void Controller::MotorTest(uint32_t id)
@@ -22,10 +22,13 @@
 #include <unistd.h>
 #include <mutex>
 #include <list>
+#include <map>
+#include <functional>
 
 #include "links/Link.h"
 #include "Thread.h"
 #include "ControllerBase.h"
+#include "LatencyHistogram.h"
 
 #define DECL_RO_VAR( type, n1, n2 ) \
 	public: const type& n2() const { return m##n1; } \
@@ -66,14 +69,18 @@ public:
 	void ResetBattery();
 	void setFullTelemetry( bool fullt );
 	std::string getBoardInfos();
+	uint32_t firmwareCRC(); // CRC32C of the firmware running on the drone, 0 if unknown
 	std::string getSensorsInfos();
 	std::string debugOutput();
 	std::vector< std::string > recordingsList();
+	// Downloads a recording into 'destination', resuming what a previous attempt left in 'destination'.part
+	bool DownloadRecording( const std::string& filename, const std::string& destination, std::function< void( uint32_t done, uint32_t total ) > progress = nullptr );
 
 	std::string getConfigFile();
 	void setConfigFile( const std::string& content );
-	void UploadUpdateInit();
-	void UploadUpdateData( const uint8_t* buf, uint32_t offset, uint32_t size );
+	bool UploadUpdateInit( uint32_t size );
+	// Sends the whole firmware, returns false if the drone stops acknowledging chunks
+	bool UploadUpdateData( const uint8_t* buf, uint32_t size, std::function< void( uint32_t done, uint32_t total ) > progress = nullptr );
 	void UploadUpdateProcess( const uint8_t* buf, uint32_t size );
 	void EnableTunDevice();
 	void DisableTunDevice();
@@ -121,6 +128,15 @@ public:
 	DECL_RW_VAR( bool, NightMode, nightMode );
 	DECL_RO_VAR( uint32_t, StabilizerFrequency, stabilizerFrequency );
 	DECL_RO_VAR( std::vector<float>, MotorsSpeed, motorsSpeed );
+	DECL_RO_VAR( uint32_t, TelemetryFrameBytes, telemetryFrameBytes );
+	DECL_RO_VAR( uint32_t, TelemetrySavings, telemetrySavings ); // Percentage of bandwidth saved by compact telemetry frames
+	DECL_RO_VAR( std::vector<float>, QueueDelays, queueDelays ); // Drone transmit queue delays (ms) of control, telemetry, bulk and debug traffic
+	DECL_RO_VAR( uint32_t, RTT, rtt ); // Last round-trip time (us), without the drone processing time
+	DECL_RO_VAR( int64_t, ClockOffset, clockOffset ); // Drone clock minus ground clock (us)
+	DECL_RO_VAR( std::vector<uint32_t>, RTTPercentiles, rttPercentiles ); // p50, p95, p99 (us)
+	DECL_RO_VAR( std::vector<uint32_t>, UplinkPercentiles, uplinkPercentiles ); // Ground to drone one-way p50, p95, p99 (us)
+	DECL_RO_VAR( std::vector<uint32_t>, DownlinkPercentiles, downlinkPercentiles ); // Drone to ground one-way p50, p95, p99 (us)
+	DECL_RO_VAR( std::vector<uint32_t>, DroneLatency, droneLatency ); // Round-trip p50, p99 and uplink p50, p99 seen by the drone (us)
 
 	DECL_RO_VAR( std::string, Username, username );
 
@@ -154,6 +170,8 @@ protected:
 	virtual bool run();
 	bool RxRun();
 	uint32_t crc32( const uint8_t* buf, uint32_t len );
+	// Gathers a text sent in parts, returns 1 once complete, -1 if corrupted, 0 while parts are missing
+	int ReceiveText( uint16_t cmd, Packet* packet, std::string* text );
 
 	bool mSpectate;
 	Packet mTxFrame;
@@ -174,7 +192,10 @@ protected:
 	std::string mSensorsInfos;
 	std::string mConfigFile;
 	std::string mRecordingsList;
-	bool mUpdateUploadValid;
+	std::map< uint16_t, std::string > mTextParts; // Texts being received, by command
+	int32_t mUpdateUploadStatus; // -1 until UPDATE_UPLOAD_INIT is answered
+	std::mutex mUpdateUploadMutex;
+	std::map< uint32_t, uint64_t > mUpdateUploadPending; // Offset of chunks not acknowledged yet, and tick they were last sent
 	bool mConfigUploadValid;
 
 	uint32_t mTicks;
@@ -190,8 +211,28 @@ protected:
 	std::mutex mHistoryMutex;
 
 	float mLocalBatteryVoltage;
+	uint64_t mTelemetryBytes;
+	uint64_t mTelemetryLegacyBytes;
 	std::string mDebug;
 	std::mutex mDebugMutex;
+
+	std::mutex mDownloadMutex;
+	int32_t mDownloadStatus; // -1 until RECORD_DOWNLOAD_INIT is answered
+	uint32_t mDownloadSize;
+	uint32_t mDownloadChunk;
+	uint32_t mDownloadOffset; // Bytes contiguously written to mDownloadFile
+	FILE* mDownloadFile;
+	std::map< uint32_t, uint64_t > mDownloadRequests; // Offset of chunks requested, and tick of the last request
+	std::map< uint32_t, std::vector< uint8_t > > mDownloadPending; // Chunks received out of order
+
+	// Clock filter : offset of the exchange with the lowest round-trip among the last PING_OFFSET_WINDOW ones
+	static const uint32_t PING_OFFSET_WINDOW = 8;
+	uint32_t mOffsetRTT[PING_OFFSET_WINDOW];
+	int64_t mOffsetSample[PING_OFFSET_WINDOW];
+	uint32_t mOffsetIndex;
+	LatencyHistogram mRTTHistogram;
+	LatencyHistogram mUplinkHistogram;
+	LatencyHistogram mDownlinkHistogram;
 };
 
 #endif // CONTROLLER_H
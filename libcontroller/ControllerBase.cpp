@@ -31,6 +31,7 @@
 
 std::map< ControllerBase::Cmd, std::string > ControllerBase::mCommandsNames = {
 	{ ControllerBase::UNKNOWN, "Unknown" },
+	{ ControllerBase::TELEMETRY_FRAME, "Telemetry frame" },
 	// Configure
 	{ ControllerBase::PING, "Ping" },
 	{ ControllerBase::CALIBRATE, "Calibrate" },
@@ -22,7 +22,9 @@
 #include <unistd.h>
 #include <mutex>
 #include <list>
+#include <cmath>
 #include <Link.h>
+#include "ControllerProtocol.h"
 
 class ControllerBase
 {
@@ -46,6 +48,7 @@ protected:
 #define STATUS_ARMED 1
 #define STATUS_CALIBRATED 2
 #define STATUS_CALIBRATING 4
+#define STATUS_CAMERA_MISSING 64
 #define STATUS_NIGHTMODE 128
 
 	typedef struct __attribute__((packed)) Controls {
@@ -66,6 +69,76 @@ protected:
 		int8_t rx_level;
 	} Telemetry;
 
+	/** TELEMETRY_FRAME layout (all fields in network byte order) :
+	 *   - uint8 version, uint8 sections bitmap, uint8 status (STATUS_* bits)
+	 *   - int16 thrust, roll, pitch, yaw, acceleration, altitude
+	 *   - optional sections, in bitmap order :
+	 *     - POWER : uint16 battery voltage, uint16 total current (mAh), uint16 current draw, uint8 battery level (%)
+	 *     - SYSTEM : uint8 cpu load, uint8 cpu temperature, uint8 rx quality, int8 rx level
+	 *     - STABILIZER : uint16 stabilizer frequency
+	 *     - MOTORS : uint8 count, followed by count uint16 motor speeds
+	 *     - SENSORS : int16 gyroscope xyz, accelerometer xyz, magnetometer xyz
+	 *     - QOS : uint16 transmit queue delay of control, telemetry, bulk and debug traffic (TELEMETRY_QUEUE_DELAY_UNIT us)
+	 *     - LATENCY : uint16 round-trip p50, p99 and uplink one-way p50, p99 seen by the drone (TELEMETRY_LATENCY_UNIT us)
+	 **/
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_SECTION_POWER 1
+#define TELEMETRY_SECTION_SYSTEM 2
+#define TELEMETRY_SECTION_STABILIZER 4
+#define TELEMETRY_SECTION_MOTORS 8
+#define TELEMETRY_SECTION_SENSORS 16
+#define TELEMETRY_SECTION_QOS 32
+#define TELEMETRY_SECTION_LATENCY 64
+#define TELEMETRY_QUEUE_DELAY_UNIT 100
+#define TELEMETRY_LATENCY_UNIT 100
+	// Fixed-point scales
+#define TELEMETRY_SCALE_THRUST 10000.0f
+#define TELEMETRY_SCALE_ANGLE 100.0f
+#define TELEMETRY_SCALE_ACCELERATION 100.0f
+#define TELEMETRY_SCALE_ALTITUDE 100.0f
+#define TELEMETRY_SCALE_VOLTAGE 100.0f
+#define TELEMETRY_SCALE_CURRENT 100.0f
+#define TELEMETRY_SCALE_MOTOR 10000.0f
+#define TELEMETRY_SCALE_RATE 10.0f
+#define TELEMETRY_SCALE_MAGNETOMETER 10.0f
+
+	static int16_t Quantize( float v, float scale ) {
+		float q = v * scale;
+		if ( q >= 32767.0f ) {
+			return 32767;
+		} else if ( q <= -32768.0f ) {
+			return -32768;
+		}
+		return (int16_t)std::lround( q );
+	}
+	static float Dequantize( int16_t v, float scale ) {
+		return (float)v / scale;
+	}
+
+	/** Recording download, driven by the controller which keeps RECORD_DOWNLOAD_WINDOW chunks requested ahead :
+	 *   - RECORD_DOWNLOAD_INIT : string filename -> uint32 status (0 when opened), uint32 file size, uint32 chunk size
+	 *   - RECORD_DOWNLOAD_DATA : uint32 offset -> uint32 offset, uint32 size, uint32 crc32c, data
+	 *   - RECORD_DOWNLOAD_PROCESS : closes the file
+	 **/
+#define RECORD_DOWNLOAD_WINDOW 8
+#define RECORD_DOWNLOAD_TIMEOUT 500 // ms before a chunk is requested again
+
+	/** Firmware upload, chunks are sent ahead up to UPDATE_UPLOAD_WINDOW and acknowledged one by one :
+	 *   - UPDATE_UPLOAD_INIT : uint32 firmware size -> uint32 1 when ready
+	 *   - UPDATE_UPLOAD_DATA : uint32 crc32c (of offset, size and data), uint32 offset, uint32 size, data -> uint32 status (1 when stored), uint32 offset
+	 *   - UPDATE_UPLOAD_PROCESS : uint32 crc32c of the whole firmware
+	 **/
+#define UPDATE_UPLOAD_CHUNK 2048
+#define UPDATE_UPLOAD_WINDOW 32
+#define UPDATE_UPLOAD_TIMEOUT 500 // ms before an unacknowledged chunk is sent again
+
+	/** Texts (board and sensors infos, configuration file, recordings list) are sent in parts of at most TEXT_PART_SIZE bytes :
+	 *   - uint32 crc32 of the whole text, uint32 text length, uint32 part offset, part bytes
+	 *   GET_* requests are answered with all the parts in order, SET_CONFIG_FILE parts are answered with uint32 0 once
+	 *   the whole file is received, or 1 if it is corrupted. A missing part restarts the transfer.
+	 **/
+#define TEXT_PART_SIZE 4096
+
 	typedef enum {
 		UNKNOWN = 0,
 
@@ -73,6 +146,7 @@ protected:
 		STATUS = 0x60,
 		TELEMETRY = 0x61,
 		CONTROLS = 0x62,
+		TELEMETRY_FRAME = 0x63,
 
 		// Configure
 		PING = 0x70,
@@ -183,6 +257,16 @@ protected:
 		ERROR_CAMERA_MISSING = 0x7F01,
 	} Cmd;
 
+	// Size of fixed-size payloads, 0 for variable-size or unknown commands
+	static uint32_t PayloadSize( Cmd cmd ) {
+		switch ( cmd ) {
+#define PROTOCOL_COMMAND_SIZE( cmd, payload ) case cmd : return sizeof( payload##Payload );
+			PROTOCOL_COMMANDS( PROTOCOL_COMMAND_SIZE )
+#undef PROTOCOL_COMMAND_SIZE
+			default : return 0;
+		}
+	}
+
 	Link* mLink;
 	bool mConnected;
 	bool mConnectionEstablished;
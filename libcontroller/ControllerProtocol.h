@@ -0,0 +1,146 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef CONTROLLERPROTOCOL_H
+#define CONTROLLERPROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+/** Wire format shared by flight and libcontroller
+ *
+ * Fixed-size payloads are described once in PROTOCOL_PAYLOADS, which expands into packed structs
+ * mapped directly onto Packet storage : parsing returns a pointer inside the received buffer and
+ * serializing writes fields in place, values being converted from/to network byte order on access.
+ **/
+
+// Scalar stored in network byte order
+template< typename T > class WireValue
+{
+public:
+	T get() const {
+		T ret;
+		uint8_t b[sizeof(T)];
+		for ( uint32_t i = 0; i < sizeof(T); i++ ) {
+			b[i] = Swap() ? mBytes[sizeof(T) - 1 - i] : mBytes[i];
+		}
+		memcpy( &ret, b, sizeof(T) );
+		return ret;
+	}
+	void set( T v ) {
+		uint8_t b[sizeof(T)];
+		memcpy( b, &v, sizeof(T) );
+		for ( uint32_t i = 0; i < sizeof(T); i++ ) {
+			mBytes[i] = Swap() ? b[sizeof(T) - 1 - i] : b[i];
+		}
+	}
+	operator T() const { return get(); }
+	WireValue< T >& operator=( T v ) { set( v ); return *this; }
+
+private:
+	// True on little-endian hosts
+	static bool Swap() { return htons( 1 ) != 1; }
+	uint8_t mBytes[sizeof(T)];
+} __attribute__((packed));
+
+
+// Schema : PAYLOAD( Name, FIELD( type, name ) ... )
+#define PROTOCOL_PAYLOADS( PAYLOAD, FIELD ) \
+	PAYLOAD( Ping, FIELD( uint64_t, origin ) FIELD( uint64_t, receive ) FIELD( uint64_t, transmit ) \
+		FIELD( uint32_t, reported_rtt ) FIELD( int64_t, reported_offset ) ) \
+	PAYLOAD( Status, FIELD( uint32_t, status ) ) \
+	PAYLOAD( Value, FIELD( float, value ) ) \
+	PAYLOAD( Flag, FIELD( uint32_t, value ) ) \
+	PAYLOAD( Vector2, FIELD( float, x ) FIELD( float, y ) ) \
+	PAYLOAD( Vector3, FIELD( float, x ) FIELD( float, y ) FIELD( float, z ) ) \
+	PAYLOAD( TelemetryFrameHeader, FIELD( uint8_t, version ) FIELD( uint8_t, sections ) FIELD( uint8_t, status ) \
+		FIELD( int16_t, thrust ) FIELD( int16_t, roll ) FIELD( int16_t, pitch ) FIELD( int16_t, yaw ) \
+		FIELD( int16_t, acceleration ) FIELD( int16_t, altitude ) ) \
+
+#define PROTOCOL_FIELD( type, name ) WireValue< type > name;
+#define PROTOCOL_PAYLOAD( name, fields ) typedef struct __attribute__((packed)) name##Payload { fields } name##Payload;
+PROTOCOL_PAYLOADS( PROTOCOL_PAYLOAD, PROTOCOL_FIELD )
+#undef PROTOCOL_PAYLOAD
+#undef PROTOCOL_FIELD
+
+static_assert( sizeof(PingPayload) == 36, "PingPayload layout" );
+static_assert( sizeof(Vector3Payload) == 12, "Vector3Payload layout" );
+static_assert( sizeof(TelemetryFrameHeaderPayload) == 15, "TelemetryFrameHeaderPayload layout" );
+
+
+// Commands with a fixed-size payload : COMMAND( Cmd, Payload )
+#define PROTOCOL_COMMANDS( COMMAND ) \
+	COMMAND( PING, Ping ) \
+	COMMAND( STATUS, Status ) \
+	COMMAND( CALIBRATING, Flag ) \
+	COMMAND( ARM, Flag ) \
+	COMMAND( DISARM, Flag ) \
+	COMMAND( SET_MODE, Flag ) \
+	COMMAND( SET_THRUST, Value ) \
+	COMMAND( ALTITUDE, Value ) \
+	COMMAND( CURRENT_ACCELERATION, Value ) \
+	COMMAND( ROLL_PITCH_YAW, Vector3 ) \
+	COMMAND( GYRO, Vector3 ) \
+	COMMAND( ACCEL, Vector3 ) \
+	COMMAND( MAGN, Vector3 ) \
+	COMMAND( PID_OUTPUT, Vector3 ) \
+	COMMAND( OUTER_PID_OUTPUT, Vector3 ) \
+	COMMAND( ROLL_PID_FACTORS, Vector3 ) \
+	COMMAND( PITCH_PID_FACTORS, Vector3 ) \
+	COMMAND( YAW_PID_FACTORS, Vector3 ) \
+	COMMAND( OUTER_PID_FACTORS, Vector3 ) \
+	COMMAND( HORIZON_OFFSET, Vector2 ) \
+	COMMAND( SET_HORIZON_OFFSET, Vector2 ) \
+	COMMAND( SET_ROLL_PID_P, Value ) \
+	COMMAND( SET_ROLL_PID_I, Value ) \
+	COMMAND( SET_ROLL_PID_D, Value ) \
+	COMMAND( SET_PITCH_PID_P, Value ) \
+	COMMAND( SET_PITCH_PID_I, Value ) \
+	COMMAND( SET_PITCH_PID_D, Value ) \
+	COMMAND( SET_YAW_PID_P, Value ) \
+	COMMAND( SET_YAW_PID_I, Value ) \
+	COMMAND( SET_YAW_PID_D, Value ) \
+	COMMAND( SET_OUTER_PID_P, Value ) \
+	COMMAND( SET_OUTER_PID_I, Value ) \
+	COMMAND( SET_OUTER_PID_D, Value ) \
+	COMMAND( VBAT, Value ) \
+	COMMAND( TOTAL_CURRENT, Value ) \
+	COMMAND( CURRENT_DRAW, Value ) \
+	COMMAND( BATTERY_LEVEL, Value ) \
+	COMMAND( CPU_LOAD, Flag ) \
+	COMMAND( CPU_TEMP, Flag ) \
+	COMMAND( RX_QUALITY, Flag ) \
+	COMMAND( RX_LEVEL, Flag ) \
+	COMMAND( STABILIZER_FREQUENCY, Flag ) \
+
+
+// Zero-copy parse : returns a pointer to the payload inside the packet, or nullptr if it is truncated
+template< typename P, typename Pkt > const P* ParsePayload( Pkt* packet )
+{
+	return (const P*)packet->Peek( sizeof(P) );
+}
+
+
+// In-place serialize : returns a pointer to the payload reserved at the end of the packet, or nullptr if it is full
+template< typename P, typename Pkt > P* SerializePayload( Pkt* packet )
+{
+	return (P*)packet->Reserve( sizeof(P) );
+}
+
+#endif // CONTROLLERPROTOCOL_H
@@ -0,0 +1,77 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+#include <string.h>
+#if defined( __SSE4_2__ )
+#include <nmmintrin.h>
+#elif defined( __ARM_FEATURE_CRC32 )
+#include <arm_acle.h>
+#endif
+
+/*
+ * CRC32C (Castagnoli), uses the CPU instructions when the target has them
+ * Pass the previous result as 'crc' to checksum a buffer in several parts
+ */
+static inline uint32_t crc32c( const uint8_t* buf, uint32_t len, uint32_t crc = 0 )
+{
+	crc = ~crc;
+
+#if defined( __SSE4_2__ ) and defined( __x86_64__ )
+	for ( ; len >= 8; buf += 8, len -= 8 ) {
+		uint64_t v;
+		memcpy( &v, buf, 8 );
+		crc = (uint32_t)_mm_crc32_u64( crc, v );
+	}
+	for ( ; len > 0; buf++, len-- ) {
+		crc = _mm_crc32_u8( crc, *buf );
+	}
+#elif defined( __ARM_FEATURE_CRC32 )
+	for ( ; len >= 4; buf += 4, len -= 4 ) {
+		uint32_t v;
+		memcpy( &v, buf, 4 );
+		crc = __crc32cw( crc, v );
+	}
+	for ( ; len > 0; buf++, len-- ) {
+		crc = __crc32cb( crc, *buf );
+	}
+#else
+	static const struct Table {
+		Table() {
+			for ( uint32_t i = 0; i < 256; i++ ) {
+				uint32_t c = i;
+				for ( uint32_t k = 0; k < 8; k++ ) {
+					c = ( c & 1 ) ? ( 0x82F63B78 ^ ( c >> 1 ) ) : ( c >> 1 );
+				}
+				v[i] = c;
+			}
+		}
+		uint32_t v[256];
+	} table;
+	for ( ; len > 0; buf++, len-- ) {
+		crc = table.v[ ( crc ^ *buf ) & 0xFF ] ^ ( crc >> 8 );
+	}
+#endif
+
+	return ~crc;
+}
+
+#endif // CRC32C_H
@@ -0,0 +1,217 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef FIRMWAREDELTA_H
+#define FIRMWAREDELTA_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include "Crc32c.h"
+
+/** Firmware delta layout (all fields in network byte order) :
+ *   - header : uint32 magic, uint32 base size, uint32 base crc32c, uint32 target size, uint32 target crc32c
+ *   - operations, until target size is reached :
+ *     - FIRMWARE_DELTA_COPY : uint32 base offset, uint32 length
+ *     - FIRMWARE_DELTA_ADD : uint32 length, followed by length literal bytes
+ **/
+#define FIRMWARE_DELTA_MAGIC 0x42434644 // "BCFD"
+#define FIRMWARE_DELTA_HEADER_SIZE 20
+#define FIRMWARE_DELTA_COPY 1
+#define FIRMWARE_DELTA_ADD 2
+#define FIRMWARE_DELTA_BLOCK 32 // Smallest match searched in the base
+#define FIRMWARE_DELTA_BUFFER ( 64 * 1024 ) // Output buffer used when applying a delta
+
+class FirmwareDelta
+{
+public:
+	static bool IsDelta( const uint8_t* data, uint32_t size ) {
+		return size >= FIRMWARE_DELTA_HEADER_SIZE and Get32( data ) == FIRMWARE_DELTA_MAGIC;
+	}
+
+	// Base CRC expected by a delta
+	static uint32_t BaseCRC( const uint8_t* delta ) {
+		return Get32( delta + 8 );
+	}
+
+	/*
+	 * Builds a delta turning 'base' into 'target'
+	 * Base is indexed by blocks of FIRMWARE_DELTA_BLOCK bytes, target is scanned with a rolling hash,
+	 * matches are then extended in both directions so they are not bound to block boundaries
+	 */
+	static std::vector< uint8_t > Encode( const uint8_t* base, uint32_t base_size, const uint8_t* target, uint32_t target_size ) {
+		std::vector< uint8_t > delta;
+		Put32( &delta, FIRMWARE_DELTA_MAGIC );
+		Put32( &delta, base_size );
+		Put32( &delta, crc32c( base, base_size ) );
+		Put32( &delta, target_size );
+		Put32( &delta, crc32c( target, target_size ) );
+
+		std::unordered_map< uint32_t, uint32_t > index;
+		for ( uint32_t i = 0; i + FIRMWARE_DELTA_BLOCK <= base_size; i += FIRMWARE_DELTA_BLOCK ) {
+			index.emplace( Hash( base + i ), i );
+		}
+
+		uint32_t power = 1;
+		for ( uint32_t k = 1; k < FIRMWARE_DELTA_BLOCK; k++ ) {
+			power *= HASH_BASE;
+		}
+
+		uint32_t literal = 0; // Start of target bytes not covered yet
+		uint32_t i = 0;
+		uint32_t hash = ( target_size >= FIRMWARE_DELTA_BLOCK ) ? Hash( target ) : 0;
+		while ( i + FIRMWARE_DELTA_BLOCK <= target_size ) {
+			auto match = index.find( hash );
+			if ( match != index.end() and memcmp( base + match->second, target + i, FIRMWARE_DELTA_BLOCK ) == 0 ) {
+				uint32_t src = match->second;
+				uint32_t dst = i;
+				while ( src > 0 and dst > literal and base[src - 1] == target[dst - 1] ) {
+					src--;
+					dst--;
+				}
+				uint32_t length = i + FIRMWARE_DELTA_BLOCK - dst;
+				while ( src + length < base_size and dst + length < target_size and base[src + length] == target[dst + length] ) {
+					length++;
+				}
+				if ( dst > literal ) {
+					delta.push_back( FIRMWARE_DELTA_ADD );
+					Put32( &delta, dst - literal );
+					delta.insert( delta.end(), target + literal, target + dst );
+				}
+				delta.push_back( FIRMWARE_DELTA_COPY );
+				Put32( &delta, src );
+				Put32( &delta, length );
+				literal = dst + length;
+				i = literal;
+				if ( i + FIRMWARE_DELTA_BLOCK <= target_size ) {
+					hash = Hash( target + i );
+				}
+				continue;
+			}
+			if ( i + FIRMWARE_DELTA_BLOCK < target_size ) {
+				hash = ( hash - target[i] * power ) * HASH_BASE + target[i + FIRMWARE_DELTA_BLOCK];
+			}
+			i++;
+		}
+		if ( literal < target_size ) {
+			delta.push_back( FIRMWARE_DELTA_ADD );
+			Put32( &delta, target_size - literal );
+			delta.insert( delta.end(), target + literal, target + target_size );
+		}
+
+		return delta;
+	}
+
+	/*
+	 * Rebuilds the target firmware into file descriptor 'fd'
+	 * Memory use is bounded to FIRMWARE_DELTA_BUFFER whatever the firmware size, both
+	 * delta and base are expected to be memory-mapped files.
+	 * Returns 0 on success, with the CRC of the written firmware verified and stored in 'target_crc'
+	 */
+	static int Apply( const uint8_t* delta, uint32_t delta_size, const uint8_t* base, uint32_t base_size, int fd, uint32_t* target_crc ) {
+		if ( not IsDelta( delta, delta_size ) or Get32( delta + 4 ) != base_size or crc32c( base, base_size ) != BaseCRC( delta ) ) {
+			return -1;
+		}
+		uint32_t target_size = Get32( delta + 12 );
+		std::vector< uint8_t > buffer;
+		buffer.reserve( FIRMWARE_DELTA_BUFFER );
+		uint32_t written = 0;
+		uint32_t crc = 0;
+		uint32_t pos = FIRMWARE_DELTA_HEADER_SIZE;
+
+		while ( pos < delta_size ) {
+			uint8_t op = delta[pos++];
+			const uint8_t* src = nullptr;
+			uint32_t length = 0;
+			if ( op == FIRMWARE_DELTA_COPY and pos + 8 <= delta_size ) {
+				uint32_t offset = Get32( delta + pos );
+				length = Get32( delta + pos + 4 );
+				pos += 8;
+				if ( offset > base_size or length > base_size - offset ) {
+					return -1;
+				}
+				src = base + offset;
+			} else if ( op == FIRMWARE_DELTA_ADD and pos + 4 <= delta_size ) {
+				length = Get32( delta + pos );
+				pos += 4;
+				if ( length > delta_size - pos ) {
+					return -1;
+				}
+				src = delta + pos;
+				pos += length;
+			} else {
+				return -1;
+			}
+			if ( length > target_size - written ) {
+				return -1;
+			}
+			written += length;
+			while ( length > 0 ) {
+				uint32_t sz = std::min( length, (uint32_t)( FIRMWARE_DELTA_BUFFER - buffer.size() ) );
+				buffer.insert( buffer.end(), src, src + sz );
+				src += sz;
+				length -= sz;
+				if ( buffer.size() == FIRMWARE_DELTA_BUFFER and Flush( fd, &buffer, &crc ) < 0 ) {
+					return -1;
+				}
+			}
+		}
+		if ( Flush( fd, &buffer, &crc ) < 0 or written != target_size or crc != Get32( delta + 16 ) ) {
+			return -1;
+		}
+
+		*target_crc = crc;
+		return 0;
+	}
+
+protected:
+	static const uint32_t HASH_BASE = 257;
+
+	static uint32_t Hash( const uint8_t* p ) {
+		uint32_t h = 0;
+		for ( uint32_t k = 0; k < FIRMWARE_DELTA_BLOCK; k++ ) {
+			h = h * HASH_BASE + p[k];
+		}
+		return h;
+	}
+
+	static int Flush( int fd, std::vector< uint8_t >* buffer, uint32_t* crc ) {
+		*crc = crc32c( buffer->data(), buffer->size(), *crc );
+		if ( buffer->size() > 0 and write( fd, buffer->data(), buffer->size() ) != (ssize_t)buffer->size() ) {
+			return -1;
+		}
+		buffer->clear();
+		return 0;
+	}
+
+	static uint32_t Get32( const uint8_t* p ) {
+		return ( (uint32_t)p[0] << 24 ) | ( (uint32_t)p[1] << 16 ) | ( (uint32_t)p[2] << 8 ) | p[3];
+	}
+
+	static void Put32( std::vector< uint8_t >* v, uint32_t x ) {
+		v->push_back( x >> 24 );
+		v->push_back( x >> 16 );
+		v->push_back( x >> 8 );
+		v->push_back( x );
+	}
+};
+
+#endif // FIRMWAREDELTA_H
@@ -0,0 +1,104 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define LATENCY_HISTOGRAM_SUB_BUCKETS 4
+#define LATENCY_HISTOGRAM_BUCKETS ( 32 * LATENCY_HISTOGRAM_SUB_BUCKETS )
+#define LATENCY_HISTOGRAM_DECAY 1024
+
+/** Log-linear histogram of microsecond delays
+ *   Each power of two is split in LATENCY_HISTOGRAM_SUB_BUCKETS buckets, giving percentiles within 12.5%
+ *   When LATENCY_HISTOGRAM_DECAY samples are reached all counts are halved, so old samples fade out
+ **/
+class LatencyHistogram
+{
+public:
+	LatencyHistogram() {
+		Reset();
+	}
+
+	void Reset() {
+		memset( mCounts, 0, sizeof(mCounts) );
+		mCount = 0;
+	}
+
+	void Add( uint32_t us ) {
+		if ( mCount >= LATENCY_HISTOGRAM_DECAY ) {
+			mCount = 0;
+			for ( uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++ ) {
+				mCounts[i] /= 2;
+				mCount += mCounts[i];
+			}
+		}
+		mCounts[ Bucket( us ) ]++;
+		mCount++;
+	}
+
+	// p in [0;1], returns the middle of the bucket holding the requested rank
+	uint32_t Percentile( float p ) const {
+		if ( mCount == 0 ) {
+			return 0;
+		}
+		uint32_t rank = (uint32_t)( p * (float)mCount );
+		if ( rank >= mCount ) {
+			rank = mCount - 1;
+		}
+		uint32_t accum = 0;
+		for ( uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++ ) {
+			accum += mCounts[i];
+			if ( accum > rank ) {
+				return Value( i );
+			}
+		}
+		return 0xFFFFFFFF;
+	}
+
+	uint32_t count() const {
+		return mCount;
+	}
+
+protected:
+	static uint32_t Bucket( uint32_t us ) {
+		if ( us < LATENCY_HISTOGRAM_SUB_BUCKETS ) {
+			return us;
+		}
+		uint32_t octave = 31 - __builtin_clz( us );
+		uint32_t sub = ( us >> ( octave - 2 ) ) & ( LATENCY_HISTOGRAM_SUB_BUCKETS - 1 );
+		return ( octave - 1 ) * LATENCY_HISTOGRAM_SUB_BUCKETS + sub;
+	}
+
+	static uint32_t Value( uint32_t bucket ) {
+		if ( bucket < LATENCY_HISTOGRAM_SUB_BUCKETS ) {
+			return bucket;
+		}
+		uint32_t octave = bucket / LATENCY_HISTOGRAM_SUB_BUCKETS + 1;
+		uint32_t sub = bucket % LATENCY_HISTOGRAM_SUB_BUCKETS;
+		uint32_t width = 1U << ( octave - 2 );
+		return ( LATENCY_HISTOGRAM_SUB_BUCKETS + sub ) * width + width / 2;
+	}
+
+	uint32_t mCounts[LATENCY_HISTOGRAM_BUCKETS];
+	uint32_t mCount;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,219 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef SHAREDMEMORYRING_H
+#define SHAREDMEMORYRING_H
+
+#ifndef WIN32
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+#include <algorithm>
+#include <string>
+
+/** Message channel between two processes of the same host, shared by flight and libcontroller
+ *
+ * The segment is a POSIX shared memory object holding two single-producer single-consumer rings,
+ * one per direction. Messages are stored as a 32 bits length followed by the data, head and tail
+ * are free-running byte counters. A reader with nothing to read sleeps on a futex on the head of
+ * its ring, the writer only issues the wake-up syscall when the reader announced it is sleeping.
+ **/
+
+#define SHARED_MEMORY_MAGIC 0x42434D31 // "BCM1"
+#define SHARED_MEMORY_RING_SIZE ( 256 * 1024 ) // Must be a power of two
+#define SHARED_MEMORY_TIMEOUT -3
+
+class SharedMemoryRing
+{
+public:
+	// Side which creates the segment, the other one attaches to it
+	typedef enum {
+		Server = 0,
+		Client = 1
+	} Side;
+
+	SharedMemoryRing() : mSegment( nullptr ), mTx( nullptr ), mRx( nullptr ) {}
+	~SharedMemoryRing() { Close(); }
+
+	bool isOpen() const { return mSegment != nullptr; }
+
+	int Open( const std::string& name, Side side ) {
+		Close();
+		std::string path = "/bcflight_" + name;
+		int fd = shm_open( path.c_str(), O_RDWR | ( side == Server ? O_CREAT : 0 ), 0660 );
+		if ( fd < 0 ) {
+			return -1;
+		}
+		if ( side == Server and ftruncate( fd, sizeof(Segment) ) < 0 ) {
+			close( fd );
+			return -1;
+		}
+		struct stat st;
+		if ( fstat( fd, &st ) < 0 or st.st_size < (off_t)sizeof(Segment) ) {
+			close( fd );
+			return -1;
+		}
+		void* map = mmap( nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		close( fd );
+		if ( map == MAP_FAILED ) {
+			return -1;
+		}
+
+		Segment* segment = (Segment*)map;
+		if ( side == Server ) {
+			// (Re)starting server drops whatever was left by a previous session
+			for ( uint32_t i = 0; i < 2; i++ ) {
+				segment->rings[i].head.store( 0 );
+				segment->rings[i].tail.store( 0 );
+				segment->rings[i].sleeping.store( 0 );
+			}
+			segment->magic.store( SHARED_MEMORY_MAGIC );
+		} else if ( segment->magic.load() != SHARED_MEMORY_MAGIC ) {
+			munmap( map, sizeof(Segment) );
+			return -1;
+		}
+
+		mSegment = segment;
+		mTx = &segment->rings[side];
+		mRx = &segment->rings[1 - side];
+		return 0;
+	}
+
+	void Close() {
+		if ( mSegment ) {
+			munmap( mSegment, sizeof(Segment) );
+			mSegment = nullptr;
+			mTx = nullptr;
+			mRx = nullptr;
+		}
+	}
+
+	// Returns len, or 0 if the ring is full (messages are dropped like datagrams when the peer does not keep up)
+	int Write( const void* buf, uint32_t len ) {
+		uint32_t head = mTx->head.load( std::memory_order_relaxed );
+		uint32_t tail = mTx->tail.load( std::memory_order_acquire );
+		if ( SHARED_MEMORY_RING_SIZE - ( head - tail ) < sizeof(uint32_t) + len ) {
+			return 0;
+		}
+
+		Store( mTx, head, &len, sizeof(uint32_t) );
+		Store( mTx, head + sizeof(uint32_t), buf, len );
+		mTx->head.store( head + sizeof(uint32_t) + len, std::memory_order_seq_cst );
+
+		if ( mTx->sleeping.load( std::memory_order_seq_cst ) ) {
+			syscall( SYS_futex, &mTx->head, FUTEX_WAKE, 1, nullptr, nullptr, 0 );
+		}
+		return len;
+	}
+
+	// Returns the size of the message, truncated to len, or SHARED_MEMORY_TIMEOUT if nothing arrived in time (timeout < 0 waits forever, 0 does not wait)
+	int Read( void* buf, uint32_t len, int32_t timeout ) {
+		uint32_t tail = mRx->tail.load( std::memory_order_relaxed );
+		uint32_t head = mRx->head.load( std::memory_order_acquire );
+
+		if ( head == tail ) {
+			if ( timeout == 0 ) {
+				return SHARED_MEMORY_TIMEOUT;
+			}
+			struct timespec ts;
+			struct timespec deadline;
+			clock_gettime( CLOCK_MONOTONIC, &deadline );
+			if ( timeout > 0 ) {
+				deadline.tv_sec += timeout / 1000;
+				deadline.tv_nsec += ( timeout % 1000 ) * 1000000;
+				if ( deadline.tv_nsec >= 1000000000 ) {
+					deadline.tv_sec++;
+					deadline.tv_nsec -= 1000000000;
+				}
+			}
+			while ( head == tail ) {
+				struct timespec* pts = nullptr;
+				if ( timeout > 0 ) {
+					struct timespec now;
+					clock_gettime( CLOCK_MONOTONIC, &now );
+					int64_t remain = (int64_t)( deadline.tv_sec - now.tv_sec ) * 1000000000LL + ( deadline.tv_nsec - now.tv_nsec );
+					if ( remain <= 0 ) {
+						return SHARED_MEMORY_TIMEOUT;
+					}
+					ts.tv_sec = remain / 1000000000LL;
+					ts.tv_nsec = remain % 1000000000LL;
+					pts = &ts;
+				}
+				mRx->sleeping.store( 1, std::memory_order_seq_cst );
+				head = mRx->head.load( std::memory_order_seq_cst );
+				if ( head == tail ) {
+					syscall( SYS_futex, &mRx->head, FUTEX_WAIT, head, pts, nullptr, 0 );
+					head = mRx->head.load( std::memory_order_acquire );
+				}
+				mRx->sleeping.store( 0, std::memory_order_relaxed );
+			}
+		}
+
+		uint32_t size = 0;
+		Fetch( mRx, tail, &size, sizeof(uint32_t) );
+		Fetch( mRx, tail + sizeof(uint32_t), buf, std::min( size, len ) );
+		mRx->tail.store( tail + sizeof(uint32_t) + size, std::memory_order_release );
+		return std::min( size, len );
+	}
+
+protected:
+	typedef struct Ring {
+		alignas(64) std::atomic< uint32_t > head;
+		std::atomic< uint32_t > sleeping;
+		alignas(64) std::atomic< uint32_t > tail;
+		alignas(64) uint8_t data[SHARED_MEMORY_RING_SIZE];
+	} Ring;
+
+	typedef struct Segment {
+		std::atomic< uint32_t > magic;
+		Ring rings[2];
+	} Segment;
+
+	static_assert( sizeof(std::atomic< uint32_t >) == sizeof(uint32_t), "futex needs plain 32 bits words" );
+	static_assert( ( SHARED_MEMORY_RING_SIZE & ( SHARED_MEMORY_RING_SIZE - 1 ) ) == 0, "ring size must be a power of two" );
+
+	static void Store( Ring* ring, uint32_t offset, const void* src, uint32_t len ) {
+		uint32_t pos = offset & ( SHARED_MEMORY_RING_SIZE - 1 );
+		uint32_t first = std::min( len, SHARED_MEMORY_RING_SIZE - pos );
+		memcpy( ring->data + pos, src, first );
+		memcpy( ring->data, (const uint8_t*)src + first, len - first );
+	}
+	static void Fetch( Ring* ring, uint32_t offset, void* dst, uint32_t len ) {
+		uint32_t pos = offset & ( SHARED_MEMORY_RING_SIZE - 1 );
+		uint32_t first = std::min( len, SHARED_MEMORY_RING_SIZE - pos );
+		memcpy( dst, ring->data + pos, first );
+		memcpy( (uint8_t*)dst + first, ring->data, len - first );
+	}
+
+	Segment* mSegment;
+	Ring* mTx;
+	Ring* mRx;
+};
+
+#endif // WIN32
+
+#endif // SHAREDMEMORYRING_H
@@ -173,6 +173,26 @@ uint64_t Thread::GetTick()
 }
 
 
+uint64_t Thread::GetTickMicros()
+{
+#ifdef WIN32
+	LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+	QueryPerformanceFrequency( &freq );
+	QueryPerformanceCounter( &now );
+	return (uint64_t)( now.QuadPart / freq.QuadPart ) * 1000000ULL + (uint64_t)( now.QuadPart % freq.QuadPart ) * 1000000ULL / freq.QuadPart;
+#elif __APPLE__
+	struct timeval cTime;
+	gettimeofday( &cTime, 0 );
+	return (uint64_t)cTime.tv_sec * 1000000ULL + cTime.tv_usec;
+#else
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+#endif
+}
+
+
 float Thread::GetSeconds()
 {
 	return (float)( GetTick() ) / 1000.0f;
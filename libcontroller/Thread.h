@@ -20,6 +20,8 @@
 #define THREAD_H
 
 #include <mutex>
+#include <functional>
+#include <string>
 #include <pthread.h>
 
 class Thread
@@ -36,6 +38,7 @@ public:
 	bool running();
 
 	static uint64_t GetTick();
+	static uint64_t GetTickMicros();
 	static float GetSeconds();
 	static void EnterCritical() {/* mCriticalMutex.lock();*/ }
 	static void ExitCritical() {/* mCriticalMutex.unlock();*/ }
@@ -85,7 +85,8 @@ void Packet::WriteString( const std::string& str )
 
 int32_t Packet::Read( uint8_t* data, uint32_t bytes )
 {
-	if ( mReadOffset + bytes <= mData.size() ) {
+	// Compared to what is left, an offset + size sum could wrap around with sizes read from the packet
+	if ( bytes <= mData.size() - mReadOffset ) {
 		memcpy( data, mData.data() + mReadOffset, bytes );
 		mReadOffset += bytes;
 		return bytes;
@@ -94,6 +95,24 @@ int32_t Packet::Read( uint8_t* data, uint32_t bytes )
 }
 
 
+const uint8_t* Packet::Peek( uint32_t bytes )
+{
+	if ( bytes <= mData.size() - mReadOffset ) {
+		const uint8_t* ret = mData.data() + mReadOffset;
+		mReadOffset += bytes;
+		return ret;
+	}
+	return nullptr;
+}
+
+
+uint8_t* Packet::Reserve( uint32_t bytes )
+{
+	mData.resize( mData.size() + bytes );
+	return mData.data() + mData.size() - bytes;
+}
+
+
 uint32_t Packet::ReadU16( uint16_t* u )
 {
 	if ( mReadOffset + sizeof(uint16_t) <= mData.size() ) {
@@ -49,6 +49,7 @@ public:
 	void WriteString( const std::string& str );
 
 	int32_t Read( uint8_t* data, uint32_t bytes );
+	uint8_t ReadU8() { uint8_t ret = 0; Read( &ret, sizeof(uint8_t) ); return ret; }
 	uint32_t ReadU16( uint16_t* u );
 	uint32_t ReadU32( uint32_t* u );
 	uint32_t ReadFloat( float* f );
@@ -57,6 +58,10 @@ public:
 	float ReadFloat();
 	std::string ReadString();
 
+	// Zero-copy access, nullptr if not enough bytes available
+	const uint8_t* Peek( uint32_t bytes );
+	uint8_t* Reserve( uint32_t bytes );
+
 	const std::vector< uint8_t >& data() const { return mData; }
 
 private:
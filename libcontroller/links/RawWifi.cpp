@@ -48,6 +48,8 @@ RawWifi::RawWifi( const std::string& device, int16_t out_port, int16_t in_port,
 	, mOutputPort( out_port )
 	, mInputPort( in_port )
 	, mRetriesCount( 2 )
+	, mFecK( 4 )
+	, mFecM( 0 )
 	, mLastIsCorrupt( false )
 {
 }
@@ -123,6 +125,16 @@ void RawWifi::setRetriesCount( int retries )
 }
 
 
+void RawWifi::setFEC( int k, int m )
+{
+	mFecK = ( k > 0 ) ? k : 1;
+	mFecM = ( m > 0 ) ? m : 0;
+	if ( mRawWifi ) {
+		rawwifi_set_send_fec( mRawWifi, mFecK, mFecM );
+	}
+}
+
+
 int RawWifi::level() const
 {
 	return rawwifi_recv_level( mRawWifi );
@@ -229,6 +241,8 @@ int RawWifi::Connect()
 		}
 	}
 
+	rawwifi_set_send_fec( mRawWifi, mFecK, mFecM );
+
 	mConnected = true;
 	return 0;
 }
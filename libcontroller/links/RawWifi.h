@@ -44,6 +44,8 @@ public:
 	void setCECMode( const std::string& mode );
 	void setBlockRecoverMode( const std::string& mode );
 	void setRetriesCount( int retries );
+	// Sends m Reed-Solomon parity packets for every k data packets, m = 0 disables it
+	void setFEC( int k, int m );
 
 	int level() const;
 	int channel() const;
@@ -68,6 +70,8 @@ protected:
 	int16_t mOutputPort;
 	int16_t mInputPort;
 	int mRetriesCount;
+	int mFecK;
+	int mFecM;
 	bool mLastIsCorrupt;
 
 	static std::mutex mInitializingMutex;
@@ -0,0 +1,118 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef WIN32
+
+#include "SharedMemory.h"
+
+SharedMemory::SharedMemory( const std::string& name )
+	: Link()
+	, mName( name )
+	, mBlocking( true )
+{
+}
+
+
+SharedMemory::~SharedMemory()
+{
+}
+
+
+int SharedMemory::Connect()
+{
+	if ( mConnected ) {
+		return 0;
+	}
+
+	// Segment is created by the flight side, fails until it is started
+	if ( mRing.Open( mName, SharedMemoryRing::Client ) < 0 ) {
+		return -1;
+	}
+
+	mConnected = true;
+	return 0;
+}
+
+
+int SharedMemory::setBlocking( bool blocking )
+{
+	mBlocking = blocking;
+	return 0;
+}
+
+
+void SharedMemory::setRetriesCount( int retries )
+{
+}
+
+
+int SharedMemory::retriesCount() const
+{
+	return 1;
+}
+
+
+int SharedMemory::Read( void* buf, uint32_t len, int32_t timeout )
+{
+	if ( !mConnected ) {
+		return -1;
+	}
+
+	if ( not mBlocking ) {
+		timeout = 0;
+	} else if ( timeout <= 0 ) {
+		timeout = -1;
+	}
+
+	int ret = mRing.Read( buf, len, timeout );
+	if ( ret == SHARED_MEMORY_TIMEOUT ) {
+		return LINK_ERROR_TIMEOUT;
+	}
+
+	mReadSpeedCounter += ret;
+	if ( GetTicks() - mSpeedTick >= 1000 * 1000 ) {
+		mReadSpeed = mReadSpeedCounter;
+		mWriteSpeed = mWriteSpeedCounter;
+		mReadSpeedCounter = 0;
+		mWriteSpeedCounter = 0;
+		mSpeedTick = GetTicks();
+	}
+	return ret;
+}
+
+
+int SharedMemory::Write( const void* buf, uint32_t len, bool ack, int32_t timeout )
+{
+	if ( !mConnected ) {
+		return -1;
+	}
+
+	int ret = mRing.Write( buf, len );
+
+	mWriteSpeedCounter += ret;
+	if ( GetTicks() - mSpeedTick >= 1000 * 1000 ) {
+		mReadSpeed = mReadSpeedCounter;
+		mWriteSpeed = mWriteSpeedCounter;
+		mReadSpeedCounter = 0;
+		mWriteSpeedCounter = 0;
+		mSpeedTick = GetTicks();
+	}
+	return ret;
+}
+
+#endif // WIN32
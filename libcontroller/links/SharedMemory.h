@@ -0,0 +1,52 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#ifndef WIN32
+
+#include "../SharedMemoryRing.h"
+#include "Link.h"
+
+// Link to a flight process running on the same host, which must use a SharedMemory link with the same name
+class SharedMemory : public Link
+{
+public:
+	SharedMemory( const std::string& name = "controller" );
+	virtual ~SharedMemory();
+
+	int Connect();
+	int setBlocking( bool blocking );
+	void setRetriesCount( int retries );
+	int retriesCount() const;
+
+	virtual uint32_t fullReadSpeed() { return mReadSpeed; }
+
+protected:
+	int Read( void* buf, uint32_t len, int32_t timeout );
+	int Write( const void* buf, uint32_t len, bool ack, int32_t timeout );
+
+	std::string mName;
+	bool mBlocking;
+	SharedMemoryRing mRing;
+};
+
+#endif // WIN32
+
+#endif // SHAREDMEMORY_H
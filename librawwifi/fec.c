@@ -0,0 +1,372 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined( __SSSE3__ )
+#include <tmmintrin.h>
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#endif
+#include "rawwifi.h"
+
+// Systematic Reed-Solomon erasure code over GF(256) (polynomial 0x11D) :
+// parity packet i is the sum over data packets j of data[j] * 1 / ( ( k + i ) ^ j ),
+// any k packets out of the k + m are enough to rebuild the data since every square submatrix of a Cauchy matrix is invertible
+
+static uint8_t gf_exp[512];
+static uint8_t gf_log[256];
+// Split tables : c * x = gf_mul_lo[c][x & 0x0F] ^ gf_mul_hi[c][x >> 4], 16 entries each to fit a SIMD byte shuffle
+static uint8_t gf_mul_lo[256][16] __attribute__((aligned(16)));
+static uint8_t gf_mul_hi[256][16] __attribute__((aligned(16)));
+static pthread_once_t gf_once = PTHREAD_ONCE_INIT;
+
+extern const uint32_t rawwifi_headers_length;
+
+
+static uint8_t gf_mul( uint8_t a, uint8_t b )
+{
+	if ( a == 0 || b == 0 ) {
+		return 0;
+	}
+	return gf_exp[ gf_log[a] + gf_log[b] ];
+}
+
+
+static uint8_t gf_inv( uint8_t a )
+{
+	return gf_exp[ 255 - gf_log[a] ];
+}
+
+
+static void gf_init()
+{
+	uint32_t i = 0;
+	uint32_t j = 0;
+	uint32_t x = 1;
+
+	for ( i = 0; i < 255; i++ ) {
+		gf_exp[i] = x;
+		gf_log[x] = i;
+		x <<= 1;
+		if ( x & 0x100 ) {
+			x ^= 0x11D;
+		}
+	}
+	for ( i = 255; i < 512; i++ ) {
+		gf_exp[i] = gf_exp[i - 255];
+	}
+	gf_log[0] = 0;
+
+	for ( i = 0; i < 256; i++ ) {
+		for ( j = 0; j < 16; j++ ) {
+			gf_mul_lo[i][j] = gf_mul( i, j );
+			gf_mul_hi[i][j] = gf_mul( i, j << 4 );
+		}
+	}
+}
+
+
+static uint8_t cauchy( uint32_t k, uint32_t parity, uint32_t data )
+{
+	return gf_inv( ( k + parity ) ^ data );
+}
+
+
+// dst += c * src
+void rawwifi_gf256_mul_add( uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len )
+{
+	uint32_t i = 0;
+	const uint8_t* lo = gf_mul_lo[c];
+	const uint8_t* hi = gf_mul_hi[c];
+
+	pthread_once( &gf_once, gf_init );
+
+	if ( c == 0 ) {
+		return;
+	}
+	if ( c == 1 ) {
+		for ( i = 0; i < len; i++ ) {
+			dst[i] ^= src[i];
+		}
+		return;
+	}
+
+#if defined( __SSSE3__ )
+	{
+		const __m128i tlo = _mm_load_si128( (const __m128i*)lo );
+		const __m128i thi = _mm_load_si128( (const __m128i*)hi );
+		const __m128i mask = _mm_set1_epi8( 0x0F );
+		for ( ; i + 16 <= len; i += 16 ) {
+			__m128i s = _mm_loadu_si128( (const __m128i*)( src + i ) );
+			__m128i l = _mm_shuffle_epi8( tlo, _mm_and_si128( s, mask ) );
+			__m128i h = _mm_shuffle_epi8( thi, _mm_and_si128( _mm_srli_epi64( s, 4 ), mask ) );
+			__m128i d = _mm_loadu_si128( (const __m128i*)( dst + i ) );
+			_mm_storeu_si128( (__m128i*)( dst + i ), _mm_xor_si128( d, _mm_xor_si128( l, h ) ) );
+		}
+	}
+#elif defined( __aarch64__ ) && defined( __ARM_NEON )
+	{
+		const uint8x16_t tlo = vld1q_u8( lo );
+		const uint8x16_t thi = vld1q_u8( hi );
+		const uint8x16_t mask = vdupq_n_u8( 0x0F );
+		for ( ; i + 16 <= len; i += 16 ) {
+			uint8x16_t s = vld1q_u8( src + i );
+			uint8x16_t p = veorq_u8( vqtbl1q_u8( tlo, vandq_u8( s, mask ) ), vqtbl1q_u8( thi, vshrq_n_u8( s, 4 ) ) );
+			vst1q_u8( dst + i, veorq_u8( vld1q_u8( dst + i ), p ) );
+		}
+	}
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+	{
+		// ARMv7 table lookups work on 8 bytes, the 16 entries tables are split in two halves
+		const uint8x8x2_t tlo = { { vld1_u8( lo ), vld1_u8( lo + 8 ) } };
+		const uint8x8x2_t thi = { { vld1_u8( hi ), vld1_u8( hi + 8 ) } };
+		const uint8x8_t mask = vdup_n_u8( 0x0F );
+		for ( ; i + 8 <= len; i += 8 ) {
+			uint8x8_t s = vld1_u8( src + i );
+			uint8x8_t p = veor_u8( vtbl2_u8( tlo, vand_u8( s, mask ) ), vtbl2_u8( thi, vshr_n_u8( s, 4 ) ) );
+			vst1_u8( dst + i, veor_u8( vld1_u8( dst + i ), p ) );
+		}
+	}
+#endif
+
+	for ( ; i < len; i++ ) {
+		dst[i] ^= lo[ src[i] & 0x0F ] ^ hi[ src[i] >> 4 ];
+	}
+}
+
+
+void rawwifi_fec_encode( const uint8_t** data, uint32_t k, uint8_t** parity, uint32_t m, uint32_t size )
+{
+	uint32_t i = 0;
+	uint32_t j = 0;
+
+	pthread_once( &gf_once, gf_init );
+
+	for ( i = 0; i < m; i++ ) {
+		memset( parity[i], 0, size );
+		for ( j = 0; j < k; j++ ) {
+			rawwifi_gf256_mul_add( parity[i], data[j], cauchy( k, i, j ), size );
+		}
+	}
+}
+
+
+// Inverts the n*n matrix a (row-major) into b, returns -1 if it is singular
+static int gf_invert( uint8_t* a, uint8_t* b, uint32_t n )
+{
+	uint32_t row = 0;
+	uint32_t col = 0;
+	uint32_t i = 0;
+
+	memset( b, 0, n * n );
+	for ( i = 0; i < n; i++ ) {
+		b[i * n + i] = 1;
+	}
+
+	for ( col = 0; col < n; col++ ) {
+		for ( row = col; row < n && a[row * n + col] == 0; row++ );
+		if ( row == n ) {
+			return -1;
+		}
+		if ( row != col ) {
+			for ( i = 0; i < n; i++ ) {
+				uint8_t t = a[row * n + i]; a[row * n + i] = a[col * n + i]; a[col * n + i] = t;
+				t = b[row * n + i]; b[row * n + i] = b[col * n + i]; b[col * n + i] = t;
+			}
+		}
+		uint8_t inv = gf_inv( a[col * n + col] );
+		for ( i = 0; i < n; i++ ) {
+			a[col * n + i] = gf_mul( a[col * n + i], inv );
+			b[col * n + i] = gf_mul( b[col * n + i], inv );
+		}
+		for ( row = 0; row < n; row++ ) {
+			uint8_t f = a[row * n + col];
+			if ( row != col && f != 0 ) {
+				for ( i = 0; i < n; i++ ) {
+					a[row * n + i] ^= gf_mul( f, a[col * n + i] );
+					b[row * n + i] ^= gf_mul( f, b[col * n + i] );
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+
+int rawwifi_fec_decode( uint8_t** packets, const uint8_t* present, uint32_t k, uint32_t m, uint32_t size )
+{
+	uint32_t missing[MAX_PACKET_PER_BLOCK];
+	uint32_t rows[MAX_PACKET_PER_BLOCK];
+	uint8_t a[MAX_PACKET_PER_BLOCK * MAX_PACKET_PER_BLOCK];
+	uint8_t b[MAX_PACKET_PER_BLOCK * MAX_PACKET_PER_BLOCK];
+	uint32_t nmissing = 0;
+	uint32_t nrows = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+
+	pthread_once( &gf_once, gf_init );
+
+	if ( k + m > MAX_PACKET_PER_BLOCK ) {
+		return -1;
+	}
+	for ( j = 0; j < k; j++ ) {
+		if ( !present[j] ) {
+			missing[nmissing++] = j;
+		}
+	}
+	if ( nmissing == 0 ) {
+		return 0;
+	}
+	for ( i = 0; i < m && nrows < nmissing; i++ ) {
+		if ( present[k + i] ) {
+			rows[nrows++] = i;
+		}
+	}
+	if ( nrows < nmissing ) {
+		return -1;
+	}
+
+	// Remove the known data packets from the parity ones, what remains only depends on the missing packets
+	uint8_t* syndromes = (uint8_t*)malloc( nmissing * size );
+	for ( i = 0; i < nmissing; i++ ) {
+		uint8_t* s = syndromes + i * size;
+		memcpy( s, packets[k + rows[i]], size );
+		for ( j = 0; j < k; j++ ) {
+			if ( present[j] ) {
+				rawwifi_gf256_mul_add( s, packets[j], cauchy( k, rows[i], j ), size );
+			}
+		}
+		for ( j = 0; j < nmissing; j++ ) {
+			a[i * nmissing + j] = cauchy( k, rows[i], missing[j] );
+		}
+	}
+
+	if ( gf_invert( a, b, nmissing ) < 0 ) {
+		free( syndromes );
+		return -1;
+	}
+
+	for ( i = 0; i < nmissing; i++ ) {
+		uint8_t* dst = packets[missing[i]];
+		memset( dst, 0, size );
+		for ( j = 0; j < nmissing; j++ ) {
+			rawwifi_gf256_mul_add( dst, syndromes + j * size, b[i * nmissing + j], size );
+		}
+	}
+
+	free( syndromes );
+	return nmissing;
+}
+
+
+uint32_t rawwifi_fec_stripe_size()
+{
+	// Largest stripe, parity packets carry the FEC_TRAILER_LENGTH trailer behind the parity bytes
+	return MAX_USER_PACKET_LENGTH - rawwifi_headers_length - FEC_TRAILER_LENGTH;
+}
+
+
+// Returns the stripe length of a block, 0 if neither a parity packet nor a full data packet has been received
+uint32_t rawwifi_fec_block_stripe( uint8_t** packets, const uint32_t* sizes, const uint8_t* present, uint32_t packets_count, uint32_t parity_count )
+{
+	uint32_t k = packets_count - parity_count;
+	uint32_t i = 0;
+
+	for ( i = k; i < packets_count; i++ ) {
+		if ( present[i] && sizes[i] >= FEC_TRAILER_LENGTH ) {
+			uint32_t stripe = sizes[i] - FEC_TRAILER_LENGTH;
+			if ( ( packets[i][stripe + 2] | ( packets[i][stripe + 3] << 8 ) ) == stripe ) {
+				return stripe;
+			}
+		}
+	}
+	for ( i = 0; i + 1 < k; i++ ) {
+		if ( present[i] ) {
+			return sizes[i];
+		}
+	}
+	return 0;
+}
+
+
+int32_t rawwifi_fec_recover( uint8_t** packets, const uint32_t* sizes, const uint8_t* present, uint32_t packets_count, uint32_t parity_count, uint8_t* pret, uint32_t retmax )
+{
+	uint32_t stripe = 0;
+	uint32_t k = packets_count - parity_count;
+	uint32_t received = 0;
+	uint32_t last = 0;
+	uint32_t offset = 0;
+	uint32_t i = 0;
+
+	if ( parity_count == 0 || parity_count >= packets_count ) {
+		return -1;
+	}
+	for ( i = 0; i < packets_count; i++ ) {
+		received += ( present[i] != 0 );
+	}
+	if ( received < k ) {
+		return -1;
+	}
+
+	stripe = rawwifi_fec_block_stripe( packets, sizes, present, packets_count, parity_count );
+	if ( present[k - 1] ) {
+		last = sizes[k - 1];
+		if ( stripe == 0 ) {
+			// Single data packet and no parity received, the stripe is the data itself
+			stripe = last;
+		}
+	} else {
+		for ( i = k; i < packets_count; i++ ) {
+			if ( present[i] && sizes[i] == stripe + FEC_TRAILER_LENGTH ) {
+				last = packets[i][stripe] | ( packets[i][stripe + 1] << 8 );
+				break;
+			}
+		}
+	}
+	if ( stripe == 0 || stripe > rawwifi_fec_stripe_size() || last > stripe ) {
+		return -1;
+	}
+	for ( i = 0; i < packets_count; i++ ) {
+		if ( present[i] && i != k - 1 && sizes[i] != ( i < k ? stripe : stripe + FEC_TRAILER_LENGTH ) ) {
+			// Packets from another block, or a broken trailer
+			return -1;
+		}
+	}
+	if ( present[k - 1] ) {
+		// Parity was computed over a zero-padded last packet
+		memset( packets[k - 1] + last, 0, stripe - last );
+	}
+
+	if ( rawwifi_fec_decode( packets, present, k, parity_count, stripe ) < 0 ) {
+		return -1;
+	}
+
+	for ( i = 0; i < k && offset < retmax; i++ ) {
+		uint32_t len = ( i == k - 1 ) ? last : stripe;
+		if ( offset + len > retmax ) {
+			len = retmax - offset;
+		}
+		memcpy( pret + offset, packets[i], len );
+		offset += len;
+	}
+
+	return offset;
+}
@@ -179,6 +179,15 @@ int32_t rawwifi_recv_level( rawwifi_t* rwifi )
 }
 
 
+int rawwifi_recv_fd( rawwifi_t* rwifi )
+{
+	if ( rwifi == 0 || rwifi->in == 0 ) {
+		return -1;
+	}
+	return pcap_get_selectable_fd( rwifi->in->pcap );
+}
+
+
 uint32_t rawwifi_recv_speed( rawwifi_t* rwifi )
 {
 	if ( rwifi == 0 ) {
@@ -211,12 +220,25 @@ void rawwifi_set_send_block_flags( rawwifi_t* rwifi, RAWWIFI_BLOCK_FLAGS flags )
 }
 
 
+void rawwifi_set_send_fec( rawwifi_t* rwifi, uint32_t k, uint32_t m )
+{
+	if ( rwifi != 0 ) {
+		rwifi->send_fec_k = ( k > 0 ) ? k : 1;
+		rwifi->send_fec_m = ( m > MAX_FEC_PARITY ) ? MAX_FEC_PARITY : m;
+	}
+}
+
+
 uint32_t rawwifi_crc32( const uint8_t* buf, uint32_t len )
 {
-	uint32_t k = 0;
-	uint32_t crc = 0;
+	return ~rawwifi_crc32_update( ~0u, buf, len );
+}
 
-	crc = ~crc;
+
+// Raw CRC state update, allows to checksum data split in several buffers
+uint32_t rawwifi_crc32_update( uint32_t crc, const uint8_t* buf, uint32_t len )
+{
+	uint32_t k = 0;
 
 	while ( len-- ) {
 		crc ^= *buf++;
@@ -225,7 +247,7 @@ uint32_t rawwifi_crc32( const uint8_t* buf, uint32_t len )
 		}
 	}
 
-	return ~crc;
+	return crc;
 }
 
 
@@ -20,6 +20,14 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <pcap.h>
+#ifdef WIN32
+struct iovec {
+	void* iov_base;
+	size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,18 +48,22 @@ typedef enum {
 	RAWWIFI_BLOCK_FLAGS_NONE = 0,
 	RAWWIFI_BLOCK_FLAGS_HAMMING84 = 1,
 	RAWWIFI_BLOCK_FLAGS_EXTRA_HEADER_ROOM = 2,
+	RAWWIFI_BLOCK_FLAGS_FEC = 4, // set by rawwifi on blocks followed by Reed-Solomon parity packets, see rawwifi_set_send_fec()
 } RAWWIFI_BLOCK_FLAGS;
 
 #define MAX_USER_PACKET_LENGTH 1450 // wifi max : 1450
 #define MAX_PACKET_PER_BLOCK 32
+#define MAX_SEND_IOV 16 // scatter-gather sends with more parts are gathered in a temporary buffer
+#define MAX_FEC_PARITY 15 // parity packets per block, limited by wifi_packet_header_t.parity_count
+#define FEC_TRAILER_LENGTH 4 // parity packets end with the last data packet length and the stripe length (uint16 little-endian each)
 
-// TODO : remove _align0 and _align1, and use 16-bits bitfield to store data size
+// TODO : use 16-bits bitfield to store data size
 typedef struct __attribute__((packed)) {
 	uint32_t block_id;
 	uint8_t packet_id;
 	uint8_t packets_count;
 	uint8_t retry_id:4;
-	uint8_t _align0:4;
+	uint8_t parity_count:4; // last packets of the block carrying parity instead of data (RAWWIFI_BLOCK_FLAGS_FEC)
 	uint8_t retries_count:4;
 	uint8_t block_flags:4;
 	uint32_t crc;
@@ -103,6 +115,8 @@ typedef struct rawwifi_t {
 	uint8_t tx_buffer[8192];
 	uint32_t max_block_size;
 	RAWWIFI_BLOCK_FLAGS send_block_flags;
+	uint32_t send_fec_k;
+	uint32_t send_fec_m;
 
 	// Receive
 	rawwifi_pcap_t* in;
@@ -129,24 +143,36 @@ rawwifi_t* rawwifi_init( const char* device, int rx_port, int tx_port, int block
 int32_t rawwifi_recv_quality( rawwifi_t* rwifi );
 int32_t rawwifi_recv_level( rawwifi_t* rwifi );
 uint32_t rawwifi_recv_speed( rawwifi_t* rwifi );
+int rawwifi_recv_fd( rawwifi_t* rwifi );
 void rawwifi_set_recv_mode( rawwifi_t* rwifi, RAWWIFI_RX_FEC_MODE mode );
 void rawwifi_set_recv_block_recover_mode( rawwifi_t* rwifi, RAWWIFI_BLOCK_RECOVER_MODE mode );
 uint32_t rawwifi_send_headers_length( rawwifi_t* rwifi );
 void rawwifi_set_send_max_block_size( rawwifi_t* rwifi, uint32_t max_block_size );
 void rawwifi_set_send_block_flags( rawwifi_t* rwifi, RAWWIFI_BLOCK_FLAGS flags );
+// Sends m parity packets for every k data packets of a block (rounded up, at most MAX_FEC_PARITY), m = 0 disables FEC
+void rawwifi_set_send_fec( rawwifi_t* rwifi, uint32_t k, uint32_t m );
 
 int rawwifi_send( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen );
 int rawwifi_send_retry( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen, uint32_t retries );
+int rawwifi_sendv_retry( rawwifi_t* rwifi, const struct iovec* iov, int iovcnt, uint32_t retries );
 int rawwifi_recv( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen, uint32_t* valid );
 
 // internals
 void rawwifi_init_txbuf( uint8_t* buf );
 uint16_t rawwifi_crc16( const uint8_t* data, uint32_t len );
 uint32_t rawwifi_crc32( const uint8_t* data, uint32_t len );
+uint32_t rawwifi_crc32_update( uint32_t crc, const uint8_t* data, uint32_t len );
 
 uint32_t rawwifi_hamming84_encode( uint8_t* dest, uint8_t* src, uint32_t len );
 uint32_t rawwifi_hamming84_decode( uint8_t* dest, uint8_t* src, uint32_t len );
 
+void rawwifi_gf256_mul_add( uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len );
+void rawwifi_fec_encode( const uint8_t** data, uint32_t k, uint8_t** parity, uint32_t m, uint32_t size );
+int rawwifi_fec_decode( uint8_t** packets, const uint8_t* present, uint32_t k, uint32_t m, uint32_t size );
+uint32_t rawwifi_fec_stripe_size();
+uint32_t rawwifi_fec_block_stripe( uint8_t** packets, const uint32_t* sizes, const uint8_t* present, uint32_t packets_count, uint32_t parity_count );
+int32_t rawwifi_fec_recover( uint8_t** packets, const uint32_t* sizes, const uint8_t* present, uint32_t packets_count, uint32_t parity_count, uint8_t* pret, uint32_t retmax );
+
 rawwifi_block_t* blocks_insert_front( rawwifi_block_t** list, uint16_t packets_count );
 void blocks_pop_front( rawwifi_block_t** list );
 void blocks_pop( rawwifi_block_t** list, rawwifi_block_t** block );
@@ -116,6 +116,12 @@ int process_frame( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t** ppu8Payloa
 		return -1;
 	}
 
+	if ( retval == 0 && rpcap->blocking == 0 ) {
+		// Non-blocking mode and nothing queued, let the caller get back to its event loop
+		MUTEX_UNLOCK( &pcap_mutex );
+		return 0;
+	}
+
 	if ( retval != 1 ) {
 		MUTEX_UNLOCK( &pcap_mutex );
 		fprintf( stderr, "pcap_next_ex ERROR : %s (%d - %s) [continue..]\n", pcap_geterr( rpcap->pcap ), errno, strerror(errno) );
@@ -324,6 +330,11 @@ int process_packet( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t* pret, uint
 		free( rwifi->recv_block );
 		rwifi->recv_block = NULL;
 	}
+	if ( rwifi->recv_block && header->block_id < rwifi->recv_block->id && ( header->block_flags & RAWWIFI_BLOCK_FLAGS_FEC ) ) {
+		// A late packet from an older block would be decoded along with the current one
+		free( header ); // Actually frees header+payload
+		return CONTINUE;
+	}
 
 	if ( header->packets_count == 1 && ( is_valid || header->retry_id >= header->retries_count - 1 ) ) {
 		dprintf( "small block\n" );
@@ -347,6 +358,10 @@ int process_packet( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t* pret, uint
 		memset( rwifi->recv_block, 0, sizeof(rawwifi_block_t) );
 		rwifi->recv_block->id = header->block_id;
 		rwifi->recv_block->packets_count = header->packets_count;
+		if ( header->block_flags & RAWWIFI_BLOCK_FLAGS_FEC ) {
+			// Only data packets are returned when the block cannot be rebuilt
+			rwifi->recv_block->packets_count -= header->parity_count;
+		}
 	}
 	rawwifi_block_t* block = rwifi->recv_block;
 
@@ -359,6 +374,39 @@ int process_packet( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t* pret, uint
 		dprintf( "packet already valid\n" );
 	}
 
+	uint32_t fec_stripe = 0;
+	if ( header->block_flags & RAWWIFI_BLOCK_FLAGS_FEC ) {
+		uint8_t* packets[MAX_PACKET_PER_BLOCK];
+		uint32_t sizes[MAX_PACKET_PER_BLOCK];
+		uint8_t present[MAX_PACKET_PER_BLOCK];
+		for ( uint32_t i = 0; i < header->packets_count; i++ ) {
+			packets[i] = block->packets[i].data;
+			sizes[i] = block->packets[i].size;
+			present[i] = ( block->packets[i].size > 0 && block->packets[i].valid );
+		}
+		fec_stripe = rawwifi_fec_block_stripe( packets, sizes, present, header->packets_count, header->parity_count );
+		int32_t ret = rawwifi_fec_recover( packets, sizes, present, header->packets_count, header->parity_count, pret, retmax );
+		if ( ret >= 0 ) {
+			dprintf( "block %d rebuilt : %d bytes total\n", block->id, ret );
+			*valid = 1;
+			rwifi->recv_perf_valid++;
+			free( rwifi->recv_block );
+			rwifi->recv_block = NULL;
+			rwifi->recv_last_returned = header->block_id;
+			uint8_t block_flags = header->block_flags;
+			free( header ); // Actually frees header+payload
+			if ( block_flags & RAWWIFI_BLOCK_FLAGS_HAMMING84 ) {
+				return rawwifi_hamming84_decode( pret, pret, ret );
+			}
+			return ret;
+		}
+		if ( header->packet_id < header->packets_count - 1 ) {
+			free( header ); // Actually frees header+payload
+			return CONTINUE;
+		}
+		dprintf( "========> Block %d cannot be rebuilt <========\n", block->id );
+	}
+
 
 	int block_ok = 1;
 	for ( uint32_t i = 0; i < block->packets_count; i++ ) {
@@ -375,29 +423,30 @@ int process_packet( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t* pret, uint
 	if ( block_ok ) {
 		uint32_t all_valid = 0;
 		uint32_t offset = 0;
-		for ( uint32_t i = 0; i < header->packets_count; i++ ) {
+		uint32_t stride = ( fec_stripe > 0 ) ? fec_stripe : ( MAX_USER_PACKET_LENGTH - rawwifi_headers_length );
+		for ( uint32_t i = 0; i < block->packets_count; i++ ) {
 			if ( block->packets[i].size > 0 ) {
 				if ( offset + block->packets[i].size >= retmax - 1 ) {
 					break;
 				}
-				dprintf( "[%d/%d]memcpy( %p, %p, %u ) [%s]\n", i+1, header->packets_count, pret + offset, block->packets[i].data, block->packets[i].size, block->packets[i].valid ? "valid" : "invalid" );
+				dprintf( "[%d/%d]memcpy( %p, %p, %u ) [%s]\n", i+1, block->packets_count, pret + offset, block->packets[i].data, block->packets[i].size, block->packets[i].valid ? "valid" : "invalid" );
 				if ( block->packets[i].data ) {
 					memcpy( pret + offset, block->packets[i].data, block->packets[i].size );
 					offset += block->packets[i].size;
 				}
 				all_valid += ( block->packets[i].valid != 0 );
 			} else {
-				dprintf( "[%d/%d]leak (%d)\n", i+1, header->packets_count, block->packets[i].size );
-				if ( i < header->packets_count - 1 && rwifi->recv_recover == RAWWIFI_FILL_WITH_ZEROS ) {
-					memset( pret + offset, 0, MAX_USER_PACKET_LENGTH - rawwifi_headers_length );
-					offset += MAX_USER_PACKET_LENGTH - rawwifi_headers_length;
+				dprintf( "[%d/%d]leak (%d)\n", i+1, block->packets_count, block->packets[i].size );
+				if ( i < block->packets_count - 1 && rwifi->recv_recover == RAWWIFI_FILL_WITH_ZEROS ) {
+					memset( pret + offset, 0, stride );
+					offset += stride;
 				}
 			}
 			if ( offset >= retmax - 1 ) {
 				break;
 			}
 		}
-		block->valid = ( all_valid == header->packets_count );
+		block->valid = ( all_valid == block->packets_count );
 		if ( block->valid ) {
 			rwifi->recv_perf_valid++;
 		} else {
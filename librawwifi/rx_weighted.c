@@ -43,7 +43,8 @@ typedef struct block_t {
 	uint32_t id;
 	uint64_t ticks;
 	uint16_t valid;
-	uint16_t packets_count;
+	uint16_t packets_count; // Data packets only
+	uint16_t parity_count;
 	packet_t packets[MAX_PACKET_PER_BLOCK];
 } block_t;
 
@@ -52,12 +53,14 @@ uint64_t _rawwifi_get_tick();
 int analyze_packet( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, wifi_packet_header_t** pHeader, uint8_t** pPayload, uint32_t* valid );
 static int32_t reconstruct( rawwifi_t* rwifi, block_t* block, uint8_t* pret, uint32_t retmax, uint32_t* valid );
 static int32_t fast_cec( packet_t* packet, uint8_t* pret, uint32_t* valid, uint32_t* quality );
+static uint32_t fec_packets( block_t* block, uint8_t** packets, uint32_t* sizes, uint8_t* present );
+static int32_t fec_recover( block_t* block, uint8_t* pret, uint32_t retmax );
 
 int process_packet_weighted( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t* pret, uint32_t retmax, uint32_t* valid )
 {
 	block_t* last_block = (block_t*)rwifi->recv_private;
 
-	if ( last_block && last_block->packets_count == 1 && last_block->packets[0].lastRetry >= last_block->packets[0].nRetries - 1 ) {
+	if ( last_block && last_block->packets_count == 1 && last_block->parity_count == 0 && last_block->packets[0].lastRetry >= last_block->packets[0].nRetries - 1 ) {
 		int ret = reconstruct( rwifi, last_block, pret, retmax, valid );
 		rwifi->recv_last_returned = last_block->id;
 		free( last_block );
@@ -104,6 +107,10 @@ int process_packet_weighted( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t* p
 		memset( new_block, 0, sizeof( block_t ) );
 		new_block->id = header->block_id;
 		new_block->packets_count = header->packets_count;
+		if ( header->block_flags & RAWWIFI_BLOCK_FLAGS_FEC ) {
+			new_block->parity_count = header->parity_count;
+			new_block->packets_count -= header->parity_count;
+		}
 		new_block->packets[header->packet_id].crc = header->crc;
 		new_block->packets[header->packet_id].nRetries = header->retries_count;
 		new_block->packets[header->packet_id].lastRetry = header->retry_id;
@@ -140,6 +147,10 @@ int process_packet_weighted( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t* p
 		memset( new_block, 0, sizeof( block_t ) );
 		new_block->id = header->block_id;
 		new_block->packets_count = header->packets_count;
+		if ( header->block_flags & RAWWIFI_BLOCK_FLAGS_FEC ) {
+			new_block->parity_count = header->parity_count;
+			new_block->packets_count -= header->parity_count;
+		}
 		rwifi->recv_private = new_block;
 	}
 	block_t* block = (block_t*)rwifi->recv_private;
@@ -151,6 +162,23 @@ int process_packet_weighted( rawwifi_t* rwifi, rawwifi_pcap_t* rpcap, uint8_t* p
 	block->packets[header->packet_id].retries[header->retry_id].valid = is_valid;
 	memcpy( block->packets[header->packet_id].retries[header->retry_id].data, payload, bytes );
 
+	if ( block->parity_count > 0 && is_valid ) {
+		int32_t ret = fec_recover( block, pret, retmax );
+		if ( ret >= 0 ) {
+			*valid = 1;
+			rwifi->recv_perf_valid += 100;
+			rwifi->recv_last_returned = block->id;
+			free( block );
+			rwifi->recv_private = NULL;
+			uint8_t block_flags = header->block_flags;
+			free( header ); // Actually frees header+payload
+			if ( block_flags & RAWWIFI_BLOCK_FLAGS_HAMMING84 ) {
+				return rawwifi_hamming84_decode( pret, pret, ret );
+			}
+			return ret;
+		}
+	}
+
 	// ( Last packet, valid CRC ) OR ( Last packet, last retry )
 	if ( header->packet_id >= header->packets_count - 1 && ( is_valid || header->retry_id >= header->retries_count - 1 ) ) {
 		int ret = reconstruct( rwifi, block, pret, retmax, valid );
@@ -176,6 +204,18 @@ static int32_t reconstruct( rawwifi_t* rwifi, block_t* block, uint8_t* pret, uin
 	uint32_t offset = 0;
 	uint32_t is_valid = 0;
 	uint32_t quality = 0;
+	uint32_t stride = MAX_USER_PACKET_LENGTH - rawwifi_headers_length;
+
+	if ( block->parity_count > 0 ) {
+		uint8_t* packets[MAX_PACKET_PER_BLOCK];
+		uint32_t sizes[MAX_PACKET_PER_BLOCK];
+		uint8_t present[MAX_PACKET_PER_BLOCK];
+		uint32_t packets_count = fec_packets( block, packets, sizes, present );
+		uint32_t stripe = rawwifi_fec_block_stripe( packets, sizes, present, packets_count, block->parity_count );
+		if ( stripe > 0 ) {
+			stride = stripe;
+		}
+	}
 
 	for ( uint32_t i = 0; i < block->packets_count; i++ ) {
 		if ( offset + block->packets[i].retries[0].size >= retmax - 1 ) {
@@ -197,8 +237,8 @@ static int32_t reconstruct( rawwifi_t* rwifi, block_t* block, uint8_t* pret, uin
 		} else {
 			dprintf( "leak (%d)\n", block->packets[i].retries[0].size );
 			if ( i < block->packets_count - 1 && rwifi->recv_recover == RAWWIFI_FILL_WITH_ZEROS ) {
-				memset( pret + offset, 0, MAX_USER_PACKET_LENGTH - rawwifi_headers_length );
-				offset += MAX_USER_PACKET_LENGTH - rawwifi_headers_length;
+				memset( pret + offset, 0, stride );
+				offset += stride;
 			}
 		}
 		if ( ret > 0 && block->packets_count > 0 ) {
@@ -265,3 +305,41 @@ static int32_t fast_cec( packet_t* packet, uint8_t* pret, uint32_t* valid, uint3
 	*valid = ( broken ? 0 : ( rawwifi_crc32( pret, size ) == packet->crc ) );
 	return size;
 }
+
+
+// Picks one valid retry of each packet, returns the packets count (data and parity)
+static uint32_t fec_packets( block_t* block, uint8_t** packets, uint32_t* sizes, uint8_t* present )
+{
+	uint32_t packets_count = block->packets_count + block->parity_count;
+	uint32_t i = 0;
+	uint32_t r = 0;
+
+	for ( i = 0; i < packets_count; i++ ) {
+		packet_t* packet = &block->packets[i];
+		packets[i] = packet->retries[0].data;
+		sizes[i] = 0;
+		present[i] = 0;
+		for ( r = 0; r < 16; r++ ) {
+			if ( packet->retries[r].size > 0 && packet->retries[r].valid ) {
+				packets[i] = packet->retries[r].data;
+				sizes[i] = packet->retries[r].size;
+				present[i] = 1;
+				break;
+			}
+		}
+	}
+
+	return packets_count;
+}
+
+
+// Rebuilds the missing data packets from the parity ones
+static int32_t fec_recover( block_t* block, uint8_t* pret, uint32_t retmax )
+{
+	uint8_t* packets[MAX_PACKET_PER_BLOCK];
+	uint32_t sizes[MAX_PACKET_PER_BLOCK];
+	uint8_t present[MAX_PACKET_PER_BLOCK];
+	uint32_t packets_count = fec_packets( block, packets, sizes, present );
+
+	return rawwifi_fec_recover( packets, sizes, present, packets_count, block->parity_count, pret, retmax );
+}
@@ -1,6 +1,10 @@
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#ifndef WIN32
+#include <sys/socket.h>
+#endif
 #include "rawwifi.h"
 
 static const uint8_t u8aRadiotapHeader[] = {
@@ -47,17 +51,8 @@ void rawwifi_init_txbuf( uint8_t* buf )
 }
 
 
-static int rawwifi_send_frame( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen, uint32_t block_id, RAWWIFI_BLOCK_FLAGS block_flags, uint16_t packet_id, uint16_t packets_count, uint32_t retries )
+static wifi_packet_header_t* rawwifi_setup_frame( rawwifi_t* rwifi, uint8_t* tx_buffer, uint32_t block_id, RAWWIFI_BLOCK_FLAGS block_flags, uint16_t packet_id, uint16_t packets_count, uint16_t parity_count, uint32_t retries, uint32_t crc )
 {
-#ifdef DEBUG
-	uint32_t i = 0;
-#endif
-	uint8_t* tx_buffer = rwifi->tx_buffer;
-	if ( rwifi->send_block_flags & RAWWIFI_BLOCK_FLAGS_EXTRA_HEADER_ROOM ) {
-		tx_buffer = data - rawwifi_headers_length;
-		rawwifi_init_txbuf( tx_buffer );
-	}
-
 	tx_buffer[sizeof(u8aRadiotapHeader) + sizeof(uint32_t) + sizeof(uint8_t)*6 + sizeof(uint8_t)*5 ] = rwifi->out->port;
 	tx_buffer[sizeof(u8aRadiotapHeader) + sizeof(uint32_t) + sizeof(uint8_t)*6 + sizeof(uint8_t)*6 + sizeof(uint8_t)*5 ] = rwifi->out->port;
 
@@ -65,9 +60,27 @@ static int rawwifi_send_frame( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen
 	header->block_id = block_id;
 	header->packet_id = packet_id;
 	header->packets_count = packets_count;
+	header->parity_count = parity_count;
 	header->retries_count = retries;
 	header->block_flags = block_flags;
-	header->crc = rawwifi_crc32( data, datalen );
+	header->crc = crc;
+
+	return header;
+}
+
+
+static int rawwifi_send_frame( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen, uint32_t block_id, RAWWIFI_BLOCK_FLAGS block_flags, uint16_t packet_id, uint16_t packets_count, uint16_t parity_count, uint32_t retries )
+{
+#ifdef DEBUG
+	uint32_t i = 0;
+#endif
+	uint8_t* tx_buffer = rwifi->tx_buffer;
+	if ( rwifi->send_block_flags & RAWWIFI_BLOCK_FLAGS_EXTRA_HEADER_ROOM ) {
+		tx_buffer = data - rawwifi_headers_length;
+		rawwifi_init_txbuf( tx_buffer );
+	}
+
+	wifi_packet_header_t* header = rawwifi_setup_frame( rwifi, tx_buffer, block_id, block_flags, packet_id, packets_count, parity_count, retries, rawwifi_crc32( data, datalen ) );
 
 	if ( ! ( rwifi->send_block_flags & RAWWIFI_BLOCK_FLAGS_EXTRA_HEADER_ROOM ) ) {
 		memcpy( tx_buffer + rawwifi_headers_length, data, datalen );
@@ -98,6 +111,108 @@ static int rawwifi_send_frame( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen
 }
 
 
+#ifndef WIN32
+// Same as rawwifi_send_frame, but the payload is given as a list of parts which are handed
+// to the kernel along with the headers, without being copied to tx_buffer first
+static int rawwifi_send_frame_v( rawwifi_t* rwifi, struct iovec* frame, int frame_count, uint32_t datalen, uint32_t crc, uint32_t block_id, RAWWIFI_BLOCK_FLAGS block_flags, uint16_t packet_id, uint16_t packets_count, uint32_t retries )
+{
+	wifi_packet_header_t* header = rawwifi_setup_frame( rwifi, rwifi->tx_buffer, block_id, block_flags, packet_id, packets_count, 0, retries, crc );
+	int plen = datalen + rawwifi_headers_length;
+
+	frame[0].iov_base = rwifi->tx_buffer;
+	frame[0].iov_len = rawwifi_headers_length;
+
+	struct msghdr msg;
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_iov = frame;
+	msg.msg_iovlen = frame_count;
+
+	int r = 0;
+	for ( uint32_t i = 0; i < retries; i++ ) {
+		header->retry_id = i;
+		header->header_crc = rawwifi_crc16( (uint8_t*)header, sizeof(wifi_packet_header_t) - sizeof(uint16_t) );
+		// pcap_inject() is a plain send() on the capture socket, sendmsg() on it injects the same frame
+		r = sendmsg( pcap_fileno( rwifi->out->pcap ), &msg, 0 );
+		if ( r != plen ) {
+			perror( "Trouble injecting packet" );
+			printf( "[%d/%d] sent %d / %d\n", i + 1, retries, r, plen );
+			return -1;
+		} else {
+			dprintf( "[%d, %d, %d/%d] sent %d / %d\n", block_id, packet_id, i + 1, retries, r, plen );
+		}
+	}
+
+	return plen;
+}
+#endif
+
+
+// Splits the block in stripes followed by Reed-Solomon parity packets, the receiver only needs any
+// of them as many as there are data stripes to rebuild the whole block
+static int rawwifi_send_fec_block( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen, uint32_t retries )
+{
+	uint32_t stripe = rawwifi_fec_stripe_size();
+	uint32_t k = ( datalen + stripe - 1 ) / stripe;
+	uint32_t m = 0;
+	uint32_t i = 0;
+	const uint8_t* stripes[MAX_PACKET_PER_BLOCK];
+	uint8_t* parity[MAX_FEC_PARITY];
+
+	if ( k == 0 ) {
+		k = 1;
+	}
+	if ( k > MAX_PACKET_PER_BLOCK ) {
+		return -1;
+	}
+	m = ( k * rwifi->send_fec_m + rwifi->send_fec_k - 1 ) / rwifi->send_fec_k;
+	if ( m > MAX_FEC_PARITY ) {
+		m = MAX_FEC_PARITY;
+	}
+	if ( k + m > MAX_PACKET_PER_BLOCK ) {
+		m = MAX_PACKET_PER_BLOCK - k;
+	}
+	// Parity packets are as long as a stripe, so spread the data evenly instead of always using full-sized stripes
+	stripe = ( datalen + k - 1 ) / k;
+	if ( stripe == 0 ) {
+		stripe = 1;
+	}
+	uint32_t last = datalen - ( k - 1 ) * stripe;
+
+	// Parity packets and the zero-padded last stripe keep room for the headers in front of them, for EXTRA_HEADER_ROOM
+	uint32_t pitch = rawwifi_headers_length + stripe + FEC_TRAILER_LENGTH;
+	uint8_t* buffer = (uint8_t*)malloc( pitch * ( m + 1 ) );
+	uint8_t* tail = buffer + rawwifi_headers_length;
+
+	for ( i = 0; i < k - 1; i++ ) {
+		stripes[i] = data + i * stripe;
+	}
+	memcpy( tail, data + ( k - 1 ) * stripe, last );
+	memset( tail + last, 0, stripe - last );
+	stripes[k - 1] = tail;
+	for ( i = 0; i < m; i++ ) {
+		parity[i] = buffer + pitch * ( i + 1 ) + rawwifi_headers_length;
+		parity[i][stripe] = last & 0xFF;
+		parity[i][stripe + 1] = ( last >> 8 ) & 0xFF;
+		parity[i][stripe + 2] = stripe & 0xFF;
+		parity[i][stripe + 3] = ( stripe >> 8 ) & 0xFF;
+	}
+	rawwifi_fec_encode( stripes, k, parity, m, stripe );
+
+	RAWWIFI_BLOCK_FLAGS block_flags = rwifi->send_block_flags | ( m > 0 ? RAWWIFI_BLOCK_FLAGS_FEC : 0 );
+	rwifi->send_block_id++;
+
+	for ( i = 0; i < k; i++ ) {
+		rawwifi_send_frame( rwifi, data + i * stripe, ( i == k - 1 ) ? last : stripe, rwifi->send_block_id, block_flags, i, k + m, m, retries );
+	}
+	for ( i = 0; i < m; i++ ) {
+		rawwifi_send_frame( rwifi, parity[i], stripe + FEC_TRAILER_LENGTH, rwifi->send_block_id, block_flags, k + i, k + m, m, retries );
+	}
+
+	free( buffer );
+	return datalen;
+}
+
+
 int rawwifi_send_retry( rawwifi_t* rwifi, uint8_t* data_, uint32_t datalen_, uint32_t retries )
 {
 	int sent = 0;
@@ -119,19 +234,23 @@ int rawwifi_send_retry( rawwifi_t* rwifi, uint8_t* data_, uint32_t datalen_, uin
 		retries = ( rwifi->max_block_size / datalen );
 	}
 
-	rwifi->send_block_id++;
+	if ( rwifi->send_fec_m > 0 ) {
+		sent = rawwifi_send_fec_block( rwifi, data, datalen, retries );
+	} else {
+		rwifi->send_block_id++;
 
-	while ( sent < datalen ) {
-		len = MAX_USER_PACKET_LENGTH - rawwifi_headers_length;
-		if ( len > remain ) {
-			len = remain;
-		}
+		while ( sent < datalen ) {
+			len = MAX_USER_PACKET_LENGTH - rawwifi_headers_length;
+			if ( len > remain ) {
+				len = remain;
+			}
 
-		rawwifi_send_frame( rwifi, data + sent, len, rwifi->send_block_id, rwifi->send_block_flags, packet_id, packets_count, retries );
+			rawwifi_send_frame( rwifi, data + sent, len, rwifi->send_block_id, rwifi->send_block_flags, packet_id, packets_count, 0, retries );
 
-		packet_id++;
-		sent += len;
-		remain -= len;
+			packet_id++;
+			sent += len;
+			remain -= len;
+		}
 	}
 
 	if ( rwifi->send_block_flags & RAWWIFI_BLOCK_FLAGS_HAMMING84 ) {
@@ -145,3 +264,84 @@ int rawwifi_send( rawwifi_t* rwifi, uint8_t* data, uint32_t datalen )
 {
 	return rawwifi_send_retry( rwifi, data, datalen, 1 );
 }
+
+
+int rawwifi_sendv_retry( rawwifi_t* rwifi, const struct iovec* iov, int iovcnt, uint32_t retries )
+{
+	uint32_t datalen = 0;
+	int i = 0;
+
+	for ( i = 0; i < iovcnt; i++ ) {
+		datalen += iov[i].iov_len;
+	}
+
+#ifndef WIN32
+	if ( ( rwifi->send_block_flags & ( RAWWIFI_BLOCK_FLAGS_HAMMING84 | RAWWIFI_BLOCK_FLAGS_EXTRA_HEADER_ROOM ) ) == 0 && rwifi->send_fec_m == 0 && iovcnt <= MAX_SEND_IOV ) {
+		struct iovec frame[MAX_SEND_IOV + 1];
+		int sent = 0;
+		int remain = datalen;
+		int len = 0;
+		uint16_t packet_id = 0;
+		uint16_t packets_count = ( datalen / ( MAX_USER_PACKET_LENGTH - rawwifi_headers_length ) ) + 1;
+		int part = 0;
+		uint32_t part_offset = 0;
+
+		if ( rwifi->max_block_size > 0 && datalen > 0 && retries * datalen > rwifi->max_block_size ) {
+			retries = ( rwifi->max_block_size / datalen );
+		}
+
+		rwifi->send_block_id++;
+
+		while ( sent < datalen ) {
+			len = MAX_USER_PACKET_LENGTH - rawwifi_headers_length;
+			if ( len > remain ) {
+				len = remain;
+			}
+
+			// Slice the parts covering [sent, sent + len[, frame[0] is kept for the headers
+			int frame_count = 1;
+			uint32_t crc = ~0u;
+			int filled = 0;
+			while ( filled < len ) {
+				uint32_t chunk = iov[part].iov_len - part_offset;
+				if ( chunk > (uint32_t)( len - filled ) ) {
+					chunk = len - filled;
+				}
+				if ( chunk > 0 ) {
+					frame[frame_count].iov_base = (uint8_t*)iov[part].iov_base + part_offset;
+					frame[frame_count].iov_len = chunk;
+					crc = rawwifi_crc32_update( crc, (uint8_t*)iov[part].iov_base + part_offset, chunk );
+					frame_count++;
+					filled += chunk;
+					part_offset += chunk;
+				}
+				if ( part_offset >= iov[part].iov_len ) {
+					part++;
+					part_offset = 0;
+				}
+			}
+
+			rawwifi_send_frame_v( rwifi, frame, frame_count, len, ~crc, rwifi->send_block_id, rwifi->send_block_flags, packet_id, packets_count, retries );
+
+			packet_id++;
+			sent += len;
+			remain -= len;
+		}
+
+		return sent;
+	}
+#endif
+
+	// Hamming84 and FEC need the whole block at once and EXTRA_HEADER_ROOM needs room in front of the data, gather everything
+	uint8_t* buffer = (uint8_t*)malloc( rawwifi_headers_length + datalen );
+	uint8_t* data = buffer + rawwifi_headers_length;
+	uint32_t offset = 0;
+	for ( i = 0; i < iovcnt; i++ ) {
+		memcpy( data + offset, iov[i].iov_base, iov[i].iov_len );
+		offset += iov[i].iov_len;
+	}
+
+	int ret = rawwifi_send_retry( rwifi, data, datalen, retries );
+	free( buffer );
+	return ret;
+}
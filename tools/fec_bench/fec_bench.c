@@ -0,0 +1,164 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** librawwifi Reed-Solomon throughput benchmark, on MAX_USER_PACKET_LENGTH (1450 bytes) packets
+ *
+ * First checks that random blocks are rebuilt after up to m random losses, then measures
+ * encoding, decoding with m losses and the GF(256) multiply-add kernel.
+ * Usage : fec_bench [-k data_packets] [-m parity_packets] [-n iterations]
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rawwifi.h"
+
+// Only fec.c is linked, which needs this for rawwifi_fec_stripe_size()
+const uint32_t rawwifi_headers_length = 0;
+
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+
+static int check( uint32_t blocks )
+{
+	uint8_t* orig[MAX_PACKET_PER_BLOCK];
+	uint8_t* packets[MAX_PACKET_PER_BLOCK];
+	uint8_t present[MAX_PACKET_PER_BLOCK];
+	uint32_t t, i, b, k, m, lost, x;
+
+	for ( i = 0; i < MAX_PACKET_PER_BLOCK; i++ ) {
+		orig[i] = malloc( MAX_USER_PACKET_LENGTH );
+		packets[i] = malloc( MAX_USER_PACKET_LENGTH );
+	}
+
+	for ( t = 0; t < blocks; t++ ) {
+		k = 1 + rand() % 16;
+		m = 1 + rand() % ( MAX_PACKET_PER_BLOCK - k );
+		for ( i = 0; i < k; i++ ) {
+			for ( b = 0; b < MAX_USER_PACKET_LENGTH; b++ ) {
+				orig[i][b] = rand();
+			}
+		}
+		rawwifi_fec_encode( (const uint8_t**)orig, k, orig + k, m, MAX_USER_PACKET_LENGTH );
+		for ( i = 0; i < k + m; i++ ) {
+			memcpy( packets[i], orig[i], MAX_USER_PACKET_LENGTH );
+			present[i] = 1;
+		}
+		lost = rand() % ( m + 1 );
+		for ( i = 0; i < lost; i++ ) {
+			do {
+				x = rand() % ( k + m );
+			} while ( !present[x] );
+			present[x] = 0;
+			memset( packets[x], 0xAA, MAX_USER_PACKET_LENGTH );
+		}
+		if ( rawwifi_fec_decode( packets, present, k, m, MAX_USER_PACKET_LENGTH ) < 0 ) {
+			printf( "FAILED : k=%u m=%u, %u losses not recovered\n", k, m, lost );
+			return -1;
+		}
+		for ( i = 0; i < k; i++ ) {
+			if ( memcmp( packets[i], orig[i], MAX_USER_PACKET_LENGTH ) != 0 ) {
+				printf( "FAILED : k=%u m=%u, packet %u rebuilt wrong\n", k, m, i );
+				return -1;
+			}
+		}
+	}
+
+	for ( i = 0; i < MAX_PACKET_PER_BLOCK; i++ ) {
+		free( orig[i] );
+		free( packets[i] );
+	}
+	printf( "%u random blocks rebuilt\n", blocks );
+	return 0;
+}
+
+
+int main( int ac, char** av )
+{
+	uint32_t k = 8;
+	uint32_t m = 4;
+	uint32_t n = 100000;
+	uint8_t* packets[MAX_PACKET_PER_BLOCK];
+	uint8_t present[MAX_PACKET_PER_BLOCK];
+	uint32_t i, b, iter;
+	double t0, dt;
+	int a;
+
+	for ( a = 1; a + 1 < ac; a += 2 ) {
+		if ( !strcmp( av[a], "-k" ) ) {
+			k = atoi( av[a + 1] );
+		} else if ( !strcmp( av[a], "-m" ) ) {
+			m = atoi( av[a + 1] );
+		} else if ( !strcmp( av[a], "-n" ) ) {
+			n = atoi( av[a + 1] );
+		}
+	}
+	if ( k < 1 || m < 1 || k + m > MAX_PACKET_PER_BLOCK ) {
+		printf( "k and m must be at least 1, k + m at most %d\n", MAX_PACKET_PER_BLOCK );
+		return 1;
+	}
+
+	srand( 1 );
+	if ( check( 2000 ) < 0 ) {
+		return 1;
+	}
+
+	for ( i = 0; i < k + m; i++ ) {
+		packets[i] = malloc( MAX_USER_PACKET_LENGTH );
+		for ( b = 0; b < MAX_USER_PACKET_LENGTH; b++ ) {
+			packets[i][b] = rand();
+		}
+	}
+
+	t0 = now();
+	for ( iter = 0; iter < n; iter++ ) {
+		rawwifi_fec_encode( (const uint8_t**)packets, k, packets + k, m, MAX_USER_PACKET_LENGTH );
+	}
+	dt = now() - t0;
+	printf( "encode k=%u m=%u : %.1f MB/s of data, %.2f us per block\n", k, m, (double)n * k * MAX_USER_PACKET_LENGTH / dt / 1e6, dt * 1e6 / n );
+
+	// Worst case : as many data packets lost as there are parity packets
+	for ( i = 0; i < k + m; i++ ) {
+		present[i] = ( i >= ( m < k ? m : k ) );
+	}
+	t0 = now();
+	for ( iter = 0; iter < n; iter++ ) {
+		rawwifi_fec_decode( packets, present, k, m, MAX_USER_PACKET_LENGTH );
+	}
+	dt = now() - t0;
+	printf( "decode k=%u m=%u, %u losses : %.1f MB/s of data, %.2f us per block\n", k, m, ( m < k ? m : k ), (double)n * k * MAX_USER_PACKET_LENGTH / dt / 1e6, dt * 1e6 / n );
+
+	t0 = now();
+	for ( iter = 0; iter < n * 10; iter++ ) {
+		rawwifi_gf256_mul_add( packets[0], packets[1], 0x53, MAX_USER_PACKET_LENGTH );
+	}
+	dt = now() - t0;
+	printf( "gf256 multiply-add : %.1f MB/s\n", (double)n * 10 * MAX_USER_PACKET_LENGTH / dt / 1e6 );
+
+	for ( i = 0; i < k + m; i++ ) {
+		free( packets[i] );
+	}
+	return 0;
+}
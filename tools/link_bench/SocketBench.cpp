@@ -0,0 +1,237 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** Loopback benchmark of the flight Socket link
+ *
+ * The flight side is the real Socket class, the ground side is a plain socket :
+ *   - throughput : the ground sends 'count' messages of 'size' bytes as fast as possible, the flight Socket reads them
+ *   - latency : 'count' round-trips of 'size' bytes, the flight Socket echoes every message back
+ * Usage : socket_bench [tcp|udp|udplite|all] [-n count] [-s size] [-p port]
+ * UDP modes drop messages when the receive buffer overflows, received counts are reported.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <Main.h>
+#include <Controller.h>
+#include <Config.h>
+#include <Socket.h>
+
+#ifndef UDPLITE_SEND_CSCOV
+#define UDPLITE_SEND_CSCOV 10
+#endif
+
+// Socket and Debug only need these from the rest of the flight controller, outside of Instanciate()
+Main* Main::instance() { return nullptr; }
+Controller* Main::controller() const { return nullptr; }
+void Controller::SendDebug( const std::string& s ) {}
+std::string Config::string( const std::string& name, const std::string& def ) { return def; }
+int Config::integer( const std::string& name, int def ) { return def; }
+bool Config::boolean( const std::string& name, bool def ) { return def; }
+void Config::Execute( const std::string& code ) {}
+
+
+static uint64_t Ticks()
+{
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+
+static int GroundSocket( Socket::PortType type, uint16_t port )
+{
+	int proto = ( type == Socket::UDPLite ) ? IPPROTO_UDPLITE : 0;
+	int fd = socket( AF_INET, ( type == Socket::TCP ) ? SOCK_STREAM : SOCK_DGRAM, proto );
+	if ( type == Socket::TCP ) {
+		int flag = 1;
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag) );
+	}
+	if ( type == Socket::UDPLite ) {
+		// Same coverage as the flight side default
+		int coverage = 8;
+		setsockopt( fd, IPPROTO_UDPLITE, UDPLITE_SEND_CSCOV, &coverage, sizeof(coverage) );
+	}
+
+	struct sockaddr_in sin;
+	memset( &sin, 0, sizeof(sin) );
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons( port );
+	sin.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	for ( int retry = 0; retry < 100; retry++ ) {
+		if ( connect( fd, (struct sockaddr*)&sin, sizeof(sin) ) == 0 ) {
+			return fd;
+		}
+		usleep( 1000 * 10 );
+	}
+
+	fprintf( stderr, "Cannot connect to port %d : %s\n", port, strerror( errno ) );
+	close( fd );
+	return -1;
+}
+
+
+// TCP is a stream : read exactly one message
+static bool GroundReceive( int fd, Socket::PortType type, uint8_t* buf, uint32_t size )
+{
+	if ( type != Socket::TCP ) {
+		return recv( fd, buf, size, 0 ) > 0;
+	}
+	uint32_t done = 0;
+	while ( done < size ) {
+		int ret = recv( fd, buf + done, size - done, 0 );
+		if ( ret <= 0 ) {
+			return false;
+		}
+		done += ret;
+	}
+	return true;
+}
+
+
+static void Bench( Socket::PortType type, const char* name, uint32_t count, uint32_t size, uint16_t port )
+{
+	Socket* link = new Socket( port, type, false, 1000 );
+	int fd = -1;
+
+	// TCP Connect() blocks until the ground side is accepted
+	std::thread ground( [&]() { fd = GroundSocket( type, port ); } );
+	if ( link->Connect() < 0 ) {
+		ground.join();
+		fprintf( stderr, "%s : flight Socket cannot listen on port %d\n", name, port );
+		delete link;
+		return;
+	}
+	ground.join();
+	if ( fd < 0 ) {
+		delete link;
+		return;
+	}
+
+	std::vector< uint8_t > tx( size, 0x55 );
+	std::vector< uint8_t > rx( std::max( size, 65536U ) );
+
+	// Throughput
+	uint32_t received = 0;
+	uint64_t bytes = 0;
+	uint64_t start = Ticks();
+	uint64_t last = start;
+	std::thread sender( [&]() {
+		for ( uint32_t i = 0; i < count; i++ ) {
+			send( fd, tx.data(), size, 0 );
+		}
+	});
+	while ( received < count ) {
+		// Messages coalesce in the TCP stream, only count the bytes
+		int ret = link->Read( rx.data(), rx.size(), 200 );
+		if ( ret <= 0 ) {
+			break;
+		}
+		last = Ticks();
+		bytes += ret;
+		received = ( type == Socket::TCP ) ? bytes / size : received + 1;
+	}
+	// Up to the last message, the final read timeout is not part of the transfer
+	uint64_t elapsed = std::max( (uint64_t)1, last - start );
+	sender.join();
+	printf( "%-8s throughput : %u/%u messages of %u bytes in %.1f ms, %.0f msg/s, %.1f MB/s\n", name, received, count, size, (float)elapsed / 1000.0f, (double)received * 1000000.0 / elapsed, (double)bytes / elapsed );
+
+	// Drain what is left before measuring round-trips
+	while ( link->Read( rx.data(), rx.size(), 50 ) > 0 );
+
+	// Latency
+	std::vector< uint32_t > rtts;
+	bool running = true;
+	std::thread echo( [&]() {
+		std::vector< uint8_t > buf( std::max( size, 65536U ) );
+		uint32_t pending = 0;
+		while ( running ) {
+			int ret = link->Read( buf.data() + pending, size - pending, 100 );
+			if ( ret > 0 ) {
+				pending = ( type == Socket::TCP ) ? pending + ret : size;
+				if ( pending >= size ) {
+					link->Write( buf.data(), size );
+					pending = 0;
+				}
+			}
+		}
+	});
+	for ( uint32_t i = 0; i < count; i++ ) {
+		uint64_t t = Ticks();
+		send( fd, tx.data(), size, 0 );
+		if ( not GroundReceive( fd, type, rx.data(), size ) ) {
+			break;
+		}
+		rtts.push_back( Ticks() - t );
+	}
+	running = false;
+	echo.join();
+
+	if ( rtts.size() > 0 ) {
+		std::sort( rtts.begin(), rtts.end() );
+		printf( "%-8s latency    : %zu round-trips, min %u us, median %u us, p99 %u us, max %u us\n", name, rtts.size(), rtts.front(), rtts[rtts.size() / 2], rtts[rtts.size() * 99 / 100], rtts.back() );
+	}
+
+	close( fd );
+	delete link;
+}
+
+
+int main( int ac, char** av )
+{
+	std::string mode = "all";
+	uint32_t count = 10000;
+	uint32_t size = 1024;
+	uint16_t port = 2042;
+
+	for ( int i = 1; i < ac; i++ ) {
+		if ( not strcmp( av[i], "-n" ) and i + 1 < ac ) {
+			count = strtoul( av[++i], nullptr, 10 );
+		} else if ( not strcmp( av[i], "-s" ) and i + 1 < ac ) {
+			size = std::max( 1UL, std::min( 65000UL, strtoul( av[++i], nullptr, 10 ) ) );
+		} else if ( not strcmp( av[i], "-p" ) and i + 1 < ac ) {
+			port = strtoul( av[++i], nullptr, 10 );
+		} else {
+			mode = av[i];
+		}
+	}
+
+	// Each mode gets its own port, TCP sockets linger in TIME_WAIT
+	if ( mode == "all" or mode == "tcp" ) {
+		Bench( Socket::TCP, "TCP", count, size, port );
+	}
+	if ( mode == "all" or mode == "udp" ) {
+		Bench( Socket::UDP, "UDP", count, size, port + 1 );
+	}
+	if ( mode == "all" or mode == "udplite" ) {
+		Bench( Socket::UDPLite, "UDPLite", count, size, port + 2 );
+	}
+
+	return 0;
+}
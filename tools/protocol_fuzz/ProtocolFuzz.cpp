@@ -0,0 +1,185 @@
+/*
+ * BCFlight
+ * Copyright (C) 2016 Adrien Aubry (drich)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** Fuzzing of the packets parsing done by libcontroller (Controller::RxRun)
+ *
+ * Built with libFuzzer (-DLIBFUZZER -fsanitize=fuzzer), LLVMFuzzerTestOneInput() is the entry point.
+ * Otherwise a standalone driver replays the files given on the command line, or generates random
+ * packets made of known command ids followed by random payloads :
+ *   protocol_fuzz [-n iterations] [-s seed] [files...]
+ * Build with -fsanitize=address,undefined to catch out-of-bounds reads.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <functional>
+#include <Controller.h>
+#include <links/Link.h>
+
+// Link delivering one input per Read(), then only timeouts
+class FuzzLink : public Link
+{
+public:
+	FuzzLink() : mData( nullptr ), mSize( 0 ) {}
+	void setInput( const uint8_t* data, size_t size ) { mData = data; mSize = size; }
+	int Connect() { mConnected = true; return 0; }
+	int setBlocking( bool blocking ) { return 0; }
+	void setRetriesCount( int retries ) {}
+	int retriesCount() const { return 1; }
+	uint32_t fullReadSpeed() { return 0; }
+	int Read( void* buf, uint32_t len, int32_t timeout ) {
+		if ( not mData ) {
+			return LINK_ERROR_TIMEOUT;
+		}
+		int ret = std::min( (size_t)len, mSize );
+		memcpy( buf, mData, ret );
+		mData = nullptr;
+		return ret;
+	}
+	int Write( const void* buf, uint32_t len, bool ack, int32_t timeout ) { return len; }
+
+protected:
+	const uint8_t* mData;
+	size_t mSize;
+};
+
+
+class FuzzController : public Controller
+{
+public:
+	FuzzController( Link* link ) : Controller( link, false ) {
+		// Only the parser is exercised, the controller-tx thread would race with it
+		Pause();
+	}
+	bool Parse() { return RxRun(); }
+	// Commands handled by Controller::RxRun(), so that random packets go past the command id
+	static uint16_t RandomCommand() {
+		static const uint16_t commands[] = {
+			STATUS, TELEMETRY, TELEMETRY_FRAME, PING, CALIBRATING, ARM, DISARM, SET_MODE, DEBUG_OUTPUT,
+			GET_BOARD_INFOS, GET_SENSORS_INFOS, GET_CONFIG_FILE, SET_CONFIG_FILE, UPDATE_UPLOAD_INIT, UPDATE_UPLOAD_DATA,
+			ALTITUDE, ROLL_PITCH_YAW, GYRO, ACCEL, MAGN, MOTORS_SPEED, SENSORS_DATA, PID_OUTPUT, ROLL_PID_FACTORS,
+			HORIZON_OFFSET, VBAT, CPU_LOAD, RX_QUALITY, SET_THRUST, VIDEO_START_RECORD, GET_RECORDINGS_LIST,
+			RECORD_DOWNLOAD_INIT, RECORD_DOWNLOAD_DATA, VIDEO_NIGHT_MODE, GET_USERNAME, ERROR_CAMERA_MISSING,
+		};
+		if ( rand() % 16 == 0 ) {
+			return rand() & 0xFFFF;
+		}
+		return commands[ rand() % ( sizeof(commands) / sizeof(commands[0]) ) ];
+	}
+	static bool IsTelemetryFrame( uint16_t cmd ) { return cmd == TELEMETRY_FRAME; }
+};
+
+
+static FuzzLink* sLink = nullptr;
+static FuzzController* sController = nullptr;
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+	if ( not sController ) {
+		sLink = new FuzzLink();
+		sLink->Connect();
+		sController = new FuzzController( sLink );
+		// Replies and debug prints are not checked
+		std::cout.setstate( std::ios_base::badbit );
+	}
+	if ( size == 0 ) {
+		return 0;
+	}
+	sLink->setInput( data, size );
+	sController->Parse();
+	return 0;
+}
+
+
+#ifndef LIBFUZZER
+
+static void WriteU16( std::vector< uint8_t >& buf, uint16_t v )
+{
+	buf.push_back( v >> 8 );
+	buf.push_back( v & 0xFF );
+}
+
+
+static std::vector< uint8_t > RandomPacket()
+{
+	std::vector< uint8_t > buf;
+	int count = 1 + rand() % 4;
+
+	for ( int i = 0; i < count; i++ ) {
+		uint16_t cmd = FuzzController::RandomCommand();
+		WriteU16( buf, cmd );
+		if ( FuzzController::IsTelemetryFrame( cmd ) and rand() % 4 != 0 ) {
+			// Mostly valid frame versions, to reach the sections parsing
+			buf.push_back( TELEMETRY_FRAME_VERSION );
+		}
+		// Short payloads are the interesting ones, with the occasional huge length field
+		int len = ( rand() % 8 == 0 ) ? rand() % 2048 : rand() % 48;
+		for ( int j = 0; j < len; j++ ) {
+			buf.push_back( ( rand() % 8 == 0 ) ? 0xFF : ( rand() & 0xFF ) );
+		}
+	}
+
+	return buf;
+}
+
+
+int main( int ac, char** av )
+{
+	uint32_t iterations = 100000;
+	uint32_t seed = time( nullptr );
+	std::vector< std::string > files;
+
+	for ( int i = 1; i < ac; i++ ) {
+		if ( not strcmp( av[i], "-n" ) and i + 1 < ac ) {
+			iterations = strtoul( av[++i], nullptr, 10 );
+		} else if ( not strcmp( av[i], "-s" ) and i + 1 < ac ) {
+			seed = strtoul( av[++i], nullptr, 10 );
+		} else {
+			files.emplace_back( av[i] );
+		}
+	}
+
+	if ( files.size() > 0 ) {
+		for ( const std::string& file : files ) {
+			std::ifstream in( file, std::ios::binary );
+			std::stringstream ss;
+			ss << in.rdbuf();
+			std::string data = ss.str();
+			LLVMFuzzerTestOneInput( (const uint8_t*)data.data(), data.size() );
+		}
+		fprintf( stderr, "%zu inputs replayed\n", files.size() );
+		return 0;
+	}
+
+	fprintf( stderr, "Seed %u, %u iterations\n", seed, iterations );
+	srand( seed );
+	for ( uint32_t i = 0; i < iterations; i++ ) {
+		std::vector< uint8_t > packet = RandomPacket();
+		LLVMFuzzerTestOneInput( packet.data(), packet.size() );
+	}
+	fprintf( stderr, "Done\n" );
+	return 0;
+}
+
+#endif // LIBFUZZER